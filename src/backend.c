@@ -0,0 +1,169 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "backend.h"
+#include "utf8.h"
+
+/*****************************************************************************/
+/*                                   Canvas                                  */
+/*****************************************************************************/
+
+/* creates a new canvas */
+Canvas canvas_new(Backend b, int rows, int cols, int y, int x) {
+    Canvas c = malloc(sizeof *c);
+
+    c->backend = b;
+    c->rows = rows;
+    c->cols = cols;
+    c->y = y;
+    c->x = x;
+    c->cursor_row = 0;
+    c->cursor_col = 0;
+    c->data = NULL;
+
+    b->canvas_new(c);
+
+    return c;
+}
+
+/* destroys a canvas, freeing its memory */
+void canvas_delete(Canvas c) {
+    if (!c)
+        return;
+
+    c->backend->canvas_delete(c);
+    free(c);
+}
+
+/* clears the canvas */
+void canvas_erase(Canvas c) {
+    c->backend->canvas_erase(c);
+}
+
+/* puts a number of cells on a row, starting at the given column */
+void canvas_put(Canvas c, int row, int col, const Cell* cells, int n) {
+    /* clip the cells to the canvas */
+    if (row < 0 || row >= c->rows || col >= c->cols)
+        return;
+
+    if (col < 0) {
+        cells -= col;
+        n += col;
+        col = 0;
+    }
+
+    if (n > c->cols - col)
+        n = c->cols - col;
+
+    if (n > 0)
+        c->backend->canvas_put(c, row, col, cells, n);
+}
+
+/* puts a UTF-8 string with the same attributes in every cell */
+void canvas_put_str(Canvas c, int row, int col, const char* str,
+                    unsigned char attr) {
+    Cell cells[256];
+    size_t length = strlen(str);
+    size_t i = 0;
+
+    /* put longer strings in pieces */
+    while (i < length) {
+        int n = 0;
+
+        /* one cell is left for the second half of a wide character */
+        while (i < length && n < 255) {
+            uint32_t ch;
+            i += utf8_decode(str+i, length-i, &ch);
+            uint width = utf8_width(ch);
+
+            /* combining marks go over the character before them */
+            if (width == 0) {
+                if (n > 0)
+                    cells[n-1].mark = ch;
+                continue;
+            }
+
+            cells[n++] = (Cell){ ch, attr, 0 };
+            if (width == 2)
+                cells[n++] = (Cell){ CELL_WIDE, attr, 0 };
+        }
+
+        canvas_put(c, row, col, cells, n);
+        col += n;
+    }
+}
+
+/* puts formatted text without attributes */
+void canvas_printf(Canvas c, int row, int col, const char* format, ...) {
+    char text[256];
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof text, format, args);
+    va_end(args);
+
+    canvas_put_str(c, row, col, text, ATTR_NONE);
+}
+
+/* moves the canvas's cursor */
+void canvas_move(Canvas c, int row, int col) {
+    c->cursor_row = row;
+    c->cursor_col = col;
+}
+
+/* stages the canvas for the next update */
+void canvas_stage(Canvas c) {
+    c->backend->canvas_stage(c);
+}
+
+/*****************************************************************************/
+/*                                  Backend                                  */
+/*****************************************************************************/
+
+/* shows all staged canvases at once */
+void backend_update(Backend b) {
+    b->update(b);
+}
+
+/* sets how long reading a key waits, -1 to wait forever */
+void backend_timeout(Backend b, int timeout) {
+    b->timeout = timeout;
+}
+
+/* reads a key, returns ERR if there was none in time */
+int backend_read_key(Backend b) {
+    return b->read_key(b);
+}
+
+/* shows or hides the cursor */
+void backend_show_cursor(Backend b, bool show) {
+    b->show_cursor(b, show);
+}
+
+/* closes the backend, freeing its memory */
+void backend_destroy(Backend b) {
+    b->destroy(b);
+    free(b);
+}
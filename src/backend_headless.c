@@ -0,0 +1,257 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend.h"
+#include "utf8.h"
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* the canvas's cells */
+#define CELLS(c) ((Cell*)(c)->data)
+
+/* the headless backend's state */
+#define DATA(b) ((struct headless_data*)(b)->data)
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* state of the headless backend */
+struct headless_data {
+    Cell* staged; /* screen with canvases staged for the next update */
+    Cell* shown; /* screen as of the last update */
+
+    uint staged_row; /* cursor's row for the next update */
+    uint staged_col; /* cursor's column for the next update */
+    uint cursor_row; /* cursor's row as of the last update */
+    uint cursor_col; /* cursor's column as of the last update */
+    bool cursor_visible; /* if the cursor is shown */
+
+    unsigned long frames; /* number of updates */
+
+    int* keys; /* queue of keys to be read */
+    uint keys_size; /* capacity of the queue */
+    uint keys_head; /* index of the next key to read */
+    uint keys_length; /* number of queued keys */
+};
+
+/* fills cells with blanks */
+static void headless_clear(Cell* cells, int n) {
+    for (int i = 0 ; i < n ; ++i)
+        cells[i] = (Cell){ ' ', ATTR_NONE, 0 };
+}
+
+static void headless_canvas_new(Canvas c) {
+    c->data = malloc(sizeof(Cell) * c->rows * c->cols);
+    headless_clear(CELLS(c), c->rows * c->cols);
+}
+
+static void headless_canvas_delete(Canvas c) {
+    free(c->data);
+}
+
+static void headless_canvas_erase(Canvas c) {
+    headless_clear(CELLS(c), c->rows * c->cols);
+}
+
+static void headless_canvas_put(Canvas c, int row, int col,
+                                const Cell* cells, int n) {
+    memcpy(CELLS(c) + row * c->cols + col, cells, sizeof(Cell) * n);
+}
+
+static void headless_canvas_stage(Canvas c) {
+    Backend b = c->backend;
+
+    /* copy the part of the canvas which is on the screen */
+    for (int row = 0 ; row < c->rows ; ++row) {
+        int y = c->y + row;
+        if (y < 0 || y >= (int)b->rows)
+            continue;
+
+        int from = (c->x < 0) ? -c->x : 0;
+        int to = ((int)b->cols - c->x < c->cols) ? (int)b->cols - c->x : c->cols;
+
+        if (to > from)
+            memcpy(DATA(b)->staged + y * b->cols + c->x + from,
+                   CELLS(c) + row * c->cols + from, sizeof(Cell) * (to - from));
+    }
+
+    DATA(b)->staged_row = c->y + c->cursor_row;
+    DATA(b)->staged_col = c->x + c->cursor_col;
+}
+
+static void headless_update(Backend b) {
+    memcpy(DATA(b)->shown, DATA(b)->staged, sizeof(Cell) * b->rows * b->cols);
+
+    DATA(b)->cursor_row = DATA(b)->staged_row;
+    DATA(b)->cursor_col = DATA(b)->staged_col;
+    DATA(b)->frames++;
+}
+
+static void headless_show_cursor(Backend b, bool show) {
+    DATA(b)->cursor_visible = show;
+}
+
+static int headless_read_key(Backend b) {
+    struct headless_data* data = DATA(b);
+
+    /* nobody is going to type, never wait */
+    if (data->keys_length == 0)
+        return ERR;
+
+    int c = data->keys[data->keys_head];
+    data->keys_head = (data->keys_head + 1) % data->keys_size;
+    data->keys_length--;
+
+    return c;
+}
+
+static void headless_destroy(Backend b) {
+    free(DATA(b)->staged);
+    free(DATA(b)->shown);
+    free(DATA(b)->keys);
+    free(DATA(b));
+}
+
+/*****************************************************************************/
+/*                                  Backend                                  */
+/*****************************************************************************/
+
+/* creates a backend keeping the screen in memory, needs no terminal */
+Backend backend_headless_new(uint rows, uint cols) {
+    struct headless_data* data = malloc(sizeof *data);
+
+    data->staged = malloc(sizeof(Cell) * rows * cols);
+    data->shown = malloc(sizeof(Cell) * rows * cols);
+    headless_clear(data->staged, rows * cols);
+    headless_clear(data->shown, rows * cols);
+
+    data->staged_row = 0;
+    data->staged_col = 0;
+    data->cursor_row = 0;
+    data->cursor_col = 0;
+    data->cursor_visible = true;
+    data->frames = 0;
+
+    data->keys_size = 64;
+    data->keys = malloc(sizeof(int) * data->keys_size);
+    data->keys_head = 0;
+    data->keys_length = 0;
+
+    Backend b = malloc(sizeof *b);
+
+    b->name = "headless";
+    b->rows = rows;
+    b->cols = cols;
+    b->timeout = -1;
+    b->fd = -1;
+    b->frame_bytes = -1;
+    b->data = data;
+
+    b->canvas_new = headless_canvas_new;
+    b->canvas_delete = headless_canvas_delete;
+    b->canvas_erase = headless_canvas_erase;
+    b->canvas_put = headless_canvas_put;
+    b->canvas_stage = headless_canvas_stage;
+    b->update = headless_update;
+    b->show_cursor = headless_show_cursor;
+    b->read_key = headless_read_key;
+    b->destroy = headless_destroy;
+
+    return b;
+}
+
+/* queues a key to be read by the editor */
+void backend_headless_push_key(Backend b, int key) {
+    struct headless_data* data = DATA(b);
+
+    /* grow the queue, moving the keys to the beginning */
+    if (data->keys_length == data->keys_size) {
+        int* keys = malloc(sizeof(int) * data->keys_size * 2);
+
+        for (uint i = 0 ; i < data->keys_length ; ++i)
+            keys[i] = data->keys[(data->keys_head + i) % data->keys_size];
+
+        free(data->keys);
+        data->keys = keys;
+        data->keys_head = 0;
+        data->keys_size *= 2;
+    }
+
+    data->keys[(data->keys_head + data->keys_length) % data->keys_size] = key;
+    data->keys_length++;
+}
+
+/* changes the size of the screen and reports it like a terminal would */
+void backend_headless_resize(Backend b, uint rows, uint cols) {
+    struct headless_data* data = DATA(b);
+
+    free(data->staged);
+    free(data->shown);
+
+    b->rows = rows;
+    b->cols = cols;
+
+    data->staged = malloc(sizeof(Cell) * rows * cols);
+    data->shown = malloc(sizeof(Cell) * rows * cols);
+    headless_clear(data->staged, rows * cols);
+    headless_clear(data->shown, rows * cols);
+
+    backend_headless_push_key(b, KEY_RESIZE);
+}
+
+/* returns the cells of a row of the screen as of the last update */
+const Cell* backend_headless_row(Backend b, uint row) {
+    return DATA(b)->shown + row * b->cols;
+}
+
+/* copies characters of a row of the screen into a string as UTF-8, which
+   takes a byte a cell as long as the row is ASCII */
+void backend_headless_row_text(Backend b, uint row, char* text) {
+    const Cell* cells = backend_headless_row(b, row);
+    uint n = 0;
+
+    for (uint i = 0 ; i < b->cols ; ++i) {
+        if (cells[i].ch == CELL_WIDE)
+            continue;
+
+        n += utf8_encode(cells[i].ch, text+n);
+        if (cells[i].mark)
+            n += utf8_encode(cells[i].mark, text+n);
+    }
+
+    text[n] = '\0';
+}
+
+/* gets the position of the cursor as of the last update */
+void backend_headless_cursor(Backend b, uint* row, uint* col) {
+    *row = DATA(b)->cursor_row;
+    *col = DATA(b)->cursor_col;
+}
+
+/* returns the number of updates so far */
+unsigned long backend_headless_frames(Backend b) {
+    return DATA(b)->frames;
+}
@@ -0,0 +1,224 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+/* wide character functions of ncursesw */
+#define NCURSES_WIDECHAR 1
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <locale.h>
+#include <wchar.h>
+
+#include <ncurses.h>
+
+#include "backend.h"
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* escape sequences enabling and disabling bracketed paste in terminals */
+#define PASTE_MODE_ON "\033[?2004h"
+#define PASTE_MODE_OFF "\033[?2004l"
+
+/* the canvas's ncurses window */
+#define WIN(c) ((WINDOW*)(c)->data)
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* state of the ncurses backend */
+struct ncurses_data {
+    cchar_t* row; /* buffer for converting cells */
+    chtype* ascii_row; /* buffer for converting cells of ASCII rows */
+    int row_size; /* size of the buffers */
+    chtype attrs[16]; /* ncurses attributes of every combination of ATTR_* */
+};
+
+static void ncurses_canvas_new(Canvas c) {
+    c->data = newwin(c->rows, c->cols, c->y, c->x);
+}
+
+static void ncurses_canvas_delete(Canvas c) {
+    delwin(WIN(c));
+}
+
+static void ncurses_canvas_erase(Canvas c) {
+    werase(WIN(c));
+}
+
+static void ncurses_canvas_put(Canvas c, int row, int col,
+                               const Cell* cells, int n) {
+    struct ncurses_data* data = c->backend->data;
+
+    if (n > data->row_size) {
+        data->row_size = n;
+        data->row = realloc(data->row, sizeof(cchar_t) * n);
+        data->ascii_row = realloc(data->ascii_row, sizeof(chtype) * n);
+    }
+
+    /* printable ASCII without marks needs no wide characters, which saves
+       converting every cell with setcchar */
+    int ascii = 0;
+    while (ascii < n && cells[ascii].ch >= ' ' && cells[ascii].ch < 0x7f &&
+           !cells[ascii].mark)
+        ++ascii;
+
+    if (ascii == n) {
+        for (int i = 0 ; i < n ; ++i)
+            data->ascii_row[i] = cells[i].ch | data->attrs[cells[i].attr & 0x0f];
+
+        mvwaddchnstr(WIN(c), row, col, data->ascii_row, n);
+        return;
+    }
+
+    /* resolve the characters & attributes into ncurses ones, ncurses
+       covers the cell after a wide character itself */
+    int length = 0;
+    for (int i = 0 ; i < n ; ++i) {
+        if (cells[i].ch == CELL_WIDE)
+            continue;
+
+        wchar_t text[] = { cells[i].ch, cells[i].mark, L'\0' };
+        chtype attr = data->attrs[cells[i].attr & 0x0f];
+
+        setcchar(&data->row[length++], text, attr & ~A_COLOR,
+                 PAIR_NUMBER(attr), NULL);
+    }
+
+    mvwadd_wchnstr(WIN(c), row, col, data->row, length);
+}
+
+static void ncurses_canvas_stage(Canvas c) {
+    wmove(WIN(c), c->cursor_row, c->cursor_col);
+    wnoutrefresh(WIN(c));
+}
+
+static void ncurses_update(Backend b) {
+    (void)b;
+    doupdate();
+}
+
+static void ncurses_show_cursor(Backend b, bool show) {
+    (void)b;
+    curs_set(show ? 1 : 0);
+}
+
+static int ncurses_read_key(Backend b) {
+    timeout(b->timeout);
+    int c = getch();
+
+    /* follow the terminal's size */
+    if (c == KEY_RESIZE) {
+        b->rows = LINES;
+        b->cols = COLS;
+    }
+
+    return c;
+}
+
+static void ncurses_destroy(Backend b) {
+    struct ncurses_data* data = b->data;
+
+    endwin(); /* end curses mode */
+    printf(PASTE_MODE_OFF); /* stop bracketing pasted text */
+    fflush(stdout);
+
+    free(data->row);
+    free(data->ascii_row);
+    free(data);
+}
+
+/*****************************************************************************/
+/*                                  Backend                                  */
+/*****************************************************************************/
+
+/* initializes ncurses and creates a backend drawing on the terminal */
+Backend backend_ncurses_new() {
+    /* ncurses writes characters in the encoding of the locale */
+    setlocale(LC_CTYPE, "");
+
+    /* ncurses initialization */
+    initscr();
+    raw();
+    noecho();
+    keypad(stdscr, TRUE);
+
+    /* colors */
+    start_color();
+
+    init_pair(1, COLOR_BLUE, COLOR_BLACK);
+    init_pair(2, COLOR_GREEN, COLOR_BLACK);
+    init_pair(3, COLOR_YELLOW, COLOR_BLACK);
+
+    /* have the terminal bracket pasted text with markers */
+    define_key("\033[200~", KEY_PASTE_BEGIN);
+    define_key("\033[201~", KEY_PASTE_END);
+
+    /* xterm reports Ctrl with Home & End by a modifier parameter */
+    define_key("\033[1;5H", KEY_CTRL_HOME);
+    define_key("\033[1;5F", KEY_CTRL_END);
+
+    printf(PASTE_MODE_ON);
+    fflush(stdout);
+
+    refresh(); /* initially refresh stdscr */
+
+    struct ncurses_data* data = malloc(sizeof *data);
+    data->row = NULL;
+    data->ascii_row = NULL;
+    data->row_size = 0;
+
+    for (int i = 0 ; i < 16 ; ++i) {
+        data->attrs[i] = A_NORMAL;
+
+        if (i & ATTR_REVERSE)
+            data->attrs[i] |= A_REVERSE;
+        if (i & ATTR_BLUE)
+            data->attrs[i] |= COLOR_PAIR(1);
+        if (i & ATTR_GREEN)
+            data->attrs[i] |= COLOR_PAIR(2);
+        if (i & ATTR_YELLOW)
+            data->attrs[i] |= COLOR_PAIR(3);
+    }
+
+    Backend b = malloc(sizeof *b);
+
+    b->name = "ncurses";
+    b->rows = LINES;
+    b->cols = COLS;
+    b->timeout = -1;
+    b->fd = fileno(stdin);
+    b->frame_bytes = -1;
+    b->data = data;
+
+    b->canvas_new = ncurses_canvas_new;
+    b->canvas_delete = ncurses_canvas_delete;
+    b->canvas_erase = ncurses_canvas_erase;
+    b->canvas_put = ncurses_canvas_put;
+    b->canvas_stage = ncurses_canvas_stage;
+    b->update = ncurses_update;
+    b->show_cursor = ncurses_show_cursor;
+    b->read_key = ncurses_read_key;
+    b->destroy = ncurses_destroy;
+
+    return b;
+}
@@ -0,0 +1,234 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "backend.h"
+#include "histogram.h"
+#include "keytrace.h"
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* the session backend's state */
+#define DATA(b) ((struct session_data*)(b)->data)
+
+/* the wrapped backend's canvas standing behind a canvas */
+#define INNER(c) ((Canvas)(c)->data)
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* state of the recording & replaying backends */
+struct session_data {
+    Backend inner; /* backend everything is drawn on */
+    KeyTrace trace; /* keys recorded or being replayed */
+    size_t next; /* next key to replay */
+    bool max_speed; /* if keys are replayed without waiting */
+    uint64_t start; /* time the first key was read, 0 before that */
+};
+
+static void session_canvas_new(Canvas c) {
+    c->data = canvas_new(DATA(c->backend)->inner,
+                         c->rows, c->cols, c->y, c->x);
+}
+
+static void session_canvas_delete(Canvas c) {
+    canvas_delete(INNER(c));
+}
+
+static void session_canvas_erase(Canvas c) {
+    canvas_erase(INNER(c));
+}
+
+static void session_canvas_put(Canvas c, int row, int col,
+                               const Cell* cells, int n) {
+    canvas_put(INNER(c), row, col, cells, n);
+}
+
+static void session_canvas_stage(Canvas c) {
+    canvas_move(INNER(c), c->cursor_row, c->cursor_col);
+    canvas_stage(INNER(c));
+}
+
+static void session_update(Backend b) {
+    backend_update(DATA(b)->inner);
+    b->frame_bytes = DATA(b)->inner->frame_bytes;
+}
+
+static void session_show_cursor(Backend b, bool show) {
+    backend_show_cursor(DATA(b)->inner, show);
+}
+
+/* reads a key from the wrapped backend, following its size */
+static int session_read_inner(Backend b, int timeout) {
+    Backend inner = DATA(b)->inner;
+
+    /* the session starts once the editor is ready for keys */
+    if (DATA(b)->start == 0)
+        DATA(b)->start = time_us();
+
+    backend_timeout(inner, timeout);
+    int c = backend_read_key(inner);
+
+    if (c == KEY_RESIZE) {
+        b->rows = inner->rows;
+        b->cols = inner->cols;
+    }
+
+    return c;
+}
+
+/* reads a key and appends it to the recording, which only buffers it */
+static int record_read_key(Backend b) {
+    struct session_data* data = DATA(b);
+    int c = session_read_inner(b, b->timeout);
+
+    if (c != ERR)
+        keytrace_add(data->trace, c, time_us() - data->start);
+
+    return c;
+}
+
+/* returns the next key of the trace once it is due, the wrapped backend is
+   only listened to for resizes until the trace runs out */
+static int replay_read_key(Backend b) {
+    struct session_data* data = DATA(b);
+    KeyTrace t = data->trace;
+
+    if (data->next == t->length)
+        return session_read_inner(b, b->timeout);
+
+    if (data->start == 0)
+        data->start = time_us();
+
+    uint64_t due = data->start + t->events[data->next].time;
+
+    for (;;) {
+        uint64_t now = time_us();
+
+        if (data->max_speed || now >= due)
+            return t->events[data->next++].key;
+
+        /* wait until the key is due or the timeout runs out */
+        long wait = (due - now + 999) / 1000;
+        bool timed_out = b->timeout >= 0 && b->timeout < wait;
+
+        if (timed_out)
+            wait = b->timeout;
+
+        int c = session_read_inner(b, wait);
+
+        if (c == KEY_RESIZE)
+            return c;
+
+        if (timed_out)
+            return ERR;
+    }
+}
+
+/* shows the frame & writes the keys read for it into the recording's file,
+   once a frame rather than once a key so a paste doesn't write every key
+   on its own, a crash or a hang still keeps the keys of every shown frame */
+static void record_update(Backend b) {
+    session_update(b);
+    keytrace_flush(DATA(b)->trace);
+}
+
+static void record_destroy(Backend b) {
+    struct session_data* data = DATA(b);
+
+    backend_destroy(data->inner);
+
+    if (!keytrace_finish(data->trace))
+        fprintf(stderr, "text-editor: cannot save the whole recording\n");
+
+    keytrace_destroy(data->trace);
+    free(data);
+}
+
+static void replay_destroy(Backend b) {
+    backend_destroy(DATA(b)->inner);
+    keytrace_destroy(DATA(b)->trace);
+    free(DATA(b));
+}
+
+/* creates a backend wrapping another one, to read keys in its own way */
+static Backend session_new(Backend inner, KeyTrace trace) {
+    struct session_data* data = malloc(sizeof *data);
+
+    data->inner = inner;
+    data->trace = trace;
+    data->next = 0;
+    data->max_speed = false;
+    data->start = 0;
+
+    Backend b = malloc(sizeof *b);
+
+    b->name = inner->name;
+    b->rows = inner->rows;
+    b->cols = inner->cols;
+    b->timeout = -1;
+    b->fd = inner->fd;
+    b->frame_bytes = inner->frame_bytes;
+    b->data = data;
+
+    b->canvas_new = session_canvas_new;
+    b->canvas_delete = session_canvas_delete;
+    b->canvas_erase = session_canvas_erase;
+    b->canvas_put = session_canvas_put;
+    b->canvas_stage = session_canvas_stage;
+    b->update = session_update;
+    b->show_cursor = session_show_cursor;
+
+    return b;
+}
+
+/*****************************************************************************/
+/*                                  Backends                                 */
+/*****************************************************************************/
+
+/* creates a backend recording keys read from the given backend into a trace */
+Backend backend_record_new(Backend inner, KeyTrace trace) {
+    Backend b = session_new(inner, trace);
+
+    b->update = record_update;
+    b->read_key = record_read_key;
+    b->destroy = record_destroy;
+
+    return b;
+}
+
+/* creates a backend replaying a trace instead of reading keys */
+Backend backend_replay_new(Backend inner, KeyTrace trace, bool max_speed) {
+    Backend b = session_new(inner, trace);
+
+    DATA(b)->max_speed = max_speed;
+
+    b->read_key = replay_read_key;
+    b->destroy = replay_destroy;
+
+    return b;
+}
@@ -0,0 +1,750 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#include "backend.h"
+#include "utf8.h"
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* the canvas's cells */
+#define CELLS(c) ((Cell*)(c)->data)
+
+/* the terminal backend's state */
+#define DATA(b) ((struct term_data*)(b)->data)
+
+/* milliseconds to wait for the rest of an escape sequence */
+#define ESCAPE_DELAY 25
+
+/* size of the buffer for keys read but not decoded yet */
+#define KEYS_SIZE 4096
+
+/* at most this many unchanged cells are written over instead of jumping */
+#define MAX_REWRITE 4
+
+/* runs of at least this many spaces are erased instead of written */
+#define MIN_ERASE 6
+
+/* results of decoding keys besides the keys themselves */
+#define KEY_NONE -1 /* nothing was read */
+#define KEY_INCOMPLETE -2 /* only a part of an escape sequence was read */
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* state of the terminal backend */
+struct term_data {
+    int in; /* file descriptor keys are read from */
+    int out; /* file descriptor the screen is written to */
+    bool raw; /* if the terminal was switched to raw mode */
+    struct termios original; /* terminal settings to restore */
+
+    Cell* front; /* screen as shown on the terminal */
+    Cell* back; /* screen with canvases staged for the next update */
+    uint64_t* front_hashes; /* hash of every row of the front screen */
+    uint64_t* back_hashes; /* hash of every row of the back screen */
+    uint cursor_row; /* cursor's row for the next update */
+    uint cursor_col; /* cursor's column for the next update */
+
+    int row; /* row of the terminal's cursor, -1 if unknown */
+    int col; /* column of the terminal's cursor, -1 if unknown */
+    int attr; /* attributes the terminal writes with, -1 if unknown */
+
+    char* output; /* escape sequences and text of the update */
+    size_t output_length; /* number of bytes in the output */
+    size_t output_size; /* size of the output buffer */
+
+    unsigned char keys[KEYS_SIZE]; /* bytes read but not decoded yet */
+    uint keys_length; /* number of bytes in the buffer */
+};
+
+/* set by the signal handler when the terminal changes size */
+static volatile sig_atomic_t term_resized = 0;
+
+static void term_handle_resize(int signal) {
+    (void)signal;
+    term_resized = 1;
+}
+
+/* appends bytes to the output */
+static void term_write(struct term_data* data, const char* bytes, size_t n) {
+    if (data->output_length + n > data->output_size) {
+        data->output_size = (data->output_length + n) * 2;
+        data->output = realloc(data->output, data->output_size);
+    }
+
+    memcpy(data->output + data->output_length, bytes, n);
+    data->output_length += n;
+}
+
+/* appends a formatted escape sequence to the output */
+static void term_printf(struct term_data* data, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void term_printf(struct term_data* data, const char* format, ...) {
+    char sequence[32];
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(sequence, sizeof sequence, format, args);
+    va_end(args);
+
+    term_write(data, sequence, n);
+}
+
+/* writes the whole output to the terminal */
+static void term_flush(struct term_data* data) {
+    size_t done = 0;
+
+    while (done < data->output_length) {
+        ssize_t n = write(data->out, data->output + done,
+                          data->output_length - done);
+
+        if (n < 0 && errno != EINTR && errno != EAGAIN)
+            break;
+        if (n > 0)
+            done += n;
+    }
+
+    data->output_length = 0;
+}
+
+/* fills cells with blanks */
+static void term_clear(Cell* cells, int n) {
+    for (int i = 0 ; i < n ; ++i)
+        cells[i] = (Cell){ ' ', ATTR_NONE, 0 };
+}
+
+/* FNV-1a hash of a row of cells */
+static uint64_t term_hash(const Cell* cells, uint n) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (uint i = 0 ; i < n ; ++i) {
+        hash = (hash ^ cells[i].ch) * 1099511628211ULL;
+        hash = (hash ^ cells[i].mark) * 1099511628211ULL;
+        hash = (hash ^ cells[i].attr) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/* reads the size of the terminal, from the environment if it has none */
+static void term_read_size(Backend b) {
+    struct winsize size;
+
+    if (ioctl(DATA(b)->out, TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+        b->rows = size.ws_row;
+        b->cols = size.ws_col;
+        return;
+    }
+
+    char* lines = getenv("LINES");
+    char* columns = getenv("COLUMNS");
+
+    b->rows = (lines && atoi(lines) > 0) ? atoi(lines) : 24;
+    b->cols = (columns && atoi(columns) > 0) ? atoi(columns) : 80;
+}
+
+/* allocates both screens for the current size, the terminal is cleared */
+static void term_allocate(Backend b) {
+    struct term_data* data = DATA(b);
+    uint n = b->rows * b->cols;
+
+    free(data->front);
+    free(data->back);
+    free(data->front_hashes);
+    free(data->back_hashes);
+
+    data->front = malloc(sizeof(Cell) * n);
+    data->back = malloc(sizeof(Cell) * n);
+    data->front_hashes = malloc(sizeof(uint64_t) * b->rows);
+    data->back_hashes = malloc(sizeof(uint64_t) * b->rows);
+
+    term_clear(data->front, n);
+    term_clear(data->back, n);
+
+    data->cursor_row = 0;
+    data->cursor_col = 0;
+
+    /* clear the terminal to match the front screen */
+    term_write(data, "\033[0m\033[H\033[2J", 11);
+    data->row = 0;
+    data->col = 0;
+    data->attr = ATTR_NONE;
+}
+
+/*****************************************************************************/
+/*                                   Output                                  */
+/*****************************************************************************/
+
+/* switches the attributes the terminal writes with */
+static void term_attr(struct term_data* data, int attr) {
+    if (data->attr == attr)
+        return;
+
+    term_write(data, "\033[0", 3);
+
+    if (attr & ATTR_REVERSE)
+        term_write(data, ";7", 2);
+    if (attr & ATTR_BLUE)
+        term_write(data, ";34", 3);
+    if (attr & ATTR_GREEN)
+        term_write(data, ";32", 3);
+    if (attr & ATTR_YELLOW)
+        term_write(data, ";33", 3);
+
+    term_write(data, "m", 1);
+    data->attr = attr;
+}
+
+/* puts a cell at the cursor's position, a wide character is put together
+   with the cell it covers */
+static void term_put(Backend b, int row, int col, Cell cell) {
+    struct term_data* data = DATA(b);
+    int width = 1;
+
+    term_attr(data, cell.attr);
+
+    if (cell.ch < 0x80) {
+        /* half of a wide character without the other half is blank */
+        char c = (cell.ch == CELL_WIDE) ? ' ' : cell.ch;
+        term_write(data, &c, 1);
+    } else {
+        char bytes[UTF8_MAX_LENGTH];
+        term_write(data, bytes, utf8_encode(cell.ch, bytes));
+        width = utf8_width(cell.ch);
+    }
+
+    if (cell.mark) {
+        char bytes[UTF8_MAX_LENGTH];
+        term_write(data, bytes, utf8_encode(cell.mark, bytes));
+    }
+
+    data->front[row * b->cols + col] = cell;
+    if (width == 2)
+        data->front[row * b->cols + col+1] = (Cell){ CELL_WIDE, cell.attr, 0 };
+
+    /* the cursor stays at the last column until the next character */
+    data->col += width;
+    if (data->col >= (int)b->cols)
+        data->row = data->col = -1;
+}
+
+/* moves the terminal's cursor using the shortest sequence */
+static void term_move(Backend b, int row, int col) {
+    struct term_data* data = DATA(b);
+
+    if (data->row == row && data->col == col)
+        return;
+
+    if (data->row == row && data->col < col) {
+        int distance = col - data->col;
+
+        /* write over a few cells which are already right, as long as
+           they are plain ASCII */
+        bool rewrite = distance <= MAX_REWRITE;
+        for (int i = 0 ; rewrite && i < distance ; ++i) {
+            Cell cell = data->front[row * b->cols + data->col + i];
+            rewrite = cell.attr == data->attr && cell.ch < 0x80 &&
+                cell.ch != CELL_WIDE && !cell.mark;
+        }
+
+        if (rewrite) {
+            while (data->col < col)
+                term_put(b, row, data->col,
+                         data->front[row * b->cols + data->col]);
+            return;
+        }
+
+        term_printf(data, "\033[%dC", distance);
+    } else if (col == 0 && data->row >= 0 && row == data->row+1) {
+        term_write(data, "\r\n", 2);
+    } else if (col == 0 && data->row == row) {
+        term_write(data, "\r", 1);
+    } else if (col == 0) {
+        term_printf(data, "\033[%dH", row+1);
+    } else {
+        term_printf(data, "\033[%d;%dH", row+1, col+1);
+    }
+
+    data->row = row;
+    data->col = col;
+}
+
+/* scrolls a region of the terminal by a number of rows, up if positive */
+static void term_scroll(Backend b, int top, int bottom, int shift) {
+    struct term_data* data = DATA(b);
+    int n = (shift > 0) ? shift : -shift;
+    size_t row_size = sizeof(Cell) * b->cols;
+
+    /* revealed rows are filled with plain blanks */
+    term_attr(data, ATTR_NONE);
+    term_printf(data, "\033[%d;%dr\033[%d%c\033[r", top+1, bottom+1, n,
+                (shift > 0) ? 'S' : 'T');
+
+    /* setting the region moved the cursor home */
+    data->row = 0;
+    data->col = 0;
+
+    /* the front screen scrolls the same way */
+    if (shift > 0) {
+        memmove(data->front + top * b->cols, data->front + (top+n) * b->cols,
+                row_size * (bottom-top+1-n));
+        memmove(data->front_hashes + top, data->front_hashes + top+n,
+                sizeof(uint64_t) * (bottom-top+1-n));
+        top = bottom+1-n;
+    } else {
+        memmove(data->front + (top+n) * b->cols, data->front + top * b->cols,
+                row_size * (bottom-top+1-n));
+        memmove(data->front_hashes + top+n, data->front_hashes + top,
+                sizeof(uint64_t) * (bottom-top+1-n));
+    }
+
+    for (int row = top ; row < top+n ; ++row) {
+        term_clear(data->front + row * b->cols, b->cols);
+        data->front_hashes[row] = term_hash(data->front + row * b->cols, b->cols);
+    }
+}
+
+/* scrolls the terminal if the longest run of rows which moved since the last
+   update is long enough to be worth it */
+static void term_detect_scroll(Backend b) {
+    struct term_data* data = DATA(b);
+    int rows = b->rows;
+
+    for (int row = 0 ; row < rows ; ++row) {
+        data->front_hashes[row] = term_hash(data->front + row * b->cols, b->cols);
+        data->back_hashes[row] = term_hash(data->back + row * b->cols, b->cols);
+    }
+
+    int best_shift = 0, best_start = 0, best_length = 0;
+
+    /* back row r showing what front row r+shift shows */
+    for (int shift = 1-rows ; shift < rows ; ++shift) {
+        if (shift == 0)
+            continue;
+
+        int length = 0;
+        for (int row = 0 ; row < rows ; ++row) {
+            int from = row + shift;
+            bool moved = from >= 0 && from < rows &&
+                data->back_hashes[row] == data->front_hashes[from] &&
+                data->back_hashes[row] != data->front_hashes[row];
+
+            length = moved ? length+1 : 0;
+
+            if (length > best_length) {
+                best_length = length;
+                best_start = row-length+1;
+                best_shift = shift;
+            }
+        }
+    }
+
+    /* a scroll sequence is about as long as writing a few cells */
+    if (best_length < 2)
+        return;
+
+    int top, bottom;
+    if (best_shift > 0) {
+        top = best_start;
+        bottom = best_start + best_length-1 + best_shift;
+    } else {
+        top = best_start + best_shift;
+        bottom = best_start + best_length-1;
+    }
+
+    term_scroll(b, top, bottom, best_shift);
+}
+
+/* writes the cells of a row which differ from the front screen */
+static void term_update_row(Backend b, int row) {
+    struct term_data* data = DATA(b);
+    Cell* back = data->back + row * b->cols;
+    Cell* front = data->front + row * b->cols;
+    int cols = b->cols;
+
+    for (int col = 0 ; col < cols ; ) {
+        if (back[col].ch == front[col].ch && back[col].attr == front[col].attr &&
+            back[col].mark == front[col].mark) {
+            col++;
+            continue;
+        }
+
+        /* the second half of a wide character is written with the first */
+        if (back[col].ch == CELL_WIDE && col > 0 && back[col-1].ch >= 0x80 &&
+            utf8_width(back[col-1].ch) == 2)
+            col--;
+
+        term_move(b, row, col);
+
+        /* erase runs of spaces instead of writing them */
+        int spaces = 0;
+        while (col+spaces < cols && back[col+spaces].ch == ' ' &&
+               back[col+spaces].attr == ATTR_NONE)
+            spaces++;
+
+        if (spaces >= MIN_ERASE || (spaces > 2 && col+spaces == cols)) {
+            term_attr(data, ATTR_NONE);
+
+            if (col+spaces == cols)
+                term_write(data, "\033[K", 3);
+            else
+                term_printf(data, "\033[%dX", spaces);
+
+            memcpy(front + col, back + col, sizeof(Cell) * spaces);
+            col += spaces;
+            continue;
+        }
+
+        /* a wide character which doesn't fit is left out */
+        bool wide = back[col].ch >= 0x80 && utf8_width(back[col].ch) == 2;
+        if (wide && (col+1 == cols || back[col+1].ch != CELL_WIDE)) {
+            term_put(b, row, col, (Cell){ ' ', back[col].attr, 0 });
+            front[col] = back[col];
+            col++;
+            continue;
+        }
+
+        term_put(b, row, col, back[col]);
+        col += (wide) ? 2 : 1;
+    }
+}
+
+/*****************************************************************************/
+/*                                   Input                                   */
+/*****************************************************************************/
+
+/* escape sequences of keys */
+static const struct {
+    const char* sequence;
+    int key;
+} term_keys[] = {
+    { "\033[A", KEY_UP }, { "\033[B", KEY_DOWN },
+    { "\033[C", KEY_RIGHT }, { "\033[D", KEY_LEFT },
+    { "\033OA", KEY_UP }, { "\033OB", KEY_DOWN },
+    { "\033OC", KEY_RIGHT }, { "\033OD", KEY_LEFT },
+    { "\033[H", KEY_HOME }, { "\033OH", KEY_HOME },
+    { "\033[1~", KEY_HOME }, { "\033[7~", KEY_HOME },
+    { "\033[F", KEY_END }, { "\033OF", KEY_END },
+    { "\033[4~", KEY_END }, { "\033[8~", KEY_END },
+    { "\033[2~", KEY_IC }, { "\033[3~", KEY_DC },
+    { "\033[5~", KEY_PPAGE }, { "\033[6~", KEY_NPAGE },
+    { "\033[1;5H", KEY_CTRL_HOME }, { "\033[7^", KEY_CTRL_HOME },
+    { "\033[1;5F", KEY_CTRL_END }, { "\033[8^", KEY_CTRL_END },
+    { "\033[200~", KEY_PASTE_BEGIN }, { "\033[201~", KEY_PASTE_END },
+};
+
+/* removes decoded bytes from the beginning of the buffer */
+static void term_consume(struct term_data* data, uint n) {
+    memmove(data->keys, data->keys + n, data->keys_length - n);
+    data->keys_length -= n;
+}
+
+/* decodes the next key from the buffer */
+static int term_decode(struct term_data* data) {
+    unsigned char* keys = data->keys;
+    uint length = data->keys_length;
+
+    if (length == 0)
+        return KEY_NONE;
+
+    if (keys[0] != '\033' || length == 1) {
+        int c = keys[0];
+
+        /* a lone escape might be the beginning of a sequence */
+        if (c == '\033')
+            return KEY_INCOMPLETE;
+
+        term_consume(data, 1);
+        return c;
+    }
+
+    bool incomplete = false;
+
+    for (uint i = 0 ; i < sizeof term_keys / sizeof term_keys[0] ; ++i) {
+        uint n = strlen(term_keys[i].sequence);
+
+        if (length >= n && memcmp(keys, term_keys[i].sequence, n) == 0) {
+            term_consume(data, n);
+            return term_keys[i].key;
+        }
+
+        if (length < n && memcmp(keys, term_keys[i].sequence, length) == 0)
+            incomplete = true;
+    }
+
+    if (incomplete)
+        return KEY_INCOMPLETE;
+
+    /* swallow unknown control sequences whole, reporting an escape */
+    if (keys[1] == '[') {
+        for (uint i = 2 ; i < length ; ++i) {
+            if (keys[i] >= 0x40 && keys[i] <= 0x7e) {
+                term_consume(data, i+1);
+                return '\033';
+            }
+        }
+
+        return KEY_INCOMPLETE;
+    }
+
+    term_consume(data, 1);
+    return '\033';
+}
+
+/* current monotonic time in milliseconds */
+static long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*****************************************************************************/
+/*                               Backend Hooks                               */
+/*****************************************************************************/
+
+static void term_canvas_new(Canvas c) {
+    c->data = malloc(sizeof(Cell) * c->rows * c->cols);
+    term_clear(CELLS(c), c->rows * c->cols);
+}
+
+static void term_canvas_delete(Canvas c) {
+    free(c->data);
+}
+
+static void term_canvas_erase(Canvas c) {
+    term_clear(CELLS(c), c->rows * c->cols);
+}
+
+static void term_canvas_put(Canvas c, int row, int col,
+                            const Cell* cells, int n) {
+    memcpy(CELLS(c) + row * c->cols + col, cells, sizeof(Cell) * n);
+}
+
+static void term_canvas_stage(Canvas c) {
+    Backend b = c->backend;
+
+    /* copy the part of the canvas which is on the screen */
+    for (int row = 0 ; row < c->rows ; ++row) {
+        int y = c->y + row;
+        if (y < 0 || y >= (int)b->rows)
+            continue;
+
+        int from = (c->x < 0) ? -c->x : 0;
+        int to = ((int)b->cols - c->x < c->cols) ? (int)b->cols - c->x : c->cols;
+
+        if (to > from)
+            memcpy(DATA(b)->back + y * b->cols + c->x + from,
+                   CELLS(c) + row * c->cols + from, sizeof(Cell) * (to - from));
+    }
+
+    DATA(b)->cursor_row = c->y + c->cursor_row;
+    DATA(b)->cursor_col = c->x + c->cursor_col;
+}
+
+/* writes the difference between the back and front screens */
+static void term_update(Backend b) {
+    struct term_data* data = DATA(b);
+
+    term_detect_scroll(b);
+
+    for (uint row = 0 ; row < b->rows ; ++row) {
+        if (memcmp(data->back + row * b->cols, data->front + row * b->cols,
+                   sizeof(Cell) * b->cols) != 0)
+            term_update_row(b, row);
+    }
+
+    term_move(b, data->cursor_row, data->cursor_col);
+
+    b->frame_bytes = data->output_length;
+    term_flush(data);
+}
+
+static void term_show_cursor(Backend b, bool show) {
+    term_write(DATA(b), show ? "\033[?25h" : "\033[?25l", 6);
+    term_flush(DATA(b));
+}
+
+static int term_read_key(Backend b) {
+    struct term_data* data = DATA(b);
+    long deadline = now_ms() + b->timeout;
+
+    for (;;) {
+        /* the screen is laid out again after a resize */
+        if (term_resized) {
+            term_resized = 0;
+            term_read_size(b);
+            term_allocate(b);
+            term_flush(data);
+            return KEY_RESIZE;
+        }
+
+        int c = term_decode(data);
+        if (c >= 0)
+            return c;
+
+        /* wait for the rest of a sequence only briefly */
+        int wait = b->timeout;
+        if (c == KEY_INCOMPLETE) {
+            wait = ESCAPE_DELAY;
+        } else if (b->timeout > 0) {
+            wait = deadline - now_ms();
+            if (wait < 0)
+                wait = 0;
+        }
+
+        struct pollfd input = { data->in, POLLIN, 0 };
+        int ready = poll(&input, 1, wait);
+
+        /* interrupted, possibly by a resize */
+        if (ready < 0)
+            continue;
+
+        if (ready == 0) {
+            /* it was just the escape key */
+            if (c == KEY_INCOMPLETE) {
+                term_consume(data, 1);
+                return '\033';
+            }
+
+            return ERR;
+        }
+
+        ssize_t n = read(data->in, data->keys + data->keys_length,
+                         KEYS_SIZE - data->keys_length);
+
+        /* nothing more is ever coming */
+        if (n == 0) {
+            if (c == KEY_INCOMPLETE) {
+                term_consume(data, 1);
+                return '\033';
+            }
+
+            return ERR;
+        }
+
+        if (n > 0)
+            data->keys_length += n;
+    }
+}
+
+static void term_destroy(Backend b) {
+    struct term_data* data = DATA(b);
+
+    /* leave the terminal as it was */
+    term_write(data, "\033[0m\033[?25h\033[?2004l\033[?1049l", 26);
+    term_flush(data);
+
+    if (data->raw)
+        tcsetattr(data->in, TCSADRAIN, &data->original);
+
+    signal(SIGWINCH, SIG_DFL);
+
+    free(data->front);
+    free(data->back);
+    free(data->front_hashes);
+    free(data->back_hashes);
+    free(data->output);
+    free(data);
+}
+
+/*****************************************************************************/
+/*                                  Backend                                  */
+/*****************************************************************************/
+
+/* creates a backend drawing on a terminal with its own escape sequences */
+Backend backend_term_new(int in, int out) {
+    struct term_data* data = malloc(sizeof *data);
+
+    data->in = in;
+    data->out = out;
+
+    /* keys come in as they are typed, only enter is translated */
+    data->raw = tcgetattr(in, &data->original) == 0;
+    if (data->raw) {
+        struct termios raw = data->original;
+        cfmakeraw(&raw);
+        raw.c_iflag |= ICRNL;
+        tcsetattr(in, TCSADRAIN, &raw);
+    }
+
+    /* interrupt waiting for keys when the terminal changes size */
+    struct sigaction action;
+    memset(&action, 0, sizeof action);
+    action.sa_handler = term_handle_resize;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGWINCH, &action, NULL);
+
+    data->front = NULL;
+    data->back = NULL;
+    data->front_hashes = NULL;
+    data->back_hashes = NULL;
+
+    data->output = NULL;
+    data->output_length = 0;
+    data->output_size = 0;
+
+    data->keys_length = 0;
+
+    Backend b = malloc(sizeof *b);
+
+    b->name = "term";
+    b->timeout = -1;
+    b->fd = in;
+    b->frame_bytes = 0;
+    b->data = data;
+
+    b->canvas_new = term_canvas_new;
+    b->canvas_delete = term_canvas_delete;
+    b->canvas_erase = term_canvas_erase;
+    b->canvas_put = term_canvas_put;
+    b->canvas_stage = term_canvas_stage;
+    b->update = term_update;
+    b->show_cursor = term_show_cursor;
+    b->read_key = term_read_key;
+    b->destroy = term_destroy;
+
+    /* use the alternate screen and have pasted text bracketed */
+    term_write(data, "\033[?1049h\033[?2004h", 16);
+
+    term_read_size(b);
+    term_allocate(b);
+    term_flush(data);
+
+    return b;
+}
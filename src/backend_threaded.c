@@ -0,0 +1,376 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "backend.h"
+#include "trace.h"
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* the threaded backend's state */
+#define DATA(b) ((struct threaded_data*)(b)->data)
+
+/* the headless canvas standing behind a canvas */
+#define INNER(c) ((Canvas)(c)->data)
+
+/*****************************************************************************/
+/*                                   Frames                                  */
+/*****************************************************************************/
+
+/* immutable picture of the whole screen, handed over to the render thread */
+struct frame {
+    uint rows; /* number of rows */
+    uint cols; /* number of columns */
+    uint cursor_row; /* cursor's row */
+    uint cursor_col; /* cursor's column */
+    Cell* cells; /* rows*cols cells, row after row */
+    uint size; /* number of cells allocated */
+};
+
+static void frame_destroy(struct frame* f) {
+    if (!f)
+        return;
+
+    free(f->cells);
+    free(f);
+}
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* state of the threaded backend */
+struct threaded_data {
+    Backend composer; /* headless backend the editor draws on */
+    Backend terminal; /* backend frames are drawn on by the render thread */
+    Canvas screen; /* canvas covering the whole terminal */
+
+    pthread_t thread; /* the render thread */
+    pthread_mutex_t terminal_lock; /* held while using the terminal */
+    pthread_mutex_t lock; /* held while using the fields below */
+    pthread_cond_t ready; /* signalled when a frame is published */
+    pthread_cond_t idle; /* signalled when a frame is drawn */
+
+    struct frame* pending; /* frame waiting to be drawn */
+    struct frame* spare; /* drawn frame kept for reuse */
+    bool drawing; /* if the render thread is drawing a frame */
+    bool quit; /* if the render thread should stop */
+    unsigned long dropped; /* number of frames replaced before drawing */
+    long frame_bytes; /* bytes the terminal wrote for the last drawn frame */
+};
+
+/* draws a frame on the terminal, called with the terminal lock held */
+static void threaded_draw(struct threaded_data* data, struct frame* f) {
+    Backend t = data->terminal;
+
+    /* the terminal changed size, cover it again */
+    if (!data->screen || data->screen->rows != (int)t->rows ||
+        data->screen->cols != (int)t->cols) {
+        canvas_delete(data->screen);
+        data->screen = canvas_new(t, t->rows, t->cols, 0, 0);
+    }
+
+    for (uint row = 0 ; row < f->rows ; ++row)
+        canvas_put(data->screen, row, 0, f->cells + row * f->cols, f->cols);
+
+    canvas_move(data->screen, f->cursor_row, f->cursor_col);
+    canvas_stage(data->screen);
+    backend_update(t);
+}
+
+/* takes published frames and draws them until asked to quit */
+static void* threaded_render(void* arg) {
+    struct threaded_data* data = arg;
+
+    /* leave resize signals to the thread reading keys */
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGWINCH);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_mutex_lock(&data->lock);
+
+    for (;;) {
+        while (!data->pending && !data->quit)
+            pthread_cond_wait(&data->ready, &data->lock);
+
+        if (data->quit)
+            break;
+
+        struct frame* f = data->pending;
+        data->pending = NULL;
+        data->drawing = true;
+        pthread_mutex_unlock(&data->lock);
+
+        uint64_t span = trace_begin();
+
+        pthread_mutex_lock(&data->terminal_lock);
+        threaded_draw(data, f);
+        pthread_mutex_unlock(&data->terminal_lock);
+
+        trace_end("threaded_draw", span);
+
+        pthread_mutex_lock(&data->lock);
+        data->drawing = false;
+        data->frame_bytes = data->terminal->frame_bytes;
+
+        /* keep the frame for the next one to be composed into */
+        frame_destroy(data->spare);
+        data->spare = f;
+
+        pthread_cond_broadcast(&data->idle);
+    }
+
+    pthread_mutex_unlock(&data->lock);
+
+    return NULL;
+}
+
+static void threaded_canvas_new(Canvas c) {
+    c->data = canvas_new(DATA(c->backend)->composer,
+                         c->rows, c->cols, c->y, c->x);
+}
+
+static void threaded_canvas_delete(Canvas c) {
+    canvas_delete(INNER(c));
+}
+
+static void threaded_canvas_erase(Canvas c) {
+    canvas_erase(INNER(c));
+}
+
+static void threaded_canvas_put(Canvas c, int row, int col,
+                                const Cell* cells, int n) {
+    canvas_put(INNER(c), row, col, cells, n);
+}
+
+static void threaded_canvas_stage(Canvas c) {
+    canvas_move(INNER(c), c->cursor_row, c->cursor_col);
+    canvas_stage(INNER(c));
+}
+
+/* publishes the composed screen as a frame, replacing one not drawn yet */
+static void threaded_update(Backend b) {
+    struct threaded_data* data = DATA(b);
+    Backend composer = data->composer;
+
+    backend_update(composer);
+
+    /* reuse the last drawn frame if there is one */
+    pthread_mutex_lock(&data->lock);
+    struct frame* f = data->spare;
+    data->spare = NULL;
+    pthread_mutex_unlock(&data->lock);
+
+    if (!f) {
+        f = malloc(sizeof *f);
+        f->cells = NULL;
+        f->size = 0;
+    }
+
+    f->rows = composer->rows;
+    f->cols = composer->cols;
+
+    if (f->size < f->rows * f->cols) {
+        f->size = f->rows * f->cols;
+        f->cells = realloc(f->cells, sizeof(Cell) * f->size);
+    }
+
+    for (uint row = 0 ; row < f->rows ; ++row)
+        memcpy(f->cells + row * f->cols, backend_headless_row(composer, row),
+               sizeof(Cell) * f->cols);
+
+    backend_headless_cursor(composer, &f->cursor_row, &f->cursor_col);
+
+    /* hand the frame over, dropping the one the thread did not get to */
+    pthread_mutex_lock(&data->lock);
+
+    if (data->pending) {
+        data->dropped++;
+
+        if (data->spare)
+            frame_destroy(data->pending);
+        else
+            data->spare = data->pending;
+    }
+
+    data->pending = f;
+    b->frame_bytes = data->frame_bytes;
+    pthread_cond_signal(&data->ready);
+    pthread_mutex_unlock(&data->lock);
+}
+
+static void threaded_show_cursor(Backend b, bool show) {
+    pthread_mutex_lock(&DATA(b)->terminal_lock);
+    backend_show_cursor(DATA(b)->terminal, show);
+    pthread_mutex_unlock(&DATA(b)->terminal_lock);
+}
+
+/* current monotonic time in milliseconds */
+static long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* reads a key, waiting for input without holding the terminal, so that the
+   render thread can draw meanwhile */
+static int threaded_read_key(Backend b) {
+    struct threaded_data* data = DATA(b);
+    Backend t = data->terminal;
+    long deadline = now_ms() + b->timeout;
+    int c;
+
+    for (;;) {
+        /* take whatever the terminal has already got */
+        pthread_mutex_lock(&data->terminal_lock);
+        backend_timeout(t, 0);
+        c = backend_read_key(t);
+        pthread_mutex_unlock(&data->terminal_lock);
+
+        if (c != ERR || t->fd < 0 || b->timeout == 0)
+            break;
+
+        long left = -1;
+        if (b->timeout > 0) {
+            left = deadline - now_ms();
+            if (left <= 0)
+                break;
+        }
+
+        /* wait for more, interrupted by signals such as a resize */
+        struct pollfd input = { t->fd, POLLIN, 0 };
+        poll(&input, 1, left);
+    }
+
+    /* follow the terminal's size */
+    if (c == KEY_RESIZE) {
+        b->rows = t->rows;
+        b->cols = t->cols;
+        backend_headless_resize(data->composer, t->rows, t->cols);
+    }
+
+    return c;
+}
+
+static void threaded_destroy(Backend b) {
+    struct threaded_data* data = DATA(b);
+
+    /* stop the render thread */
+    pthread_mutex_lock(&data->lock);
+    data->quit = true;
+    pthread_cond_signal(&data->ready);
+    pthread_mutex_unlock(&data->lock);
+
+    pthread_join(data->thread, NULL);
+
+    frame_destroy(data->pending);
+    frame_destroy(data->spare);
+
+    canvas_delete(data->screen);
+    backend_destroy(data->terminal);
+    backend_destroy(data->composer);
+
+    pthread_mutex_destroy(&data->terminal_lock);
+    pthread_mutex_destroy(&data->lock);
+    pthread_cond_destroy(&data->ready);
+    pthread_cond_destroy(&data->idle);
+
+    free(data);
+}
+
+/*****************************************************************************/
+/*                                  Backend                                  */
+/*****************************************************************************/
+
+/* creates a backend composing frames in memory and drawing them on the given
+   backend from a separate thread */
+Backend backend_threaded_new(Backend terminal) {
+    struct threaded_data* data = malloc(sizeof *data);
+
+    data->composer = backend_headless_new(terminal->rows, terminal->cols);
+    data->terminal = terminal;
+    data->screen = NULL;
+
+    pthread_mutex_init(&data->terminal_lock, NULL);
+    pthread_mutex_init(&data->lock, NULL);
+    pthread_cond_init(&data->ready, NULL);
+    pthread_cond_init(&data->idle, NULL);
+
+    data->pending = NULL;
+    data->spare = NULL;
+    data->drawing = false;
+    data->quit = false;
+    data->dropped = 0;
+    data->frame_bytes = terminal->frame_bytes;
+
+    Backend b = malloc(sizeof *b);
+
+    b->name = "threaded";
+    b->rows = terminal->rows;
+    b->cols = terminal->cols;
+    b->timeout = -1;
+    b->fd = terminal->fd;
+    b->frame_bytes = terminal->frame_bytes;
+    b->data = data;
+
+    b->canvas_new = threaded_canvas_new;
+    b->canvas_delete = threaded_canvas_delete;
+    b->canvas_erase = threaded_canvas_erase;
+    b->canvas_put = threaded_canvas_put;
+    b->canvas_stage = threaded_canvas_stage;
+    b->update = threaded_update;
+    b->show_cursor = threaded_show_cursor;
+    b->read_key = threaded_read_key;
+    b->destroy = threaded_destroy;
+
+    pthread_create(&data->thread, NULL, threaded_render, data);
+
+    return b;
+}
+
+/* waits until the last composed frame is drawn */
+void backend_threaded_flush(Backend b) {
+    struct threaded_data* data = DATA(b);
+
+    pthread_mutex_lock(&data->lock);
+    while (data->pending || data->drawing)
+        pthread_cond_wait(&data->idle, &data->lock);
+    pthread_mutex_unlock(&data->lock);
+}
+
+/* returns the number of frames dropped so far */
+unsigned long backend_threaded_dropped(Backend b) {
+    pthread_mutex_lock(&DATA(b)->lock);
+    unsigned long dropped = DATA(b)->dropped;
+    pthread_mutex_unlock(&DATA(b)->lock);
+
+    return dropped;
+}
@@ -19,10 +19,18 @@
  ************************************************************************/
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
 
 #include "files.h"
 #include "input.h"
 #include "screen.h"
+#include "trace.h"
+
+/* number of bytes of a file inserted at once */
+#define FILE_CHUNK_SIZE (1 << 20)
 
 bool file_open(Screen s, char* name) {
     s->file = fopen(name, "r+");
@@ -30,27 +38,65 @@ bool file_open(Screen s, char* name) {
     if (!s->file)
         return false;
 
-    int c;
-    while ((c = fgetc(s->file)) != EOF) {
-        if (c == '\n')
-            handle_enter(s);
-        else if (c == '\t')
-            handle_tab(s);
-        else if (c >= 32 && c <= 127)
-            handle_insert_char(s, c);
+    /* the shown buffer is now the file's */
+    if (name != CURR_BUFF->file_name) {
+        free(CURR_BUFF->file_name);
+        CURR_BUFF->file_name = strdup(name);
     }
 
-    screen_destroy_line(s); /* remove unnecessarily added line */
+    uint64_t span = trace_begin();
+
+    /* insert the file in large chunks the way pasted text is inserted,
+       with room for the bytes carried over to the next chunk */
+    char* chunk = malloc(FILE_CHUNK_SIZE+UTF8_MAX_LENGTH);
+    size_t carried = 0;
+    size_t n;
+
+    while ((n = fread(chunk+carried, 1, FILE_CHUNK_SIZE, s->file)) > 0) {
+        n += carried;
+
+        /* a \r\n split between chunks must stay one line break and a
+           character split between them must stay one character */
+        carried = (chunk[n-1] == '\r') ? 1 : utf8_incomplete_length(chunk, n);
+
+        handle_paste(s, chunk, n-carried);
+
+        memmove(chunk, chunk+n-carried, carried);
+    }
+
+    if (carried)
+        handle_paste(s, chunk, carried);
+
+    free(chunk);
+
+    /* remove the empty line following the file's last line break */
+    if (s->n_lines > 1 && CURR_LINE->visual_end == 0)
+        screen_destroy_line(s);
+
     screen_go_to_first_line(s);
 
     s->modified = false;
 
+    trace_end("file_open", span);
+
     return true;
 }
 
 #define BUFF (((Line)curr->data)->buff)
 bool file_save(Screen s) {
-    s->file = freopen(s->args->file_name, "w", s->file);
+    uint64_t span = trace_begin();
+
+    /* a new buffer gets its file when first saved; the file stays readable
+       so that text appended after the saved end is read when following */
+    if (s->file)
+        s->file = freopen(CURR_BUFF->file_name, "w+", s->file);
+    else
+        s->file = fopen(CURR_BUFF->file_name, "w+");
+
+    if (!s->file) {
+        trace_end("file_save", span);
+        return false;
+    }
 
     for (GList* curr = s->lines ; curr != NULL ; curr = curr->next) {
         for (int i = 0 ; i <= BUFF->end ; ++i) {
@@ -59,12 +105,169 @@ bool file_save(Screen s) {
         }
     }
 
-    s->modified = false;
+    /* the file is saved once it's written out, not when it's closed */
+    bool saved = fflush(s->file) == 0;
+    s->modified = !saved;
 
-    return true;
+    trace_end("file_save", span);
+
+    return saved;
 }
 #undef BUFF
 
 bool file_close(Screen s) {
+    /* new buffers have no file */
+    if (!s->file)
+        return true;
+
     return fclose(s->file) == 0;
 }
+
+/* starts watching the shown buffer's file for appended text */
+bool file_follow(Screen s) {
+    if (!s->file)
+        return false;
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    if (inotify_add_watch(fd, CURR_BUFF->file_name, IN_MODIFY) == -1) {
+        close(fd);
+        return false;
+    }
+
+    s->follow_fd = fd;
+
+    return true;
+}
+
+/* takes the events of the followed file, reading the text appended to it
+   now or once its buffer is shown again */
+void file_follow_changed(Screen s) {
+    /* the events only tell that the file changed */
+    char events[4096];
+    while (read(s->follow_fd, events, sizeof events) > 0)
+        ;
+
+    /* the followed file is the first buffer's */
+    if (s->cur_buffer == s->buffers)
+        file_read_appended(s);
+    else
+        s->follow_pending = true;
+}
+
+/* pastes the read bytes, which follow a free byte at the beginning of the
+   chunk, at the end of the document; last is the byte read before them */
+static void file_append_chunk(Screen s, char* chunk, size_t n, char* last) {
+    if (n == 0)
+        return;
+
+    char* text = chunk+1;
+    size_t length = n;
+
+    /* a line break ending the file ended its last line, the text goes on
+       a line of its own */
+    if (*last == '\n') {
+        chunk[0] = '\n';
+        text = chunk;
+        length++;
+    }
+
+    /* the line break ending the text doesn't begin another line yet */
+    *last = chunk[n];
+    if (*last == '\n') {
+        length--;
+
+        if (length > 0 && text[length-1] == '\r')
+            length--;
+    }
+
+    if (length > 0)
+        handle_paste(s, text, length);
+}
+
+/* reads text appended to the file since it was last read after the last
+   line, returns false if there was none; the view stays where it is unless
+   the cursor is at the end of the document, then it follows the text */
+bool file_read_appended(Screen s) {
+    if (!s->file)
+        return false;
+
+    uint64_t span = trace_begin();
+
+    /* the byte before the appended text tells whether it begins a line */
+    long position = ftell(s->file);
+    char last = '\0';
+    if (position > 0 && pread(fileno(s->file), &last, 1, position-1) != 1)
+        last = '\0';
+
+    /* reading again after the end of the file was reached */
+    clearerr(s->file);
+
+    /* the view to go back to, text is pasted at the end of the last line */
+    bool at_end = s->cur_line == s->last_line &&
+        CURR_LINE->visual_cursor == CURR_LINE->visual_end;
+    GList* line = s->cur_line;
+    uint line_num = s->cur_line_num;
+    uint offset = line_cursor_offset(CURR_LINE);
+    uint visual_cursor = CURR_LINE->visual_cursor;
+    uint wrap = CURR_LINE->wrap;
+    GList* top_line = s->top_line;
+    uint top_line_num = s->top_line_num;
+    uint row = s->row;
+    uint col = s->col;
+    bool modified = s->modified;
+
+    if (!at_end) {
+        s->cur_line = s->last_line;
+        s->cur_line_num = s->n_lines-1;
+        s->row = 0;
+        CURR_LINE->wrap = 0;
+        move_to_column(s, CURR_LINE->visual_end);
+    }
+
+    /* read in chunks the way the file is opened, after a free byte for
+       a line break in front */
+    char* chunk = malloc(1+FILE_CHUNK_SIZE+UTF8_MAX_LENGTH);
+    size_t carried = 0;
+    size_t n;
+    bool appended = false;
+
+    while ((n = fread(chunk+1+carried, 1, FILE_CHUNK_SIZE, s->file)) > 0) {
+        n += carried;
+        carried = (chunk[n] == '\r') ? 1 : utf8_incomplete_length(chunk+1, n);
+
+        file_append_chunk(s, chunk, n-carried, &last);
+        appended = appended || n > carried;
+
+        memmove(chunk+1, chunk+1+n-carried, carried);
+    }
+
+    /* bytes of a character or a line break still being written are read
+       again with the rest of them */
+    if (carried)
+        fseek(s->file, -(long)carried, SEEK_CUR);
+
+    free(chunk);
+
+    if (!at_end) {
+        s->cur_line = line;
+        s->cur_line_num = line_num;
+        gap_buffer_move_cursor(CURR_LBUF, (int)offset -
+                               (int)line_cursor_offset(CURR_LINE));
+        CURR_LINE->visual_cursor = visual_cursor;
+        CURR_LINE->wrap = wrap;
+        s->top_line = top_line;
+        s->top_line_num = top_line_num;
+        s->row = row;
+        s->col = col;
+    }
+
+    /* the text is the file's, the buffer isn't any more modified */
+    s->modified = modified;
+
+    trace_end("file_read_appended", span);
+
+    return appended;
+}
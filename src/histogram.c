@@ -0,0 +1,140 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "histogram.h"
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* number of buckets in each power of two */
+#define SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+/* values below this get a bucket each */
+#define LINEAR_MAX (2 * SUB_BUCKETS)
+
+/* bucket the value is counted in */
+static int bucket_of(uint64_t value) {
+    if (value < LINEAR_MAX)
+        return value;
+
+    /* keep the top HISTOGRAM_SUB_BITS+1 bits of the value */
+    int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+
+    return shift * SUB_BUCKETS + (value >> shift);
+}
+
+/* highest value counted in the bucket */
+static uint64_t bucket_max(int bucket) {
+    if (bucket < LINEAR_MAX)
+        return bucket;
+
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t top = bucket % SUB_BUCKETS + SUB_BUCKETS;
+
+    return ((top + 1) << shift) - 1;
+}
+
+/*****************************************************************************/
+/*                                 Histogram                                 */
+/*****************************************************************************/
+
+/* creates an empty histogram */
+Histogram histogram_new() {
+    return calloc(1, sizeof(struct _histogram));
+}
+
+/* counts a value */
+void histogram_add(Histogram h, uint64_t value) {
+    h->counts[bucket_of(value)]++;
+    h->count++;
+
+    if (value > h->max)
+        h->max = value;
+}
+
+/* returns the value the given percentage of values are at or below */
+uint64_t histogram_percentile(Histogram h, double percentage) {
+    if (h->count == 0)
+        return 0;
+
+    /* number of values which have to be at or below the result */
+    uint64_t wanted = h->count * percentage / 100;
+    if (wanted == 0)
+        wanted = 1;
+
+    uint64_t seen = 0;
+
+    for (int i = 0 ; i < HISTOGRAM_BUCKETS ; ++i) {
+        seen += h->counts[i];
+
+        if (seen >= wanted)
+            return (bucket_max(i) < h->max) ? bucket_max(i) : h->max;
+    }
+
+    return h->max;
+}
+
+/* writes percentiles & non-empty buckets of the histogram into a file */
+void histogram_dump(Histogram h, FILE* file, const char* name) {
+    fprintf(file, "%s: %" PRIu64 " values\n", name, h->count);
+
+    static const double percentages[] = { 50, 90, 99, 99.9, 100 };
+
+    for (int i = 0 ; i < 5 ; ++i)
+        fprintf(file, "  p%-5g %10" PRIu64 "\n", percentages[i],
+                histogram_percentile(h, percentages[i]));
+
+    fprintf(file, "  %10s %10s\n", "up to", "count");
+
+    for (int i = 0 ; i < HISTOGRAM_BUCKETS ; ++i) {
+        if (h->counts[i])
+            fprintf(file, "  %10" PRIu64 " %10" PRIu64 "\n",
+                    bucket_max(i), h->counts[i]);
+    }
+
+    fprintf(file, "\n");
+}
+
+/* destroys the histogram, freeing its memory */
+void histogram_destroy(Histogram h) {
+    free(h);
+}
+
+/* current monotonic time in microseconds */
+uint64_t time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* processor time the program used so far in microseconds, unlike time_us
+   it doesn't count time other processes get */
+uint64_t cpu_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,226 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#ifndef TEXT_EDITOR_BACKEND_H
+#define TEXT_EDITOR_BACKEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ncurses.h> /* key codes are reported the way ncurses reports them */
+
+#include "keytrace.h"
+
+/*****************************************************************************/
+/*                                  typedefs                                 */
+/*****************************************************************************/
+
+typedef unsigned int uint;
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* key codes of bracketed paste markers */
+#define KEY_PASTE_BEGIN (KEY_MAX+1)
+#define KEY_PASTE_END (KEY_MAX+2)
+
+/* key codes of Ctrl-Home & Ctrl-End, which ncurses has no names for */
+#define KEY_CTRL_HOME (KEY_MAX+3)
+#define KEY_CTRL_END (KEY_MAX+4)
+
+/* cell attributes */
+#define ATTR_NONE 0x00 /* plain text */
+#define ATTR_REVERSE 0x01 /* reversed colors, used by bars */
+#define ATTR_BLUE 0x02 /* blue text, line ends in debug mode */
+#define ATTR_GREEN 0x04 /* green text, tabs in debug mode */
+#define ATTR_YELLOW 0x08 /* yellow text, line numbers */
+
+/* character of a cell covered by the wide character left of it */
+#define CELL_WIDE 0
+
+/*****************************************************************************/
+/*                                Cell Struct                                */
+/*****************************************************************************/
+
+/* struct representing one character cell on the screen */
+typedef struct _cell Cell;
+struct _cell {
+    uint32_t ch; /* codepoint of the character in the cell */
+    unsigned char attr; /* ATTR_* flags of the cell */
+    uint32_t mark; /* combining mark drawn over the character, 0 if none */
+};
+
+/*****************************************************************************/
+/*                               Canvas Struct                               */
+/*****************************************************************************/
+
+typedef struct _backend* Backend;
+
+/* struct representing a rectangular area of the screen */
+typedef struct _canvas* Canvas;
+struct _canvas {
+    Backend backend; /* backend the canvas is shown on */
+    int rows; /* number of rows */
+    int cols; /* number of columns */
+    int y; /* row of the top left corner on the screen */
+    int x; /* column of the top left corner on the screen */
+    int cursor_row; /* cursor's row in the canvas */
+    int cursor_col; /* cursor's column in the canvas */
+    void* data; /* backend's own representation of the canvas */
+};
+
+/* creates a new canvas */
+Canvas canvas_new(Backend, int rows, int cols, int y, int x);
+
+/* destroys a canvas, freeing its memory */
+void canvas_delete(Canvas);
+
+/* clears the canvas */
+void canvas_erase(Canvas);
+
+/* puts a number of cells on a row, starting at the given column */
+void canvas_put(Canvas, int row, int col, const Cell*, int);
+
+/* puts a UTF-8 string with the same attributes in every cell */
+void canvas_put_str(Canvas, int row, int col, const char*, unsigned char);
+
+/* puts formatted text without attributes */
+void canvas_printf(Canvas, int row, int col, const char*, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/* moves the canvas's cursor */
+void canvas_move(Canvas, int row, int col);
+
+/* stages the canvas for the next update, the last staged canvas
+   gets the terminal's cursor */
+void canvas_stage(Canvas);
+
+/*****************************************************************************/
+/*                               Backend Struct                              */
+/*****************************************************************************/
+
+/* struct representing whatever the editor is displayed on */
+struct _backend {
+    const char* name; /* name of the backend */
+    uint rows; /* number of rows of the screen */
+    uint cols; /* number of columns of the screen */
+    int timeout; /* milliseconds to wait for a key, -1 to wait forever */
+    int fd; /* file descriptor keys come from, -1 if there is none */
+    long frame_bytes; /* bytes written by the last update, -1 if unknown */
+    void* data; /* backend's own state */
+
+    /* backend's implementation of the operations below */
+    void (*canvas_new)(Canvas);
+    void (*canvas_delete)(Canvas);
+    void (*canvas_erase)(Canvas);
+    void (*canvas_put)(Canvas, int, int, const Cell*, int);
+    void (*canvas_stage)(Canvas);
+    void (*update)(Backend);
+    void (*show_cursor)(Backend, bool);
+    int (*read_key)(Backend);
+    void (*destroy)(Backend);
+};
+
+/* shows all staged canvases at once */
+void backend_update(Backend);
+
+/* sets how long reading a key waits, -1 to wait forever */
+void backend_timeout(Backend, int);
+
+/* reads a key, returns ERR if there was none in time */
+int backend_read_key(Backend);
+
+/* shows or hides the cursor */
+void backend_show_cursor(Backend, bool);
+
+/* closes the backend, freeing its memory */
+void backend_destroy(Backend);
+
+/*****************************************************************************/
+/*                              ncurses Backend                              */
+/*****************************************************************************/
+
+/* initializes ncurses and creates a backend drawing on the terminal */
+Backend backend_ncurses_new();
+
+/*****************************************************************************/
+/*                              Terminal Backend                             */
+/*****************************************************************************/
+
+/* creates a backend drawing on a terminal with its own escape sequences,
+   writing only what changed since the last update */
+Backend backend_term_new(int in, int out);
+
+/*****************************************************************************/
+/*                              Headless Backend                             */
+/*****************************************************************************/
+
+/* creates a backend keeping the screen in memory, needs no terminal */
+Backend backend_headless_new(uint rows, uint cols);
+
+/* queues a key to be read by the editor */
+void backend_headless_push_key(Backend, int);
+
+/* changes the size of the screen and queues KEY_RESIZE */
+void backend_headless_resize(Backend, uint rows, uint cols);
+
+/* returns the cells of a row of the screen as of the last update */
+const Cell* backend_headless_row(Backend, uint row);
+
+/* copies characters of a row of the screen into a string as UTF-8, which
+   takes a byte a cell as long as the row is ASCII */
+void backend_headless_row_text(Backend, uint row, char*);
+
+/* gets the position of the cursor as of the last update */
+void backend_headless_cursor(Backend, uint* row, uint* col);
+
+/* returns the number of updates so far */
+unsigned long backend_headless_frames(Backend);
+
+/*****************************************************************************/
+/*                              Threaded Backend                             */
+/*****************************************************************************/
+
+/* creates a backend composing frames in memory and drawing them on the given
+   backend from a separate thread, frames the thread could not keep up with
+   are dropped; takes ownership of the given backend */
+Backend backend_threaded_new(Backend);
+
+/* waits until the last composed frame is drawn */
+void backend_threaded_flush(Backend);
+
+/* returns the number of frames dropped so far */
+unsigned long backend_threaded_dropped(Backend);
+
+/*****************************************************************************/
+/*                              Session Backends                             */
+/*****************************************************************************/
+
+/* creates a backend recording every key read from the given backend with its
+   time into the trace, which writes each key into its file as it's read if
+   it's recording into one; takes ownership of both */
+Backend backend_record_new(Backend, KeyTrace);
+
+/* creates a backend feeding the editor keys of the trace at the recorded
+   pace or as fast as they are read, then keys of the given backend once the
+   trace runs out; takes ownership of both */
+Backend backend_replay_new(Backend, KeyTrace, bool max_speed);
+
+#endif
@@ -27,3 +27,14 @@ bool file_open(Screen, char*);
 bool file_save(Screen);
 
 bool file_close(Screen);
+
+/* starts watching the shown buffer's file for appended text */
+bool file_follow(Screen);
+
+/* takes the events of the followed file, reading the text appended to it
+   now or once its buffer is shown again */
+void file_follow_changed(Screen);
+
+/* reads text appended to the file since it was last read after the last
+   line, returns false if there was none */
+bool file_read_appended(Screen);
@@ -0,0 +1,74 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#ifndef TEXT_EDITOR_HISTOGRAM_H
+#define TEXT_EDITOR_HISTOGRAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* every power of two is split into 2^HISTOGRAM_SUB_BITS buckets,
+   so values are kept with about 3% precision */
+#define HISTOGRAM_SUB_BITS 5
+
+/* number of buckets covering every 64 bit value */
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+/*****************************************************************************/
+/*                              Histogram Struct                             */
+/*****************************************************************************/
+
+/* struct representing a distribution of values, counted in buckets which
+   grow with the values (HDR style) */
+typedef struct _histogram* Histogram;
+struct _histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS]; /* number of values in each bucket */
+    uint64_t count; /* number of values */
+    uint64_t max; /* biggest value */
+};
+
+/* creates an empty histogram */
+Histogram histogram_new();
+
+/* counts a value */
+void histogram_add(Histogram, uint64_t);
+
+/* returns the value the given percentage of values are at or below,
+   0 if the histogram is empty */
+uint64_t histogram_percentile(Histogram, double);
+
+/* writes percentiles & non-empty buckets of the histogram into a file */
+void histogram_dump(Histogram, FILE*, const char* name);
+
+/* destroys the histogram, freeing its memory */
+void histogram_destroy(Histogram);
+
+/* current monotonic time in microseconds */
+uint64_t time_us();
+
+/* processor time the program used so far in microseconds, unlike time_us
+   it doesn't count time other processes get */
+uint64_t cpu_time_us();
+
+#endif
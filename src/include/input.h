@@ -21,6 +21,7 @@
 #ifndef TEXT_EDITOR_INPUT_HANDLER_H
 #define TEXT_EDITOR_INPUT_HANDLER_H
 
+#include <time.h>
 #include "screen.h"
 
 /*****************************************************************************/
@@ -63,6 +64,19 @@ typedef unsigned int uint;
                          ((CURR_LINE->wrap != CURR_LINE->wraps) ? s->cols : \
                           CURR_LINE->visual_end-s->cols*CURR_LINE->wraps-CURR_LINE->wraps))
 
+/* milliseconds to wait for more pasted text before giving up */
+#define PASTE_TIMEOUT 500
+
+/* highest frame rate the frames can be capped at */
+#define FPS_MAX 1000
+
+/* maximum number of keys applied before rendering a frame */
+#define INPUT_BATCH_MAX 4096
+
+/* milliseconds between asking a backend without a descriptor for keys
+   while following a file */
+#define FOLLOW_INTERVAL 100
+
 /* accessing the current top line */
 #define TOP_LINE ((Line)s->top_line->data)
 
@@ -77,24 +91,54 @@ typedef unsigned int uint;
 /* executes the input loop */
 void input_loop(Screen);
 
-/* handles characters in insert mode */
-void insert_mode(Screen);
+/* milliseconds left until the next frame is due under the frame rate cap,
+   0 if the frames aren't capped or it's due already */
+long input_frame_wait(Screen, struct timespec*);
+
+/* handles characters in insert mode, returns false if no key was pending */
+bool insert_mode(Screen);
 
 /* inserts a char into the current screen */
 void handle_insert_char(Screen, char);
 
+/* takes a typed byte of a UTF-8 character, inserting the character once
+   all of its bytes are typed */
+void handle_insert_byte(Screen, char);
+
 /* handle the left arrow key */
 void handle_move_left(Screen);
 
 /* handle the right arrow key */
 void handle_move_right(Screen);
 
+/* moves the cursor to the character of the current line the column is in,
+   straight through the line's column index */
+void move_to_column(Screen, uint);
+
 /* handle the up arrow key */
 void handle_move_up(Screen);
 
 /* handle the down arrow key */
 void handle_move_down(Screen);
 
+/* handle the page up key */
+void handle_page_up(Screen);
+
+/* handle the page down key */
+void handle_page_down(Screen);
+
+/* handle the home key */
+void handle_home(Screen);
+
+/* handle the end key */
+void handle_end(Screen);
+
+/* handle ctrl-home, going to the beginning of the document */
+void handle_document_start(Screen);
+
+/* handle ctrl-end, going to the end of the document */
+void handle_document_end(Screen);
+
 /* handle the enter key */
 void handle_enter(Screen);
 
@@ -104,6 +148,9 @@ void handle_tab(Screen);
 /* handle the backspace key */
 void handle_backspace(Screen);
 
+/* handle pasted text, inserting it at once */
+void handle_paste(Screen, char*, size_t);
+
 /* handle the quit command */
 void handle_quit(Screen);
 
@@ -0,0 +1,78 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#ifndef TEXT_EDITOR_KEYTRACE_H
+#define TEXT_EDITOR_KEYTRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*****************************************************************************/
+/*                                  Key Event                                */
+/*****************************************************************************/
+
+/* struct representing one key of a trace */
+typedef struct _key_event KeyEvent;
+struct _key_event {
+    int key; /* key code as read from the backend */
+    uint64_t time; /* microseconds since the trace started */
+};
+
+/*****************************************************************************/
+/*                               Key Trace Struct                            */
+/*****************************************************************************/
+
+/* struct representing a sequence of keys, recorded or made up */
+typedef struct _key_trace* KeyTrace;
+struct _key_trace {
+    KeyEvent* events; /* the keys in order */
+    size_t length; /* number of keys */
+    size_t size; /* number of keys allocated */
+    FILE* file; /* file keys are written into when flushed, or NULL */
+    bool failed; /* if writing a key into the file failed */
+};
+
+/* creates an empty trace */
+KeyTrace keytrace_new();
+
+/* appends a key to the trace */
+void keytrace_add(KeyTrace, int key, uint64_t time);
+
+/* writes the keys added since the last flush into the file, a file cut short
+   by a crash still holds every key flushed before it */
+void keytrace_flush(KeyTrace);
+
+/* starts writing the trace into a file, every key added from then on is
+   written into it on the next flush, returns false on failure */
+bool keytrace_record(KeyTrace, const char*);
+
+/* stops writing the trace into its file, returns false if any of it
+   couldn't be written */
+bool keytrace_finish(KeyTrace);
+
+/* reads a trace written by keytrace_record, returns NULL on failure */
+KeyTrace keytrace_load(const char*);
+
+/* destroys the trace, freeing its memory */
+void keytrace_destroy(KeyTrace);
+
+#endif
@@ -31,6 +31,20 @@
 
 typedef struct gap_buffer* gap_T;
 
+/*
+ * Running counters of all gap buffers, for accounting their memory use.
+ */
+struct gap_buffer_stats {
+    long buffers;       // live gap buffers
+    long capacity;      // bytes allocated for the buffers, gaps included
+    long peak_capacity; // highest capacity so far
+    long text;          // bytes of text in the buffers, capacity minus gaps
+    long allocations;   // malloc and realloc calls so far
+    long allocated;     // bytes asked for by those calls
+};
+
+extern struct gap_buffer_stats gap_buffer_stats;
+
 struct gap_buffer {
     char* buffer;
     int start;
@@ -48,6 +62,14 @@ struct gap_buffer {
  */
 gap_T gap_buffer_new();
 
+/*
+ * Sets up a gap buffer in memory owned by the caller, such as a struct
+ * taken from a pool.  Only the char array is allocated.
+ *
+ * Usage:  gap_buffer_init(&node->buff);
+ */
+void gap_buffer_init(gap_T);
+
 /*
  * Moves the gap in the buffer to the position of the cursor.
  *
@@ -140,6 +162,28 @@ void gap_buffer_delete(gap_T);
  */
 void gap_buffer_put_str(gap_T, char *);
 
+/*
+ * Inserts a number of characters from a string at the cursor position
+ *
+ * Params: str    - characters to be inserted into the buffer
+ *         length - number of characters to insert
+ *
+ * Unlike gap_buffer_put_str(), the buffer is grown at most once and the
+ * characters are copied in one go, so inserting a long string costs about
+ * the same as a single memcpy.  The cursor ends up after the inserted string.
+ */
+void gap_buffer_insert_str(gap_T, const char *, int);
+
+/*
+ * Deletes a number of characters following the cursor position
+ *
+ * Param: length - number of characters to delete
+ *
+ * The gap is moved to the cursor and widened over the deleted characters,
+ * so nothing is copied apart from moving the gap itself.
+ */
+void gap_buffer_delete_forward(gap_T, int);
+
 /*
  * Changes the mode of the buffer to either insert or replace.
  *
@@ -170,4 +214,10 @@ int gap_buffer_distance_to_start(gap_T);
  */
 void gap_buffer_destroy(gap_T);
 
+/*
+ * Frees the char array of a buffer set up with gap_buffer_init, the memory
+ * of the struct itself is left to the caller.
+ */
+void gap_buffer_release(gap_T);
+
 #endif /* DRJ_GAP_BUFFER_H__ */
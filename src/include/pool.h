@@ -0,0 +1,55 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#ifndef TEXT_EDITOR_POOL_H
+#define TEXT_EDITOR_POOL_H
+
+#include <stddef.h>
+
+/*****************************************************************************/
+/*                                Pool Struct                                */
+/*****************************************************************************/
+
+/* struct representing a pool of same-sized objects, allocated in blocks
+   and kept on a free list once freed, so they are reused without malloc */
+typedef struct _pool* Pool;
+struct _pool {
+    size_t object_size; /* size of one object, at least a pointer */
+    size_t per_block; /* number of objects allocated at once */
+    void* free; /* first free object, each holds a pointer to the next */
+    void* blocks; /* last allocated block, each starts with the previous one */
+    long n_blocks; /* number of allocated blocks */
+    size_t allocated; /* bytes of all allocated blocks */
+    long n_free; /* number of objects on the free list */
+};
+
+/* creates an empty pool of objects of the given size */
+Pool pool_new(size_t object_size, size_t per_block);
+
+/* takes an object from the pool, allocating a new block if none is free */
+void* pool_alloc(Pool);
+
+/* gives an object back to the pool */
+void pool_free(Pool, void*);
+
+/* destroys the pool along with every object in it */
+void pool_destroy(Pool);
+
+#endif
@@ -47,6 +47,10 @@ typedef unsigned int uint;
 /*                                   Functions                               */
 /*****************************************************************************/
 
+/* renders one line into the window at the given row, returns the number of
+   rows it took */
+uint render_line(Screen, Canvas, Line, uint, Cell*, int);
+
 /* renders buffer contents */
 void render_contents(Screen);
 
@@ -59,4 +63,14 @@ void render_info_bar_top(Screen);
 /* render bottom info bar */
 void render_info_bar_bottom(Screen);
 
+/* puts text into a bar at the given column, clipping it at the bar's end */
+void bar_put(char*, int width, int x, const char*);
+
+/* draws the bar if its text differs from the last one drawn on it,
+   takes ownership of the text */
+void bar_draw(Canvas, char** last, char*);
+
+/* renders all windows and updates the terminal once */
+void render_frame(Screen);
+
 #endif
@@ -22,11 +22,16 @@
 #define TEXT_EDITOR_SCREEN_H
 
 #include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
 #include <glib-2.0/glib.h>
 #include <argp.h>
-#include <ncurses.h>
 
 #include "lib/gap_buffer.h"
+#include "backend.h"
+#include "histogram.h"
+#include "utf8.h"
 
 /*****************************************************************************/
 /*                                   Macros                                  */
@@ -38,6 +43,43 @@
 /* accessing the current line buffer */
 #define CURR_LBUF (((Line)s->cur_line->data)->buff)
 
+/* accessing the buffer shown on the screen */
+#define CURR_BUFF ((Buffer)s->cur_buffer->data)
+
+/* accessing the pane with the cursor */
+#define CURR_PANE ((Pane)s->cur_pane->data)
+
+/* smallest number of rows a pane can be split into */
+#define PANE_MIN_ROWS 2
+
+/* columns between tab stops unless given with --tab-width */
+#define TAB_WIDTH_DEFAULT 4
+
+/* widest tab stops allowed */
+#define TAB_WIDTH_MAX 16
+
+/* number of columns a tab beginning on the given column takes */
+#define TAB_COLUMNS(col, width) ((width) - (col) % (width))
+
+/* most bytes of a line between two marks of its column index */
+#define LINE_INDEX_STEP 256
+
+/* number of lines allocated at once by the pool all lines come from */
+#define LINE_POOL_BLOCK 1024
+
+/* file frame timings are dumped into */
+#define TIMINGS_FILE "text-editor-timings.txt"
+
+/* file slow frames are logged into by default */
+#define FRAME_LOG_FILE "text-editor-slow-frames.txt"
+
+/* biggest frame budget in milliseconds */
+#define FRAME_BUDGET_MAX 60000
+
+/* frames running for this many frame budgets are logged while still
+   running, in case they never finish */
+#define FRAME_HANG_BUDGETS 10
+
 /*****************************************************************************/
 /*                                  typedefs                                 */
 /*****************************************************************************/
@@ -48,15 +90,85 @@ typedef unsigned int uint;
 /*                               Other Structs                               */
 /*****************************************************************************/
 
+/* stages of a frame, each one timed in microseconds */
+enum frame_stage {
+    STAGE_INPUT, /* reading keys after the first one of the frame */
+    STAGE_EDIT, /* applying the keys */
+    STAGE_RENDER, /* composing the frame */
+    STAGE_FLUSH, /* showing the frame on the terminal */
+    STAGE_FRAME, /* from reading the first key to showing the frame */
+    N_STAGES
+};
+
 struct Arguments {
     bool debug_mode; /* if debug mode is enabled */
     char* file_name; /* current file name */
+    char** file_names; /* files to open, the first one is shown */
+    uint n_files; /* number of files to open */
+    uint max_fps; /* frame rate cap, 0 if not capped */
+    bool render_thread; /* if frames are drawn by a separate thread */
+    char* backend; /* name of the backend drawing on the terminal */
+    char* record; /* file keys are recorded into, NULL if not recording */
+    char* replay; /* file of keys to replay, NULL if not replaying */
+    bool replay_max_speed; /* if keys are replayed without waiting */
+    bool stats; /* if memory counters are printed on exit */
+    char* trace; /* file trace events are written into, NULL if not tracing */
+    uint frame_budget; /* frames slower than this many ms are logged, 0 if not */
+    char* frame_log; /* file slow frames are logged into */
+    uint tab_width; /* columns between tab stops, 0 for the default */
+    bool view; /* if the file is only viewed, straight from its mapping */
+    bool follow; /* if text appended to the file is read as it's written */
+};
+
+/* state of the current line & document, reported with slow frames */
+struct frame_context {
+    uint line_num; /* current line number */
+    uint n_lines; /* number of lines */
+    int length; /* bytes in the current line's buffer */
+    uint wraps; /* number of times the current line is wrapped */
+    int gap_start; /* position of the current line's gap */
+    int gap_size; /* size of the current line's gap */
+};
+
+/* report of a slow frame, taken by the editor & written by the watchdog */
+struct frame_report {
+    time_t time; /* wall clock time the report was taken */
+    bool running; /* if the frame hasn't finished yet */
+    uint64_t stage_times[N_STAGES]; /* times of the frame's stages, only the
+                                       whole frame's if it's still running */
+    uint keys; /* number of keys applied in the frame */
+    int key; /* last key applied in the frame */
+    struct frame_context before; /* state before the frame's first key */
+    struct frame_context after; /* state after the frame, if it finished */
+};
+
+/* running counters of all lines, for accounting their memory use */
+struct line_stats {
+    long lines; /* live lines */
+    long allocations; /* allocations of blocks of lines so far */
+    long allocated; /* bytes of those allocations */
+    long pooled; /* freed lines kept in the pool for reuse */
 };
 
+extern struct line_stats line_stats;
+
 /*****************************************************************************/
 /*                                Line Struct                                */
 /*****************************************************************************/
 
+/* a mark of a line's column index, the offset of a character and the
+   column it begins on; the character is either a tab or one of the
+   characters every LINE_INDEX_STEP bytes; the kinds of characters up to the
+   next mark are kept for lines with wide characters, whose columns after an
+   edit are found a span between two marks at a time */
+struct line_mark {
+    uint offset;
+    uint col;
+    uint wides; /* number of wide characters up to the next mark */
+    bool tab;
+    bool narrow; /* if characters taking one column are among them */
+};
+
 /* struct representing one line */
 typedef struct _line* Line;
 struct _line {
@@ -65,6 +177,12 @@ struct _line {
     uint visual_end; /* visual end of the line */
     uint wrap; /* current wrap number */
     uint wraps; /* number of times the line is wrapped */
+    bool ascii; /* if the line is ASCII, so that a byte takes a column */
+    bool wide; /* if the line has wide characters, whose columns depend on
+                  where the rows end */
+    struct line_mark* marks; /* column index of the line, in order */
+    uint n_marks; /* number of the marks */
+    uint marks_size; /* number of marks there is room for */
 };
 
 /* creates a new line */
@@ -73,6 +191,134 @@ Line line_create();
 /* destroys a line, freeing its memory */
 void line_destroy(Line);
 
+/* decodes the character beginning the given number of bytes after the
+   line's cursor, returns its number of bytes, 0 past the line's end */
+uint line_char_at(Line, uint offset, uint32_t*);
+
+/* decodes the character ending the given number of bytes before the line's
+   cursor, returns its number of bytes, 0 before the line's beginning */
+uint line_char_ending(Line, uint offset, uint32_t*);
+
+/* offset of the line's cursor in its text, the gap not counted */
+uint line_cursor_offset(Line);
+
+/* the line's tab at the given offset, NULL if there's no tab there */
+struct line_mark* line_tab_at(Line, uint offset);
+
+/* adds a tab at the given offset of the line, beginning on the column */
+void line_add_tab(Line, uint offset, uint col);
+
+/* moves the marks of the line from the given offset on by a number of
+   bytes & columns, returns by how many columns the end of the line moved;
+   marks of removed bytes are removed, and the tab stop after a moved tab
+   may take in the columns, so the marks after it stay */
+int line_move_marks(Line, uint offset, int bytes, int cols, uint tab_width);
+
+/* marks the character at the given offset of an edited line, beginning on
+   the column, if the marks around it are more than LINE_INDEX_STEP bytes
+   apart, so that edits keep the column index as dense as measuring does */
+void line_keep_index(Line, uint offset, uint col);
+
+/* number of columns a character beginning on the given column takes, a wide
+   one which the end of a row would split also takes the last column of the
+   row & goes whole onto the next one */
+uint char_columns(uint32_t, uint col, uint row_width);
+
+/* marks a part of the line's text beginning on the given column, returns
+   the column after it; ascii is cleared if the part isn't ASCII & wide is
+   set if it has wide characters */
+uint line_measure_part(Line, uint offset, uint length, uint col,
+                       uint tab_width, uint row_width);
+
+/* finds the line's marks, visual end & if it's ASCII from its whole text */
+void line_measure(Line, uint tab_width, uint row_width);
+
+/* measures a line with wide characters after bytes were inserted at the
+   offset, or -bytes removed there, from the mark before the change up to the
+   mark after it; the marks after those move a span at a time, since narrow
+   characters take the same columns anywhere & the end of a row splits only
+   wide ones */
+void line_remeasure(Line, uint offset, int bytes, uint tab_width,
+                    uint row_width);
+
+/* column the character at the given offset of the line begins on, found
+   from the mark before it */
+uint line_column(Line, uint offset, uint tab_width, uint row_width);
+
+/* offset of the character of the line the given column is in, found from
+   the mark before it; the offset of the line's \n past its end */
+uint line_offset(Line, uint col, uint tab_width, uint row_width);
+
+/* writes the given memory counters of lines & their buffers into a file */
+void memory_stats_print(FILE*, const struct line_stats*,
+                        const struct gap_buffer_stats*);
+
+/* sets the arguments to their defaults */
+void arguments_init(struct Arguments*);
+
+/* parses a whole decimal number from min to max given as an argument,
+   returns false if the text isn't one */
+bool arguments_parse_number(const char*, uint min, uint max, uint*);
+
+/*****************************************************************************/
+/*                               Buffer Struct                               */
+/*****************************************************************************/
+
+/* struct representing one opened file, the document & cursor of the buffer
+   are kept here while another buffer is shown on the screen */
+typedef struct _buffer* Buffer;
+struct _buffer {
+    char* file_name; /* name of the buffer's file, empty for a new buffer */
+    bool loaded; /* if the file was read, which happens when first shown */
+    bool exists; /* if the file existed when the buffer was listed */
+    long file_size; /* size of the file when the buffer was listed */
+
+    /* Fields of the screen kept while the buffer isn't shown ****************/
+
+    GList* lines;
+    GList* last_line;
+    uint n_lines;
+    GList* cur_line;
+    uint cur_line_num;
+    uint stored_col;
+    GList* top_line;
+    uint top_line_num;
+    uint row;
+    uint col;
+    uint rows; /* size of the screen the buffer was last shown on */
+    uint cols;
+    FILE* file;
+    bool modified;
+};
+
+/*****************************************************************************/
+/*                                Pane Struct                                */
+/*****************************************************************************/
+
+/* struct representing a pane, a part of the screen showing the document with
+   its own cursor & scroll position; panes are stacked one under another so
+   that they share the width lines are wrapped at, the view of the active
+   pane lives in the screen while other panes keep theirs here */
+typedef struct _pane* Pane;
+struct _pane {
+    uint rows; /* number of rows of the pane's contents */
+    Canvas contents; /* window with the pane's contents */
+    Canvas line_numbers; /* window with the pane's line numbers */
+    Canvas separator; /* bar under the pane, NULL for the bottom pane */
+    uint* gutter_rows; /* line numbers currently painted on each row */
+    bool dirty; /* if the pane has to be painted on the next frame */
+    unsigned long paints; /* number of times the pane was painted */
+
+    /* Fields of the screen kept while the pane isn't active ******************/
+
+    GList* cur_line;
+    uint cur_line_num;
+    uint cursor_col; /* visual cursor of the current line */
+    uint stored_col;
+    GList* top_line;
+    uint top_line_num;
+};
+
 /*****************************************************************************/
 /*                               Screen Struct                               */
 /*****************************************************************************/
@@ -82,7 +328,12 @@ typedef struct _screen* Screen;
 struct _screen {
     /* Fields related to logic ***********************************************/
 
+    GList* buffers; /* every opened buffer */
+    GList* cur_buffer; /* buffer shown on the screen */
+    uint n_buffers; /* number of opened buffers */
+
     GList* lines; /* pointer to the first line (list pointer) */
+    GList* last_line; /* pointer to the last line */
     uint n_lines; /* number of currently existing lines */
     GList* cur_line; /* pointer to the current line */
     uint cur_line_num; /* current line number */
@@ -94,30 +345,73 @@ struct _screen {
     uint top_line_num; /* first rendered line number */
     uint row; /* visual cursor's row */
     uint col; /* visual cursor column */
-    uint rows; /* number of visual rows */
+    uint rows; /* number of visual rows of the active pane */
     uint cols; /* number of visual columns */
 
-    WINDOW* contents; /* window with buffer contents */
-    WINDOW* line_numbers; /* window with buffer's line numbers */
-    WINDOW* info_bar_top; /* top bar with useful information */
-    WINDOW* info_bar_bottom; /* bottom bar with useful information */
-    WINDOW* debug_info; /* window with debug information */
+    Backend backend; /* backend the screen is displayed on */
+    GList* panes; /* every pane, from the top of the screen down */
+    GList* cur_pane; /* pane with the cursor */
+    uint changed_first; /* first line changed since the last frame */
+    uint changed_last; /* last changed line, UINT_MAX for all after the first */
+
+    Canvas contents; /* window with buffer contents of the active pane */
+    Canvas line_numbers; /* window with line numbers of the active pane */
+    Canvas info_bar_top; /* top bar with useful information */
+    Canvas info_bar_bottom; /* bottom bar with useful information */
+    Canvas debug_info; /* window with debug information */
+
+    uint gutter_width; /* width of the line numbers window */
 
     bool render_info_bar_bottom; /* if the bottom bar should be rendered */
+    char* info_bar_top_text; /* text last drawn on the top bar */
+    char* info_bar_bottom_text; /* text last drawn on the bottom bar */
 
     FILE* file; /* currently opened file */
+    int follow_fd; /* inotify descriptor watching the first buffer's file
+                      for appended text, -1 if it isn't followed */
+    bool follow_pending; /* if the followed file changed while another
+                            buffer was shown */
 
     /* Fields related to the program *****************************************/
 
     bool modified; /* if buffer is modified (but not saved) */
+    int unhandled_key; /* last key the editor ignored, shown in debug mode */
+    uint tab_width; /* columns between tab stops */
+    char key_bytes[UTF8_MAX_LENGTH]; /* typed bytes of an unfinished character */
+    uint n_key_bytes; /* number of the typed bytes */
+    Histogram timings[N_STAGES]; /* times of each stage of past frames */
+    uint64_t stage_times[N_STAGES]; /* times of each stage of this frame */
+    uint64_t frame_start; /* time the frame's first key was read, 0 if none */
+    uint frame_keys; /* number of keys applied in this frame */
+    int frame_key; /* last key applied in this frame */
+    struct frame_context frame_before; /* state before the frame's first key */
+    pthread_mutex_t frame_lock; /* held while the frame's state changes or
+                                   the watchdog copies it */
+    pthread_t watchdog; /* thread logging slow & hung frames, with a frame
+                           budget */
+    pthread_cond_t watchdog_wake; /* wakes the watchdog when a frame starts,
+                                     a report waits or it should stop */
+    GList* frame_reports; /* reports waiting for the watchdog to log them */
+    bool watchdog_stop; /* if the watchdog should stop */
     struct Arguments* args; /* struct with program arguments */
 };
 
-/* initializes the screen & its buffer */
+/* initializes the screen & its buffer, with a frame budget also a watchdog
+   logging slow frames & frames which hang */
 Screen screen_init(struct Arguments*);
 
-/* initializes the screen's ncurses windows */
-void screen_init_ncurses(Screen);
+/* initializes the screen's windows on the given backend */
+void screen_init_backend(Screen, Backend);
+
+/* lays out the windows according to the terminal size and line numbers */
+void screen_resize(Screen);
+
+/* widens or narrows line numbers to fit the number of the last line */
+void screen_fit_line_numbers(Screen);
+
+/* forgets what was painted on the panes so that they are painted whole on
+   the next frame, for when a window over them is taken away */
+void screen_repaint_panes(Screen);
 
 /* create and enable the bottom info bar */
 void screen_create_info_bar_bottom(Screen);
@@ -125,6 +419,9 @@ void screen_create_info_bar_bottom(Screen);
 /* delete and disable the bottom info bar */
 void screen_delete_info_bar_bottom(Screen);
 
+/* links the given line under the current one and makes it current */
+void screen_insert_line_under(Screen, Line);
+
 /* creates a new line under the current one */
 void screen_new_line_under(Screen);
 
@@ -134,12 +431,59 @@ void screen_new_line_above(Screen);
 /* goes to the first line in the current screen */
 void screen_go_to_first_line(Screen);
 
-/* creates a save confirmation window */
-void screen_save_confirmation_window(Screen);
+/* scrolls the rendered lines so that the current line is at the bottom */
+void screen_scroll_to_current_line(Screen);
+
+/* lists a buffer of the given file after the others, the file is only
+   looked up until the buffer is shown */
+void screen_add_buffer(Screen, const char*);
+
+/* shows the given buffer on the screen, reading its file if it's the first
+   time the buffer is shown */
+void screen_switch_buffer(Screen, GList*);
+
+/* if the given buffer has unsaved changes */
+bool screen_buffer_modified(Screen, GList*);
+
+/* splits the active pane in two showing the same place, the upper one stays
+   active; returns false if the panes would be too small */
+bool screen_split_pane(Screen);
 
-/* removes a line and frees its memory */
+/* moves the cursor into the given pane */
+void screen_switch_pane(Screen, GList*);
+
+/* closes the active pane unless it's the only one, the pane above it or
+   the next one if there is none becomes active */
+void screen_close_pane(Screen);
+
+/* marks the document modified from the first given line to the last one,
+   UINT_MAX for every line after the first, so that panes showing them
+   are painted again */
+void screen_mark_changed(Screen, uint first, uint last);
+
+/* creates a save confirmation window, saving the buffer if asked to,
+   returns false if the question was cancelled */
+bool screen_save_confirmation_window(Screen);
+
+/* removes the current line and frees its memory, the line's text is
+   expected to have been moved to the end of the previous line */
 void screen_destroy_line(Screen);
 
+/* fills in the state of the current line & document */
+void screen_get_frame_context(Screen, struct frame_context*);
+
+/* counts times of the finished frame's stages, if it had any keys,
+   handing a report of the frame to the watchdog if it went over the frame
+   budget */
+void screen_finish_frame(Screen);
+
+/* starts the frame with its first key, read at the given time, if it didn't
+   start yet & counts the key in */
+void screen_frame_key(Screen, int key, uint64_t time);
+
+/* writes histograms of frame timings into a file, returns false on failure */
+bool screen_dump_timings(Screen, const char*);
+
 /* destroyes all the lines and then the screen itself */
 void screen_destroy(Screen);
 
@@ -0,0 +1,65 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#ifndef TEXT_EDITOR_TRACE_H
+#define TEXT_EDITOR_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* number of events each thread's ring holds before it has to be written out */
+#define TRACE_RING_SIZE 4096
+
+/* milliseconds between writing out the rings of all threads */
+#define TRACE_FLUSH_INTERVAL 250
+
+/*****************************************************************************/
+/*                                  Tracing                                  */
+/*****************************************************************************/
+
+/* if trace events are being written */
+extern bool trace_enabled;
+
+/* starts writing trace events in the Chrome trace event format into the file,
+   they are written out regularly & on exit, returns false on failure */
+bool trace_start(const char*);
+
+/* writes out events left in every thread's ring & closes the file,
+   other threads have to be done tracing */
+void trace_stop();
+
+/* returns the time a span starts, 0 when not tracing */
+uint64_t trace_begin();
+
+/* records a span from its start until now, names have to be static */
+void trace_end(const char* name, uint64_t start);
+
+/* records a span with a number attached to it */
+void trace_end_arg(const char* name, uint64_t start,
+                   const char* arg, long value);
+
+/* records the current value of a counter */
+void trace_counter(const char* name, long value);
+
+#endif
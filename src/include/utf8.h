@@ -0,0 +1,71 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#ifndef TEXT_EDITOR_UTF8_H
+#define TEXT_EDITOR_UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+/*                                  typedefs                                 */
+/*****************************************************************************/
+
+typedef unsigned int uint;
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* character shown in place of bytes which aren't valid UTF-8 */
+#define UTF8_REPLACEMENT 0xfffd
+
+/* longest encoding of a character */
+#define UTF8_MAX_LENGTH 4
+
+/*****************************************************************************/
+/*                                 Functions                                 */
+/*****************************************************************************/
+
+/* number of bytes of a character starting with the given byte, 0 if no
+   character starts with it */
+uint utf8_sequence_length(char);
+
+/* decodes the character at the beginning of the text into the codepoint,
+   returns the number of bytes it took; a byte which doesn't begin a valid
+   character is decoded on its own as UTF8_REPLACEMENT */
+uint utf8_decode(const char*, size_t, uint32_t*);
+
+/* encodes the codepoint into the given bytes, returns their number */
+uint utf8_encode(uint32_t, char*);
+
+/* number of bytes the text begins with which are ASCII, checked many
+   bytes at once */
+size_t utf8_ascii_length(const char*, size_t);
+
+/* number of bytes at the end of the text which begin a character the text
+   is too short for, 0 if the text ends with a whole character */
+uint utf8_incomplete_length(const char*, size_t);
+
+/* number of columns the codepoint takes on a terminal, 0 for combining
+   marks and 2 for wide characters */
+uint utf8_width(uint32_t);
+
+#endif
@@ -0,0 +1,173 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#ifndef TEXT_EDITOR_VIEWER_H
+#define TEXT_EDITOR_VIEWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "screen.h"
+#include "backend.h"
+
+/*****************************************************************************/
+/*                                  typedefs                                 */
+/*****************************************************************************/
+
+typedef unsigned int uint;
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* number of lines between two offsets kept by the line index */
+#define VIEW_INDEX_STEP 1024
+
+/* bytes the file is scanned in at a time, dropped from memory after */
+#define VIEW_SCAN_CHUNK (16 << 20)
+
+/* milliseconds between frames showing how far the file is indexed */
+#define VIEW_INDEX_REFRESH 250
+
+/* longest text searched for */
+#define VIEW_PATTERN_MAX 256
+
+/* line number which isn't known until the file is indexed that far */
+#define VIEW_UNKNOWN UINT64_MAX
+
+/*****************************************************************************/
+/*                               Viewer Struct                               */
+/*****************************************************************************/
+
+/* struct representing a read-only view of a file, shown straight from its
+   memory mapping without creating lines; a separate thread indexes the
+   offset of every VIEW_INDEX_STEP-th line in the background */
+typedef struct _viewer* Viewer;
+struct _viewer {
+    /* Fields related to the file ********************************************/
+
+    char* file_name; /* name of the viewed file */
+    int fd; /* descriptor of the file */
+    const char* data; /* mapping of the whole file, NULL if it's empty */
+    size_t size; /* size of the file */
+
+    /* Fields shared with the indexing thread, used with the lock held *******/
+
+    pthread_t indexer; /* thread scanning the file for lines */
+    pthread_mutex_t lock; /* held while using the fields below */
+    size_t* index; /* offsets of lines 0, VIEW_INDEX_STEP, 2*VIEW_INDEX_STEP.. */
+    size_t n_index; /* number of the offsets */
+    size_t index_size; /* number of offsets there is room for */
+    size_t scanned; /* bytes scanned from the beginning of the file */
+    uint64_t scanned_lines; /* number of newlines in those bytes */
+    bool indexed; /* if the whole file is scanned */
+    bool stop; /* if the thread should stop scanning */
+    bool joined; /* if the thread was waited for */
+
+    /* Fields related to the view ********************************************/
+
+    size_t top; /* offset of the first shown line */
+    uint64_t top_num; /* number of the first shown line, VIEW_UNKNOWN if the
+                         file isn't indexed up to it yet */
+    uint shift; /* columns the lines are scrolled to the right */
+    char pattern[VIEW_PATTERN_MAX+1]; /* last searched text, empty if none */
+    int key; /* key which stopped a search, handled next, ERR if none */
+    const char* message; /* shown on the bottom bar, NULL if none */
+
+    /* Fields related to rendering *******************************************/
+
+    Backend backend; /* backend the viewer is displayed on */
+    Canvas info_bar_top; /* top bar with the file name */
+    Canvas line_numbers; /* window with line numbers */
+    Canvas contents; /* window with the lines */
+    Canvas info_bar_bottom; /* bottom bar with the position & messages */
+    char* info_bar_top_text; /* text last drawn on the top bar */
+    char* info_bar_bottom_text; /* text last drawn on the bottom bar */
+    uint gutter_width; /* width of the line numbers window */
+    uint rows; /* number of rows of the contents */
+    uint cols; /* number of columns of the contents */
+
+    struct Arguments* args; /* struct with program arguments */
+};
+
+/*****************************************************************************/
+/*                                 Functions                                 */
+/*****************************************************************************/
+
+/* maps the file & starts indexing its lines, NULL if it can't be read */
+Viewer viewer_open(const char* file_name, struct Arguments*);
+
+/* stops indexing, unmaps the file & frees the viewer's memory */
+void viewer_destroy(Viewer);
+
+/* waits until the whole file is indexed */
+void viewer_wait_index(Viewer);
+
+/* number of the line beginning at the given offset, VIEW_UNKNOWN if the
+   file isn't indexed up to it yet */
+uint64_t viewer_line_number(Viewer, size_t offset);
+
+/* number of lines of the file, of those indexed so far until it's done */
+uint64_t viewer_n_lines(Viewer);
+
+/* starts showing the viewer on the backend */
+void viewer_init_backend(Viewer, Backend);
+
+/* lays out the windows according to the terminal size */
+void viewer_resize(Viewer);
+
+/* scrolls down by the given number of lines, at most until the last line
+   is at the bottom */
+void viewer_scroll_down(Viewer, uint);
+
+/* scrolls up by the given number of lines */
+void viewer_scroll_up(Viewer, uint);
+
+/* shows the beginning of the file */
+void viewer_go_to_start(Viewer);
+
+/* shows the end of the file, the last line at the bottom */
+void viewer_go_to_end(Viewer);
+
+/* shows the given line at the top through the line index, returns false if
+   the file isn't indexed up to it yet or it's past the end */
+bool viewer_go_to_line(Viewer, uint64_t);
+
+/* shows the next line after the top one containing the text at the top,
+   returns false if there is none; a key pressed while a long search runs
+   stops it, with a message saying so */
+bool viewer_search(Viewer, const char*);
+
+/* maps the file again if it was truncated since it was mapped, which makes
+   pages past its new end read as zeros; returns true if it was */
+bool viewer_check_size(Viewer);
+
+/* renders every window and updates the terminal once */
+void viewer_render(Viewer);
+
+/* handles a key, returns false if it quits the viewer */
+bool viewer_handle_key(Viewer, int);
+
+/* renders & handles keys until the viewer is quit */
+void viewer_loop(Viewer);
+
+#endif
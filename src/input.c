@@ -20,33 +20,164 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
-#include <ncurses.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include "screen.h"
 #include "input.h"
 #include "render.h"
 #include "files.h"
+#include "trace.h"
+
+/* number of milliseconds from one point in time to another */
+static long elapsed_ms(struct timespec* from, struct timespec* to) {
+    return (to->tv_sec - from->tv_sec) * 1000 +
+        (to->tv_nsec - from->tv_nsec) / 1000000;
+}
+
+/* milliseconds left until the next frame is due under the frame rate cap,
+   0 if the frames aren't capped or it's due already */
+long input_frame_wait(Screen s, struct timespec* last_frame) {
+    long frame_ms = (s->args->max_fps > 0) ? 1000 / s->args->max_fps : 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long wait = frame_ms - elapsed_ms(last_frame, &now);
+    return (wait > 0) ? wait : 0;
+}
+
+/* applies keys which are already queued without waiting for more,
+   if the frame rate is capped keeps applying keys until the frame is due */
+static void input_drain(Screen s, struct timespec* last_frame) {
+    for (uint n = 1 ; n < INPUT_BATCH_MAX ; ++n) {
+        backend_timeout(s->backend, input_frame_wait(s, last_frame));
+
+        if (!insert_mode(s))
+            break;
+    }
+}
+
+/* waits for a key or for text appended to the followed file, reading the
+   text; returns true if a key is waiting to be read, false if a frame
+   should be rendered first */
+static bool follow_wait(Screen s, struct timespec* last_frame) {
+    /* keys the backend holds already don't show on its descriptor */
+    backend_timeout(s->backend, 0);
+    if (insert_mode(s)) {
+        input_drain(s, last_frame);
+        return false;
+    }
+
+    /* a backend without a descriptor is asked for keys every so often */
+    struct pollfd fds[2] = {
+        { s->follow_fd, POLLIN, 0 },
+        { s->backend->fd, POLLIN, 0 },
+    };
+    bool keys = s->backend->fd >= 0;
+
+    if (poll(fds, (keys) ? 2 : 1, (keys) ? -1 : FOLLOW_INTERVAL) <= 0)
+        return false;
+
+    if (fds[0].revents & POLLIN) {
+        file_follow_changed(s);
+        return false;
+    }
+
+    return keys && (fds[1].revents & POLLIN);
+}
 
 /* executes the input loop */
 void input_loop(Screen s) {
-    refresh(); /* initially refresh stdscr */
+    struct timespec last_frame;
 
     while (true) {
-        render_info_bar_top(s);
-        if (s->render_info_bar_bottom)
-            render_info_bar_bottom(s);
-        render_line_numbers(s);
-        render_contents(s);
+        screen_fit_line_numbers(s);
+        render_frame(s);
+        screen_finish_frame(s);
+        clock_gettime(CLOCK_MONOTONIC, &last_frame);
 
+        /* when following the file, appended text is read while waiting */
+        if (s->follow_fd >= 0 && !follow_wait(s, &last_frame))
+            continue;
+
+        /* wait for a key, then apply the whole batch before rendering */
+        backend_timeout(s->backend, -1);
         insert_mode(s);
+        input_drain(s, &last_frame);
+    }
+}
+
+/* collects bracketed pasted text and inserts it at once */
+static void insert_paste(Screen s) {
+    size_t size = 4096;
+    size_t length = 0;
+    char* text = malloc(size);
+
+    /* the text is already on its way, don't wait long for the end marker */
+    backend_timeout(s->backend, PASTE_TIMEOUT);
+
+    int c;
+    while ((c = backend_read_key(s->backend)) != ERR && c != KEY_PASTE_END) {
+        /* ignore anything the terminal decoded as a special key */
+        if (c > 255)
+            continue;
+
+        if (length == size) {
+            size *= 2;
+            text = realloc(text, size);
+        }
+
+        text[length++] = c;
+    }
+
+    handle_paste(s, text, length);
+    free(text);
+}
+
+/* asks whether to save each modified buffer, showing it first, returns
+   false if quitting was cancelled */
+static bool confirm_quit(Screen s) {
+    GList* shown = s->cur_buffer;
+
+    /* the shown buffer is asked about first */
+    if (s->modified && !screen_save_confirmation_window(s))
+        return false;
+
+    for (GList* curr = s->buffers ; curr != NULL ; curr = curr->next) {
+        if (curr == shown || !screen_buffer_modified(s, curr))
+            continue;
+
+        screen_switch_buffer(s, curr);
+        screen_fit_line_numbers(s);
+        render_frame(s);
+
+        if (!screen_save_confirmation_window(s))
+            return false;
     }
+
+    return true;
 }
 
-/* handles characters in insert mode */
-void insert_mode(Screen s) {
-    int c = getch();
+/* handles characters in insert mode, returns false if no key was pending */
+bool insert_mode(Screen s) {
+    uint64_t start = time_us();
+    int c = backend_read_key(s->backend);
+    uint64_t read = time_us();
+
+    if (c == ERR)
+        return false;
+
+    uint64_t span = trace_begin();
+
+    /* the frame starts with its first key, waiting for it doesn't count */
+    if (s->frame_start != 0)
+        s->stage_times[STAGE_INPUT] += read - start;
+
+    screen_frame_key(s, c, read);
 
     switch (c) {
 
@@ -79,64 +210,253 @@ void insert_mode(Screen s) {
         handle_move_down(s);
         break;
 
+    case KEY_PPAGE:
+        handle_page_up(s);
+        break;
+
+    case KEY_NPAGE:
+        handle_page_down(s);
+        break;
+
+    case KEY_HOME:
+        handle_home(s);
+        break;
+
+    case KEY_END:
+        handle_end(s);
+        break;
+
+    case KEY_CTRL_HOME:
+        handle_document_start(s);
+        break;
+
+    case KEY_CTRL_END:
+        handle_document_end(s);
+        break;
+
     case KEY_RESIZE:
-        /* adjust the number of rows and cols */
-        s->rows = LINES-2; /* -2 for top and bottom bar */
-        s->cols = (s->args->debug_mode) ? COLS-32 : COLS-6; /* -6 for line nums */
+        /* lay out the windows again */
+        screen_resize(s);
         break;
 
     case 19:
         file_save(s);
         break;
 
+    case KEY_PASTE_BEGIN:
+        insert_paste(s);
+        break;
+
+        /* ascii DC4 control character, Ctrl-T */
+    case 20:
+        screen_dump_timings(s, TIMINGS_FILE);
+        break;
+
         /* ascii CAN (cancel) control character */
         /* In terminals similar to xterm it's Ctrl-X */
     case 24:
-        if (s->modified)
-            screen_save_confirmation_window(s);
-        else
+        if (confirm_quit(s))
             handle_quit(s);
 
         break;
 
+        /* ascii SO control character, Ctrl-N */
+    case 14:
+        screen_switch_buffer(s, s->cur_buffer->next ?
+                             s->cur_buffer->next : s->buffers);
+        break;
+
+        /* ascii DLE control character, Ctrl-P */
+    case 16:
+        screen_switch_buffer(s, s->cur_buffer->prev ?
+                             s->cur_buffer->prev : g_list_last(s->buffers));
+        break;
+
+        /* ascii ETB control character, Ctrl-W */
+    case 23:
+        screen_split_pane(s);
+        break;
+
+        /* ascii SI control character, Ctrl-O */
+    case 15:
+        screen_switch_pane(s, s->cur_pane->next ?
+                           s->cur_pane->next : s->panes);
+        break;
+
+        /* ascii ENQ control character, Ctrl-E */
+    case 5:
+        screen_close_pane(s);
+        break;
+
     default:
         if (c >= 32 && c <= 127)
             handle_insert_char(s, c);
+        else if (c >= 0x80 && c <= 0xff)
+            handle_insert_byte(s, c);
         else {
-            if (s->args->debug_mode) {
-                attron(A_REVERSE);
-                mvprintw(0, 0, "%d ", c);
-                attroff(A_REVERSE);
-            }
+            /* remember the key to show it in debug mode */
+            s->unhandled_key = c;
         }
         break;
     }
+
+    s->stage_times[STAGE_EDIT] += time_us() - read;
+    trace_end_arg("insert_mode", span, "key", c);
+
+    return true;
+}
+
+/* number of bytes of the character after the cursor together with the
+   combining marks following it, puts the columns it takes into width */
+static uint char_after(Screen s, uint* width) {
+    uint32_t c;
+    uint length = line_char_at(CURR_LINE, 0, &c);
+
+    /* a tab takes the columns up to the next tab stop */
+    *width = (c == '\t') ?
+        TAB_COLUMNS(CURR_LINE->visual_cursor, s->tab_width) :
+        char_columns(c, CURR_LINE->visual_cursor, s->cols+1);
+
+    if (CURR_LINE->ascii)
+        return length;
+
+    uint next;
+    while ((next = line_char_at(CURR_LINE, length, &c)) &&
+           c != '\n' && utf8_width(c) == 0)
+        length += next;
+
+    return length;
+}
+
+/* number of bytes of the character before the cursor together with the
+   combining marks following it, puts the columns it takes into width */
+static uint char_before(Screen s, uint* width) {
+    uint32_t c;
+    uint length = 0;
+    uint next;
+    *width = 0;
+
+    while ((next = line_char_ending(CURR_LINE, length, &c))) {
+        length += next;
+        *width = utf8_width(c);
+
+        if (c == '\t') {
+            /* a tab takes the columns from where it begins */
+            uint offset = line_cursor_offset(CURR_LINE) - length;
+            *width = CURR_LINE->visual_cursor - line_tab_at(CURR_LINE, offset)->col;
+            break;
+        }
+
+        if (*width == 2) {
+            /* so does a wide character, which may begin at a row's end */
+            uint offset = line_cursor_offset(CURR_LINE) - length;
+            *width = CURR_LINE->visual_cursor -
+                line_column(CURR_LINE, offset, s->tab_width, s->cols+1);
+            break;
+        }
+
+        if (*width > 0 || CURR_LINE->ascii)
+            break;
+    }
+
+    return length;
+}
+
+/* puts the visual cursor on the wrap & column of the line's visual cursor */
+static void place_cursor(Screen s) {
+    uint wrap = CURR_LINE->visual_cursor / (s->cols+1);
+
+    s->row += (int)wrap - (int)CURR_LINE->wrap;
+    s->col = CURR_LINE->visual_cursor % (s->cols+1);
+    CURR_LINE->wrap = wrap;
+}
+
+/* finds the column of the cursor of the current line from its marks */
+static void find_visual_cursor(Screen s) {
+    CURR_LINE->visual_cursor = line_column(CURR_LINE,
+                                           line_cursor_offset(CURR_LINE),
+                                           s->tab_width, s->cols+1);
+}
+
+/* measures the current line after bytes were inserted at the offset, or
+   -bytes removed there, the columns of wide characters after a change can't
+   just be moved, they depend on where the rows end; a line getting its
+   first one is measured whole */
+static void measure_wide_line(Screen s, uint offset, int bytes) {
+    if (CURR_LINE->wide)
+        line_remeasure(CURR_LINE, offset, bytes, s->tab_width, s->cols+1);
+    else
+        line_measure(CURR_LINE, s->tab_width, s->cols+1);
+
+    find_visual_cursor(s);
+}
+
+/* inserts the bytes of a character taking the given number of columns */
+static void insert_character(Screen s, const char* bytes, uint length,
+                             uint width) {
+    uint offset = line_cursor_offset(CURR_LINE);
+
+    for (uint i = 0 ; i < length ; ++i)
+        gap_buffer_put(CURR_LBUF, bytes[i]);
+
+    if (CURR_LINE->wide || width == 2) {
+        measure_wide_line(s, offset, length);
+    } else {
+        /* tabs after the character move up to their next stops */
+        int moved = line_move_marks(CURR_LINE, offset, length, width,
+                                    s->tab_width);
+
+        if (bytes[0] == '\t')
+            line_add_tab(CURR_LINE, offset, CURR_LINE->visual_cursor);
+        else
+            line_keep_index(CURR_LINE, offset, CURR_LINE->visual_cursor);
+
+        CURR_LINE->visual_cursor += width;
+        CURR_LINE->visual_end += moved;
+    }
+
+    /* insertion at the edge of the screen causes a wrap */
+    CURR_LINE->wraps = CURR_LINE->visual_end / (s->cols+1);
+    place_cursor(s);
+
+    screen_mark_changed(s, s->cur_line_num, s->cur_line_num);
 }
 
 /* inserts a char into the current screen */
 void handle_insert_char(Screen s, char c) {
-    /* if current line ends at the edge of the screen, insertion causes a wrap */
-    if (CURR_LINE->visual_end == (CURR_LINE->wraps+1)*s->cols + CURR_LINE->wraps)
-        CURR_LINE->wraps++;
-
-    /* if at the edge of the screen, move down to the next wrap */
-    if (s->col == s->cols) {
-        CURR_LINE->wrap++;
-        s->col = -1; /* after later incrementation it'll be 0 */
-        s->row++;
+    /* a character typed in the middle of another one cancels it */
+    s->n_key_bytes = 0;
+
+    insert_character(s, &c, 1, 1);
+}
+
+/* takes a typed byte of a UTF-8 character, inserting the character once
+   all of its bytes are typed */
+void handle_insert_byte(Screen s, char c) {
+    if (utf8_sequence_length(c) > 1) {
+        /* a new character begins */
+        s->n_key_bytes = 0;
+    } else if (s->n_key_bytes == 0 || (c & 0xc0) != 0x80) {
+        /* nothing to continue or no character begins with it */
+        s->n_key_bytes = 0;
+        return;
     }
 
-    gap_buffer_put(CURR_LBUF, c);
+    s->key_bytes[s->n_key_bytes++] = c;
 
-    s->col++;
-    CURR_LINE->visual_cursor++;
-    CURR_LINE->visual_end++;
+    uint length = s->n_key_bytes;
+    if (length < utf8_sequence_length(s->key_bytes[0]))
+        return;
 
-    s->modified = true;
-}
+    s->n_key_bytes = 0;
 
-#define CURSOR_CHAR (CURR_LBUF->gap_start < CURR_LBUF->cursor) ?  \
-    CURR_LBUF->cursor : CURR_LBUF->cursor-1
+    uint32_t ch;
+    if (utf8_decode(s->key_bytes, length, &ch) != length)
+        return;
+
+    CURR_LINE->ascii = false;
+    insert_character(s, s->key_bytes, length, utf8_width(ch));
+}
 
 /* handle the left arrow key */
 void handle_move_left(Screen s) {
@@ -144,17 +464,18 @@ void handle_move_left(Screen s) {
     if (s->cur_line_num == 0 && s->col == 0 && CURR_LINE->wrap == 0)
         return;
 
-    /* at the beginning of a wrap */
-    if (s->col == 0 && CURR_LINE->wrap != 0 && CURR_LINE->wraps != 0) {
-        s->col = s->cols;
-        s->row--;
-        CURR_LINE->wrap--;
+    /* in the middle of a line, move over the character, maybe onto the
+       wrap above */
+    if (s->col != 0 || CURR_LINE->wrap != 0) {
+        uint width;
+        uint length = char_before(s, &width);
 
-        CURR_LINE->visual_cursor--;
-        gap_buffer_move_cursor(CURR_LBUF, -1);
+        gap_buffer_move_cursor(CURR_LBUF, -(int)length);
+        CURR_LINE->visual_cursor -= width;
+        place_cursor(s);
     }
     /* at the beginning of a top line */
-    else if (s->row == 0 && s->col == 0) {
+    else if (s->row == 0) {
         s->top_line = s->top_line->prev;
         s->cur_line = s->cur_line->prev;
 
@@ -168,7 +489,7 @@ void handle_move_left(Screen s) {
         s->cur_line_num--;
     }
     /* at the beginning of a line */
-    else if (s->col == 0) {
+    else {
         s->row--;
         s->cur_line = s->cur_line->prev;
 
@@ -177,31 +498,9 @@ void handle_move_left(Screen s) {
         gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_end(CURR_LBUF)-1);
 
         s->cur_line_num--;
-    } else {
-
-        /* move further on tab */
-        if (CURR_LBUF->buffer[CURSOR_CHAR] == '\t') {
-            s->col -= 4;
-            CURR_LINE->visual_cursor -= 4;
-        } else {
-            s->col--;
-            CURR_LINE->visual_cursor--;
-        }
-
-        gap_buffer_move_cursor(CURR_LBUF, -1);
     }
 }
 
-#undef CURSOR_CHAR
-
-/* char at the cursor, adjusted depending on the position of the gap */
-#define CURSOR_CHAR (CURR_LBUF->gap_start <= CURR_LBUF->cursor) ?  \
-    TEMP_CURSOR : CURR_LBUF->cursor
-
-/* temporary macro for char at the cursor position */
-#define TEMP_CURSOR (CURR_LBUF->gap_start < CURR_LBUF->cursor) ? \
-    CURR_LBUF->cursor+1 : CURR_LBUF->cursor+GAP_SIZE
-
 /* handle the right arrow key */
 void handle_move_right(Screen s) {
     /* if at the end of the last line, do nothing */
@@ -228,31 +527,8 @@ void handle_move_right(Screen s) {
         /* move actual cursor to the beginning of the line */
         gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
     }
-    /* wrap end of the bottom wrapped line */
-    else if (s->col == s->cols && s->row+1 == s->rows
-             && CURR_LINE->wrap != CURR_LINE->wraps) {
-
-        s->col = 0;
-        s->top_line = s->top_line->next;
-        s->top_line_num++;
-
-        CURR_LINE->wrap++;
-        CURR_LINE->visual_cursor++;
-
-        s->row -= ((Line)s->top_line->prev->data)->wraps;
-
-        gap_buffer_move_cursor(CURR_LBUF, 1);
-    }
-    /* wrap end of a wrap */
-    else if (s->col == s->cols && CURR_LINE->wrap != CURR_LINE->wraps) {
-        s->col = 0;
-        s->row++;
-        CURR_LINE->wrap++;
-        CURR_LINE->visual_cursor++;
-        gap_buffer_move_cursor(CURR_LBUF, 1);
-    }
     /*  end of the line */
-    else if (s->col == VISUAL_END) {
+    else if (s->col == VISUAL_END && CURR_LINE->wrap == CURR_LINE->wraps) {
         s->cur_line = s->cur_line->next;
         CURR_LINE->wrap = 0;
 
@@ -263,119 +539,86 @@ void handle_move_right(Screen s) {
 
         gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
     } else {
-        /* move further on tab */
-        if (CURR_LBUF->buffer[CURSOR_CHAR] == '\t') {
-            s->col+=4;
-            CURR_LINE->visual_cursor += 4;
-        } else {
-            s->col++;
-            CURR_LINE->visual_cursor++;
+        /* move over the character, maybe onto the next wrap */
+        uint width;
+        uint length = char_after(s, &width);
+
+        gap_buffer_move_cursor(CURR_LBUF, length);
+        CURR_LINE->visual_cursor += width;
+        place_cursor(s);
+
+        /* moved onto a wrap under the bottom row, move rendered lines down */
+        if (s->row >= s->rows) {
+            s->top_line = s->top_line->next;
+            s->top_line_num++;
+            s->row -= 1 + PREV_TOP_LINE->wraps;
         }
-
-        gap_buffer_move_cursor(CURR_LBUF, 1);
     }
 }
 
-#undef TEMP_CURSOR
-#undef CURSOR_CHAR
+/* moves the cursor to the character of the current line the column is in,
+   straight through the line's column index */
+void move_to_column(Screen s, uint col) {
+    uint offset = line_offset(CURR_LINE, col, s->tab_width, s->cols+1);
 
-/* handle the up arrow key */
-void handle_move_up(Screen s) {
-    /* if at the top, do nothing */
-    if (s->cur_line_num == 0 && CURR_LINE->wrap == 0)
-        return;
+    gap_buffer_move_cursor(CURR_LBUF, (int)offset -
+                           (int)line_cursor_offset(CURR_LINE));
+    CURR_LINE->visual_cursor = line_column(CURR_LINE, offset, s->tab_width,
+                                           s->cols+1);
+    place_cursor(s);
+}
 
-    /* top line, move rendered lines up */
-    if (s->row == 0) {
-        s->top_line = s->top_line->prev;
-        s->top_line_num--;
-        s->row++; /* balances out to 0 */
+/* column to move onto on another line, the one stored when a shorter line
+   moved the cursor to its end if the cursor is still there */
+static uint vertical_column(Screen s, Line from, Line to) {
+    /* cursor position is bigger than the other line's length */
+    if (s->col > to->visual_end) {
+        s->stored_col = s->col;
+        return s->col;
     }
 
-    if (CURR_LINE->wraps != 0 && CURR_LINE->wrap != 0) {
-        uint new_row = s->row-1;
-        uint new_col = s->col;
-
-        /* keep moving left until the cursor reaches the previous row */
-        while (s->row > new_row)
-            handle_move_left(s);
-
-        /* keep moving left until the cursor hits the previous column
-           or the beginning */
-        while (s->col > new_col && s->col != 0)
-            handle_move_left(s);
+    uint col = 0;
+    if (s->col < from->visual_end) {
+        s->stored_col = s->col;
+        col = s->col;
+    } else if (s->col == from->visual_end) {
+        col = s->stored_col;
     }
-    /* moving onto a wrapped line */
-    else if (PREV_LINE->wraps != 0) {
-        s->cur_line = s->cur_line->prev;
-        gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
 
-        uint new_row = s->row-1;
-        uint new_col = s->col;
-
-        /* go to the beginning of the line */
-        s->row -= (s->row == 1) ? 1 : CURR_LINE->wraps+1;
-        s->col = 0;
-        CURR_LINE->wrap = 0;
-        CURR_LINE->visual_cursor = 0;
-
-        while (s->row < new_row)
-            handle_move_right(s);
+    return (col < s->col) ? s->col : col;
+}
 
-        while (s->col < new_col && s->col != VISUAL_END)
-            handle_move_right(s);
+/* handle the up arrow key */
+void handle_move_up(Screen s) {
+    /* if at the top, do nothing */
+    if (s->cur_line_num == 0 && CURR_LINE->wrap == 0)
+        return;
 
-        s->cur_line_num--;
+    /* wrap other than the first one, go to the same column one wrap up */
+    if (CURR_LINE->wrap != 0) {
+        move_to_column(s, (CURR_LINE->wrap-1)*(s->cols+1) + s->col);
+        return;
     }
-    /* cursor position is bigger than the previous line length */
-    else if (s->col > PREV_LINE->visual_end) {
-        s->cur_line = s->cur_line->prev;
 
-        s->stored_col = s->col; /* store the column */
+    /* moving onto a wrapped line, go to its last wrap */
+    uint col = (PREV_LINE->wraps != 0) ?
+        PREV_LINE->wraps*(s->cols+1) + s->col :
+        vertical_column(s, CURR_LINE, PREV_LINE);
 
-        /* move visual & actual cursor to the end of the line */
-        s->col = CURR_LINE->visual_end;
-        gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_end(CURR_LBUF)-1);
+    s->cur_line = s->cur_line->prev;
+    s->cur_line_num--;
+    CURR_LINE->wrap = CURR_LINE->wraps;
 
-        CURR_LINE->visual_cursor = CURR_LINE->visual_end;
-        s->cur_line_num--;
-        s->row--;
+    /* top line, move rendered lines up */
+    if (s->row == 0) {
+        s->top_line = s->top_line->prev;
+        s->top_line_num--;
+        s->row = CURR_LINE->wraps;
     } else {
-        s->cur_line = s->cur_line->prev;
-
-        gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
-
-        uint old_col = 0;
-        if (s->col < NEXT_LINE->visual_end) {
-            s->stored_col = s->col;
-            old_col = s->col;
-        } else if (s->col == NEXT_LINE->visual_end) {
-            old_col = s->stored_col;
-        }
-
-        if (old_col < s->col)
-            old_col = s->col;
-
-        s->col = 0;
-        CURR_LINE->visual_cursor = 0;
-
-        /* keep moving right until current column reaches the old one */
-        while (s->col < old_col) {
-            handle_move_right(s);
-
-            if (CURR_LINE->visual_cursor == CURR_LINE->visual_end)
-                break;
-        }
-
-        /* if cursor ends up further than s->col was, e.g. on a tab,
-           move before it */
-        if (old_col < s->col)
-            handle_move_left(s);
-
-        CURR_LINE->visual_cursor = NEXT_LINE->visual_cursor;
-        s->cur_line_num--;
         s->row--;
     }
+
+    move_to_column(s, col);
 }
 
 /* handle the down arrow key */
@@ -391,71 +634,140 @@ void handle_move_down(Screen s) {
         s->row -= 1 + ((Line)s->top_line->prev->data)->wraps;
     }
 
-    /* wrap other than the last one */
-    if (CURR_LINE->wraps != 0 && CURR_LINE->wrap != CURR_LINE->wraps) {
-        uint new_row = s->row+1;
-        uint new_col = s->col;
+    /* wrap other than the last one, go to the same column one wrap down */
+    if (CURR_LINE->wrap != CURR_LINE->wraps) {
+        move_to_column(s, (CURR_LINE->wrap+1)*(s->cols+1) + s->col);
+        return;
+    }
 
-        /* keep moving right until the cursor reaches the next row */
-        while (s->row < new_row)
-            handle_move_right(s);
+    uint col = vertical_column(s, CURR_LINE, NEXT_LINE);
 
-        /* keep moving right until the cursor hits previous column or the end */
-        while (s->col < new_col && s->col != VISUAL_END)
-            handle_move_right(s);
-    }
-    /* cursor position bigger than the next line's length */
-    else if (s->col > NEXT_LINE->visual_end) {
-        s->cur_line = s->cur_line->next;
-        CURR_LINE->wrap = 0;
+    s->cur_line = s->cur_line->next;
+    s->cur_line_num++;
+    s->row++;
+    CURR_LINE->wrap = 0;
 
-        s->stored_col = s->col; /* store the column */
+    move_to_column(s, col);
+}
 
-        s->col = CURR_LINE->visual_end;
-        gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_end(CURR_LBUF)-1);
+/* makes the given lines the top & current ones, with the cursor on the
+   column of the current line's first wrap; costs as much as the rows
+   between them, wherever they are in the document */
+static void jump_to_line(Screen s, GList* top, uint top_num,
+                         GList* line, uint line_num, uint col) {
+    s->top_line = top;
+    s->top_line_num = top_num;
+    s->cur_line = line;
+    s->cur_line_num = line_num;
+
+    /* rows taken by the lines above the current one */
+    s->row = 0;
+    for (GList* curr = top ; curr != line ; curr = curr->next)
+        s->row += 1 + ((Line)curr->data)->wraps;
+
+    CURR_LINE->wrap = 0;
+    move_to_column(s, col);
+
+    /* the line doesn't fit under the others, scroll down to it */
+    if (s->row >= s->rows)
+        screen_scroll_to_current_line(s);
+}
 
-        CURR_LINE->visual_cursor = CURR_LINE->visual_end;
-        s->cur_line_num++;
-        s->row++;
-    } else {
-        s->cur_line = s->cur_line->next;
-        CURR_LINE->wrap = 0;
+/* handle the page up key, moving the rendered lines & the cursor up by
+   the lines filling the screen */
+void handle_page_up(Screen s) {
+    /* the first page, go to the first line */
+    if (s->top_line->prev == NULL) {
+        uint col = vertical_column(s, CURR_LINE, s->lines->data);
+        jump_to_line(s, s->lines, 0, s->lines, 0, col);
+        return;
+    }
 
-        gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
+    GList* top = s->top_line;
+    GList* line = s->cur_line;
+    uint lines = 0;
+    uint rows = 0;
+
+    /* the cursor is under the top line, so it can go up as many lines */
+    while (top->prev != NULL &&
+           (lines == 0 || rows + 1 + ((Line)top->prev->data)->wraps <= s->rows)) {
+        top = top->prev;
+        line = line->prev;
+        rows += 1 + ((Line)top->data)->wraps;
+        lines++;
+    }
 
-        uint old_col = 0;
-        if (s->col < PREV_LINE->visual_end) {
-            s->stored_col = s->col;
-            old_col = s->col;
-        } else if (s->col == PREV_LINE->visual_end) {
-            old_col = s->stored_col;
-        }
+    uint col = vertical_column(s, CURR_LINE, line->data);
+    jump_to_line(s, top, s->top_line_num - lines, line, s->cur_line_num - lines,
+                 col);
+}
 
-        if (old_col < s->col)
-            old_col = s->col;
+/* handle the page down key, moving the rendered lines & the cursor down
+   by the lines filling the screen */
+void handle_page_down(Screen s) {
+    GList* top = s->top_line;
+    GList* line = s->cur_line;
+    uint lines = 0;
+    uint moved = 0; /* lines the cursor moved, fewer at the last line */
+    uint rows = 0;
+
+    while (top->next != NULL &&
+           (lines == 0 || rows + 1 + ((Line)top->data)->wraps <= s->rows)) {
+        rows += 1 + ((Line)top->data)->wraps;
+        top = top->next;
+        lines++;
+
+        if (line->next != NULL) {
+            line = line->next;
+            moved++;
+        }
+    }
 
-        s->col = 0;
-        CURR_LINE->visual_cursor = 0;
+    /* the last page, go to the last line */
+    if (lines == 0) {
+        line = s->last_line;
+        moved = s->n_lines-1 - s->cur_line_num;
+    }
 
-        /* keep moving right until current column reaches the old one */
-        while (s->col < old_col) {
-            handle_move_right(s);
+    uint col = vertical_column(s, CURR_LINE, line->data);
+    jump_to_line(s, top, s->top_line_num + lines, line, s->cur_line_num + moved,
+                 col);
+}
 
-            if (CURR_LINE->visual_cursor == CURR_LINE->visual_end)
-                break;
-        }
+/* handle the home key, moving to the beginning of the line */
+void handle_home(Screen s) {
+    move_to_column(s, 0);
+}
 
-        /* cursor ends up further than s->col was e.g. on a tab,
-           move before it */
-        if (old_col < s->col)
-            handle_move_left(s);
+/* handle the end key, moving to the end of the line */
+void handle_end(Screen s) {
+    move_to_column(s, CURR_LINE->visual_end);
 
-        s->cur_line_num++;
-        s->row++;
+    /* the last wrap is under the bottom row, move rendered lines down */
+    while (s->row >= s->rows && s->top_line != s->cur_line) {
+        s->top_line = s->top_line->next;
+        s->top_line_num++;
+        s->row -= 1 + PREV_TOP_LINE->wraps;
     }
 }
 
-/* handle the enter key */
+/* handle ctrl-home, going to the beginning of the document */
+void handle_document_start(Screen s) {
+    screen_go_to_first_line(s);
+}
+
+/* handle ctrl-end, going to the end of the document through the pointer
+   to its last line */
+void handle_document_end(Screen s) {
+    s->cur_line = s->last_line;
+    s->cur_line_num = s->n_lines-1;
+    s->row = 0;
+    CURR_LINE->wrap = 0;
+
+    move_to_column(s, CURR_LINE->visual_end);
+    screen_scroll_to_current_line(s);
+}
+
 void handle_enter(Screen s) {
     if (s->col == 0) {
         /* beginning of the line, just insert a line above */
@@ -485,78 +797,216 @@ void handle_enter(Screen s) {
         s->row -= 1 + PREV_TOP_LINE->wraps;
     }
 
-    s->modified = true;
+    /* the line was split or added, lines under it moved down */
+    screen_mark_changed(s, s->cur_line_num-1, UINT_MAX);
 }
 
 void handle_tab(Screen s) {
-    gap_buffer_put(CURR_LBUF, '\t');
+    s->n_key_bytes = 0;
 
-    /* move visual cursors four columns to the right */
-    s->col += 4;
-    CURR_LINE->visual_end += 4;
-    CURR_LINE->visual_cursor += 4;
-
-    s->modified = true;
+    /* the tab takes the columns up to the next tab stop */
+    insert_character(s, "\t", 1,
+                     TAB_COLUMNS(CURR_LINE->visual_cursor, s->tab_width));
 }
 
-#define CURSOR_CHAR (CURR_LBUF->gap_start < CURR_LBUF->cursor) ?  \
-    CURR_LBUF->cursor : CURR_LBUF->cursor-1
-
 /* handle the backspace key */
 void handle_backspace(Screen s) {
     /* beginning of the first line, do nothing */
-    if (s->cur_line_num == 0 && s->col == 0 && CURR_LINE->wraps == 0)
+    if (s->cur_line_num == 0 && s->col == 0 && CURR_LINE->wrap == 0)
         return;
 
-    /* beginning of the wrap */
-    if (s->col == 0 && CURR_LINE->wraps > 0) {
+    /* in the middle of a line, remove the character before the cursor, a
+       combining mark on its own */
+    if (s->col != 0 || CURR_LINE->wrap != 0) {
+        uint32_t c;
+        uint length = line_char_ending(CURR_LINE, 0, &c);
+        uint offset = line_cursor_offset(CURR_LINE) - length;
+        uint width = utf8_width(c);
 
-        CURR_LINE->wraps--;
-        CURR_LINE->wrap--;
+        if (c == '\t')
+            width = CURR_LINE->visual_cursor - line_tab_at(CURR_LINE, offset)->col;
 
-        s->col = s->cols+1;
-        s->row--;
+        for (uint i = 0 ; i < length ; ++i)
+            gap_buffer_delete(CURR_LBUF);
+
+        if (CURR_LINE->wide) {
+            measure_wide_line(s, offset, -(int)length);
+        } else {
+            /* tabs after the character move back to their previous stops */
+            int moved = line_move_marks(CURR_LINE, offset, -(int)length,
+                                        -(int)width, s->tab_width);
+
+            CURR_LINE->visual_cursor -= width;
+            CURR_LINE->visual_end += moved;
+
+            /* the marks on both sides of removed ones may be far apart */
+            line_keep_index(CURR_LINE, offset, CURR_LINE->visual_cursor);
+        }
+        CURR_LINE->wraps = CURR_LINE->visual_end / (s->cols+1);
+        place_cursor(s);
+
+        screen_mark_changed(s, s->cur_line_num, s->cur_line_num);
     }
     /* beginning of the top line */
-    if (s->row == 0 && s->col == 0) {
+    else if (s->row == 0) {
         s->top_line = s->top_line->prev;
         s->top_line_num--;
+        s->row = 1 + PREV_LINE->visual_end / (s->cols+1);
         merge_line_up(s);
         s->cur_line_num--;
-        s->row = 0;
 
+        /* lines under the merged one moved up */
+        screen_mark_changed(s, s->cur_line_num, UINT_MAX);
     }
     /* beginning of the other line line */
-    else if (s->col == 0) {
+    else {
         /* merge the line with the upper one */
         merge_line_up(s);
         s->cur_line_num--;
+
+        screen_mark_changed(s, s->cur_line_num, UINT_MAX);
+    }
+}
+
+/* handle pasted text, inserting it at once and splitting lines in one pass */
+void handle_paste(Screen s, char* text, size_t length) {
+    /* keep the characters the editor accepts, with every line break as \n */
+    char* clean = malloc(length+1);
+    size_t n = 0;
+
+    for (size_t i = 0 ; i < length ; ++i) {
+        if (text[i] == '\r') {
+            clean[n++] = '\n';
+
+            if (i+1 < length && text[i+1] == '\n')
+                ++i;
+        } else if (text[i] == '\n' || text[i] == '\t' ||
+                   (text[i] >= 32 && text[i] < 127) || (text[i] & 0x80)) {
+            clean[n++] = text[i];
+        }
+    }
+
+    char* end = clean+n;
+
+    /* row on which the current line starts */
+    uint line_row = s->row - CURR_LINE->wrap;
+    uint first_line = s->cur_line_num;
+
+    /* text up to the first line break goes into the current line */
+    char* segment = clean;
+    char* line_break = memchr(segment, '\n', end-segment);
+    uint segment_length = ((line_break) ? line_break : end) - segment;
+
+    uint offset = line_cursor_offset(CURR_LINE);
+    gap_buffer_insert_str(CURR_LBUF, segment, segment_length);
+
+    if (!line_break && CURR_LINE->wide) {
+        measure_wide_line(s, offset, segment_length);
+    } else if (!line_break) {
+        /* measure only the text, tabs after it move up to their next stops */
+        line_move_marks(CURR_LINE, offset, segment_length, 0, s->tab_width);
+        uint col = line_measure_part(CURR_LINE, offset, segment_length,
+                                     CURR_LINE->visual_cursor, s->tab_width,
+                                     s->cols+1);
+        line_keep_index(CURR_LINE, offset, CURR_LINE->visual_cursor);
+
+        CURR_LINE->visual_end += line_move_marks(CURR_LINE,
+                                                 offset+segment_length, 0,
+                                                 col - CURR_LINE->visual_cursor,
+                                                 s->tab_width);
+        CURR_LINE->visual_cursor = col;
+        line_keep_index(CURR_LINE, offset+segment_length, col);
+
+        /* the line's first wide characters, columns after them depend on
+           where the rows end */
+        if (CURR_LINE->wide) {
+            line_measure(CURR_LINE, s->tab_width, s->cols+1);
+            find_visual_cursor(s);
+        }
     } else {
-        /* move the visual cursor to the left */
-        if (CURR_LBUF->buffer[CURSOR_CHAR] == '\t') {
-            s->col-=4;
-            CURR_LINE->visual_end-=4;
-            CURR_LINE->visual_cursor-=4;
-        } else {
-            s->col--;
-            CURR_LINE->visual_end--;
-            CURR_LINE->visual_cursor--;
+        /* cut off the rest of the line, it goes after the last pasted line */
+        gap_buffer_move_gap(CURR_LBUF);
+
+        int tail_length = CURR_LBUF->end - CURR_LBUF->gap_end - 1; /* no \n */
+        char* tail = malloc(tail_length+1);
+        memcpy(tail, CURR_LBUF->buffer + CURR_LBUF->gap_end+1, tail_length);
+        gap_buffer_delete_forward(CURR_LBUF, tail_length);
+
+        line_measure(CURR_LINE, s->tab_width, s->cols+1);
+        CURR_LINE->visual_cursor = CURR_LINE->visual_end;
+        CURR_LINE->wraps = CURR_LINE->visual_end / (s->cols+1);
+        CURR_LINE->wrap = 0;
+
+        line_row += 1 + CURR_LINE->wraps;
+
+        /* every other segment becomes a new line under the previous one */
+        while (line_break) {
+            segment = line_break+1;
+            line_break = memchr(segment, '\n', end-segment);
+            segment_length = ((line_break) ? line_break : end) - segment;
+
+            Line new_line = line_create();
+            gap_buffer_insert_str(new_line->buff, segment, segment_length);
+
+            if (line_break) {
+                /* move the cursor back to the beginning of the line */
+                gap_buffer_move_cursor(new_line->buff, -segment_length);
+                line_measure(new_line, s->tab_width, s->cols+1);
+                line_row += 1 + new_line->visual_end / (s->cols+1);
+            } else {
+                /* the last line gets the tail, cursor stays before it */
+                gap_buffer_insert_str(new_line->buff, tail, tail_length);
+                gap_buffer_move_cursor(new_line->buff, -tail_length);
+                line_measure(new_line, s->tab_width, s->cols+1);
+                new_line->visual_cursor = line_column(new_line, segment_length,
+                                                      s->tab_width, s->cols+1);
+            }
+
+            new_line->wraps = new_line->visual_end / (s->cols+1);
+
+            screen_insert_line_under(s, new_line);
+            s->cur_line_num++;
         }
 
-        /* remove the current character */
-        gap_buffer_delete(CURR_LBUF);
+        free(tail);
     }
 
-    s->modified = true;
-}
+    free(clean);
+
+    /* place the visual cursor after the pasted text */
+    CURR_LINE->wraps = CURR_LINE->visual_end / (s->cols+1);
+    CURR_LINE->wrap = CURR_LINE->visual_cursor / (s->cols+1);
+    s->col = CURR_LINE->visual_cursor % (s->cols+1);
+    s->row = line_row + CURR_LINE->wrap;
 
-#undef CURSOR_CHAR
+    /* pasted past the bottom, move rendered lines down */
+    if (s->row >= s->rows)
+        screen_scroll_to_current_line(s);
+
+    /* pasted line breaks move the lines under them down */
+    screen_mark_changed(s, first_line, (s->cur_line_num == first_line) ?
+                        first_line : UINT_MAX);
+}
 
 /* handle the quit command */
 void handle_quit(Screen s) {
-    endwin(); /* end curses mode */
+    Backend b = s->backend;
+    bool stats = s->args->stats;
+
+    /* take the counters while the document is still there */
+    struct line_stats lines = line_stats;
+    struct gap_buffer_stats buffers = gap_buffer_stats;
+
     file_close(s); /* close the file */
     screen_destroy(s); /* destroy the current screen */
+    backend_destroy(b); /* end curses mode */
+
+    if (stats)
+        memory_stats_print(stderr, &lines, &buffers);
+
+    /* every thread is done by now */
+    trace_stop();
+
     exit(0);
 }
 
@@ -565,42 +1015,21 @@ void split_line(Screen s) {
     screen_new_line_under(s);
     s->cur_line = s->cur_line->prev; /* return to the line being split */
 
-    int chars_to_move = 0;
-    int moved_tabs = 0;
+    /* with the gap on the split point, the text after it is in one piece
+       ending with the line's '\n', which stays */
+    gap_T buff = CURR_LBUF;
+    gap_buffer_move_gap(buff);
+    int length = buff->end - buff->gap_end - 1;
 
-    /* choose starting cursor position on the split point */
-    int i = (CURR_LBUF->gap_end < CURR_LBUF->cursor) ?
-        CURR_LBUF->cursor+1 : CURR_LBUF->cursor;
+    /* copy the text into the new line & drop it from this one at once */
+    gap_buffer_insert_str(NEXT_LBUF, buff->buffer + buff->gap_end + 1, length);
+    gap_buffer_delete_forward(buff, length);
 
-    /* loop through the line to the end */
-    while (i < CURR_LBUF->end) {
-        /* skip the gap */
-        if (i >= CURR_LBUF->gap_start && i <= CURR_LBUF->gap_end) {
-            ++i;
-            continue;
-        }
-
-        if (CURR_LBUF->buffer[i] == '\n' || CURR_LBUF->buffer[i] == '\0')
-            continue;
-
-        gap_buffer_put(NEXT_LBUF, CURR_LBUF->buffer[i]); /* put the current char into the new line */
-        chars_to_move++;
-
-        if (CURR_LBUF->buffer[i] == '\t')
-            moved_tabs++;
-
-        ++i;
-    }
-
-    gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_end(CURR_LBUF)-1); /* exclude '\n' at the end */
-
-    /* delete as many characters as we moved to the new line */
-    for (i = 0 ; i < chars_to_move ; ++i)
-        gap_buffer_delete(CURR_LBUF);
-
-    CURR_LINE->visual_end -= chars_to_move + moved_tabs*3; /* adjust the old line's visual end */
+    /* adjust the old line's visual end */
+    line_measure(CURR_LINE, s->tab_width, s->cols+1);
     s->cur_line = s->cur_line->next; /* move to the newly created line */
-    CURR_LINE->visual_end += chars_to_move + moved_tabs*3; /* adjust the new line's visual end */
+    /* adjust the new line's visual end */
+    line_measure(CURR_LINE, s->tab_width, s->cols+1);
 
     gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
 }
@@ -608,33 +1037,36 @@ void split_line(Screen s) {
 /* merge the current line with the upper one */
 void merge_line_up(Screen s) {
     uint old_col = PREV_LINE->visual_end; /* store the merge point position (on the upper line) */
-    uint moved_chars = 0;
-    uint moved_tabs = 0;
 
     gap_buffer_move_cursor(PREV_LBUF, gap_buffer_distance_to_end(PREV_LBUF)-1); /* exclude '\n' at the end */
-    for (int i = CURR_LBUF->start ; i < CURR_LBUF->end ; ++i) {
-        /* skip the gap, \n and \0s */
-        if ((i >= CURR_LBUF->gap_start && i <= CURR_LBUF->gap_end) ||
-            CURR_LBUF->buffer[i] == '\n' || CURR_LBUF->buffer[i] == '\0')
-            continue;
+    uint offset = line_cursor_offset(PREV_LINE); /* and its offset */
 
-        gap_buffer_put(PREV_LBUF, CURR_LBUF->buffer[i]); /* put the current char in the new line */
-        moved_chars++;
+    /* the line's text is on both sides of its gap, its '\n' ends the last
+       piece & isn't copied */
+    gap_T buff = CURR_LBUF;
+    int before = buff->gap_start - buff->start;
+    int after = buff->end - buff->gap_end;
 
-        if (CURR_LBUF->buffer[i] == '\t')
-            moved_tabs++;
-    }
+    if (after > 0)
+        after--;
+    else
+        before--;
+
+    gap_buffer_insert_str(PREV_LBUF, buff->buffer + buff->start, before);
+    gap_buffer_insert_str(PREV_LBUF, buff->buffer + buff->gap_end + 1, after);
 
     screen_destroy_line(s);
 
-    CURR_LINE->visual_end += moved_chars + moved_tabs*3; /* adjust merged line's visual end */
+    /* adjust merged line's visual end */
+    line_measure(CURR_LINE, s->tab_width, s->cols+1);
+    CURR_LINE->wraps = CURR_LINE->visual_end / (s->cols+1);
 
-    /* move the visual & actual cursor to the merge point on the previous line */
-    gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
+    /* move the visual & actual cursor to the merge point, on the last wrap
+       of the previous line */
+    gap_buffer_move_cursor(CURR_LBUF, (int)offset -
+                           (int)line_cursor_offset(CURR_LINE));
     s->row--;
-    s->col = 0; /* set visual column to the beginning of the line */
-
-    /* keep moving right until current column reaches the old one */
-    while (s->col < old_col)
-        handle_move_right(s);
+    CURR_LINE->wrap = old_col / (s->cols+1);
+    CURR_LINE->visual_cursor = old_col;
+    place_cursor(s);
 }
@@ -0,0 +1,205 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "keytrace.h"
+
+/*****************************************************************************/
+/*                                   Macros                                  */
+/*****************************************************************************/
+
+/* beginning of every trace file */
+#define KEYTRACE_MAGIC "KEYTRACE"
+
+/* version of the file format, version 1 also stored the number of keys */
+#define KEYTRACE_VERSION 2
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* the file stores numbers in little endian, whatever the machine uses */
+static bool put_uint(FILE* file, uint64_t value, int bytes) {
+    for (int i = 0 ; i < bytes ; ++i) {
+        if (fputc((value >> (8*i)) & 0xff, file) == EOF)
+            return false;
+    }
+
+    return true;
+}
+
+static bool get_uint(FILE* file, uint64_t* value, int bytes) {
+    *value = 0;
+
+    for (int i = 0 ; i < bytes ; ++i) {
+        int c = fgetc(file);
+        if (c == EOF)
+            return false;
+
+        *value |= (uint64_t)c << (8*i);
+    }
+
+    return true;
+}
+
+/* writes one key at the current position of the file in a single call */
+static bool put_event(FILE* file, const KeyEvent* event) {
+    unsigned char bytes[12];
+
+    for (int i = 0 ; i < 4 ; ++i)
+        bytes[i] = ((uint32_t)event->key >> (8*i)) & 0xff;
+    for (int i = 0 ; i < 8 ; ++i)
+        bytes[4+i] = (event->time >> (8*i)) & 0xff;
+
+    return fwrite(bytes, 1, 12, file) == 12;
+}
+
+/* writes the whole trace at the current position of the file: the magic, the
+   version and then a 32 bit key code and 64 bit time of every key, the number
+   of keys is the size of the file so appending a key is a plain write */
+static bool put_trace(FILE* file, KeyTrace t) {
+    bool ok = fwrite(KEYTRACE_MAGIC, 1, 8, file) == 8 &&
+        put_uint(file, KEYTRACE_VERSION, 4);
+
+    for (size_t i = 0 ; ok && i < t->length ; ++i)
+        ok = put_event(file, &t->events[i]);
+
+    return ok;
+}
+
+/* stops the recording after a failed write rather than leaving a broken
+   file */
+static void stop_recording(KeyTrace t) {
+    t->failed = true;
+    fclose(t->file);
+    t->file = NULL;
+}
+
+/*****************************************************************************/
+/*                                 Key Trace                                 */
+/*****************************************************************************/
+
+/* creates an empty trace */
+KeyTrace keytrace_new() {
+    KeyTrace t = malloc(sizeof *t);
+
+    t->size = 256;
+    t->length = 0;
+    t->events = malloc(sizeof(KeyEvent) * t->size);
+    t->file = NULL;
+    t->failed = false;
+
+    return t;
+}
+
+/* appends a key to the trace */
+void keytrace_add(KeyTrace t, int key, uint64_t time) {
+    if (t->length == t->size) {
+        t->size *= 2;
+        t->events = realloc(t->events, sizeof(KeyEvent) * t->size);
+    }
+
+    t->events[t->length].key = key;
+    t->events[t->length].time = time;
+    t->length++;
+
+    /* the key only goes into the file's buffer, keytrace_flush writes it */
+    if (t->file && !put_event(t->file, &t->events[t->length - 1]))
+        stop_recording(t);
+}
+
+/* writes the keys added since the last flush into the file, a file cut short
+   by a crash still holds every key flushed before it */
+void keytrace_flush(KeyTrace t) {
+    if (t->file && fflush(t->file) != 0)
+        stop_recording(t);
+}
+
+/* starts writing the trace into a file, every key added from then on is
+   written into it on the next flush, returns false on failure */
+bool keytrace_record(KeyTrace t, const char* name) {
+    FILE* file = fopen(name, "wb");
+    if (!file)
+        return false;
+
+    if (!put_trace(file, t) || fflush(file) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    t->file = file;
+    t->failed = false;
+
+    return true;
+}
+
+/* stops writing the trace into its file, returns false if any of it
+   couldn't be written */
+bool keytrace_finish(KeyTrace t) {
+    bool ok = !t->failed;
+
+    if (t->file && fclose(t->file) != 0)
+        ok = false;
+
+    t->file = NULL;
+
+    return ok;
+}
+
+/* reads a trace written by keytrace_record, returns NULL on failure */
+KeyTrace keytrace_load(const char* name) {
+    FILE* file = fopen(name, "rb");
+    if (!file)
+        return NULL;
+
+    char magic[8];
+    uint64_t version, length;
+
+    /* the number of keys of version 1 is left out, the file size tells it */
+    if (fread(magic, 1, 8, file) != 8 ||
+        memcmp(magic, KEYTRACE_MAGIC, 8) != 0 ||
+        !get_uint(file, &version, 4) ||
+        (version != 1 && version != KEYTRACE_VERSION) ||
+        (version == 1 && !get_uint(file, &length, 8))) {
+        fclose(file);
+        return NULL;
+    }
+
+    KeyTrace t = keytrace_new();
+    uint64_t key, time;
+
+    /* a key cut short by a crash while it was being written is dropped */
+    while (get_uint(file, &key, 4) && get_uint(file, &time, 8))
+        keytrace_add(t, (int32_t)key, time);
+
+    fclose(file);
+
+    return t;
+}
+
+/* destroys the trace, freeing its memory */
+void keytrace_destroy(KeyTrace t) {
+    keytrace_finish(t);
+    free(t->events);
+    free(t);
+}
@@ -15,9 +15,32 @@
 #include <string.h>
 #include <lib/gap_buffer.h>
 
+struct gap_buffer_stats gap_buffer_stats;
+
+// counts buffer memory going from one capacity to another
+static void gap_buffer_count(long old_capacity, long new_capacity)
+{
+    gap_buffer_stats.capacity += new_capacity - old_capacity;
+
+    if (gap_buffer_stats.capacity > gap_buffer_stats.peak_capacity)
+        gap_buffer_stats.peak_capacity = gap_buffer_stats.capacity;
+
+    gap_buffer_stats.allocations++;
+    gap_buffer_stats.allocated += new_capacity;
+}
+
 gap_T gap_buffer_new() {
     gap_T g = malloc(sizeof(struct gap_buffer));
 
+    gap_buffer_stats.allocations++;
+    gap_buffer_stats.allocated += sizeof(struct gap_buffer);
+    gap_buffer_init(g);
+
+    return g;
+}
+
+void gap_buffer_init(gap_T g)
+{
     g->buffer = malloc(sizeof(char) * INITIAL_SIZE);
 
     g->start = 0;
@@ -26,7 +49,9 @@ gap_T gap_buffer_new() {
     g->gap_end = INITIAL_SIZE -1;
     g->cursor = 0;
     g->mode = INSERT_MODE;
-    return g;
+
+    gap_buffer_stats.buffers++;
+    gap_buffer_count(0, INITIAL_SIZE);
 }
 
 void gap_buffer_move_gap(gap_T g)
@@ -80,15 +105,17 @@ void gap_buffer_move_gap(gap_T g)
         printf("Cursor is inside or outside the gap! Gap move cancelled.\n");
 }
 
-void gap_buffer_resize_buffer(gap_T g)
+/* grows the buffer by the given number of characters, keeping them in the gap */
+static void gap_buffer_grow(gap_T g, int size)
 {
     // expand buffer size - buffer begins with 0, so actual size is g->end + 1
-    int new_size = (g->end + 1) + GROW_SIZE; 
+    int new_size = (g->end + 1) + size;
 
     // length of characters after the gap to move to end of resized buf
     int length = g->end - g->gap_end;
 
     char * buffer = realloc(g->buffer, sizeof(char) * new_size);
+    gap_buffer_count(g->end + 1, new_size);
 
     g->buffer = buffer;
 
@@ -102,6 +129,11 @@ void gap_buffer_resize_buffer(gap_T g)
     g->gap_end = g->end - length;
 }
 
+void gap_buffer_resize_buffer(gap_T g)
+{
+    gap_buffer_grow(g, GROW_SIZE);
+}
+
 /*
  * One might be tempted to simply decrement or increment the cursor field
  * (or add or subtract from it) elsewhere, to move the cursor.
@@ -207,6 +239,7 @@ void gap_buffer_insert(gap_T g, char ch) {
     // finally, save the char into the buffer, and increment cursor and gap st
     g->buffer[g->cursor] = ch;
     g->gap_start++;
+    gap_buffer_stats.text++;
     gap_buffer_move_cursor(g, 1);
 }
 
@@ -238,6 +271,7 @@ void gap_buffer_delete(gap_T g) {
         g->buffer[g->gap_start] = '\0';
         g->gap_start--;
         g->buffer[g->gap_start] = '\0';
+        gap_buffer_stats.text--;
         gap_buffer_move_cursor(g, -1);
     }
 }
@@ -258,6 +292,43 @@ void gap_buffer_put_str(gap_T g, char * str)
     while (--length > 0);
 }
 
+void gap_buffer_insert_str(gap_T g, const char *str, int length)
+{
+    if (length <= 0)
+        return;
+
+    // inserts must always happen at the gap start - move the gap if needed
+    if (g->cursor != g->gap_start)
+        gap_buffer_move_gap(g);
+
+    // make room for the whole string at once, leaving the gap non-empty
+    int room = g->gap_end - g->gap_start;
+    if (length > room)
+        gap_buffer_grow(g, (length - room > GROW_SIZE) ?
+                        length - room : GROW_SIZE);
+
+    memcpy(g->buffer + g->gap_start, str, sizeof(char) * length);
+
+    g->gap_start += length;
+    g->cursor = g->gap_start;
+    gap_buffer_stats.text += length;
+}
+
+void gap_buffer_delete_forward(gap_T g, int length)
+{
+    // move gap first, if necessary.
+    gap_buffer_move_gap(g);
+
+    // the deleted characters simply become part of the gap
+    if (length > g->end - g->gap_end)
+        length = g->end - g->gap_end;
+
+    if (length > 0) {
+        g->gap_end += length;
+        gap_buffer_stats.text -= length;
+    }
+}
+
 void gap_buffer_set_mode(gap_T g, int mode)
 {
     g->mode = mode == REPLACE_MODE ?  REPLACE_MODE : INSERT_MODE;
@@ -289,9 +360,18 @@ int gap_buffer_distance_to_start(gap_T g)
     return distance;
 }
 
-void gap_buffer_destroy(gap_T g)
+void gap_buffer_release(gap_T g)
 {
+    gap_buffer_stats.buffers--;
+    gap_buffer_stats.capacity -= g->end + 1;
+    gap_buffer_stats.text -= g->end - (g->gap_end - g->gap_start);
+
     free(g->buffer);
+}
+
+void gap_buffer_destroy(gap_T g)
+{
+    gap_buffer_release(g);
     free(g);
 }
 
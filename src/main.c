@@ -20,13 +20,17 @@
 
 #include <stdbool.h>
 
+#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
-#include <ncurses.h>
 #include <argp.h>
+#include <unistd.h>
 
 #include "screen.h"
 #include "input.h"
 #include "files.h"
+#include "trace.h"
+#include "viewer.h"
 
 /*****************************************************************************/
 /*                      Handling command line arguments                      */
@@ -39,11 +43,24 @@ const char* program_bug_address = "<github.com/mrkajetanp>";
 static char doc[] = "text-editor -- a simple, proof of concept text editor";
 
 /* usage */
-static char args_doc[] = "[FILE]";
+static char args_doc[] = "[FILE...]";
 
 /* possible arguments */
 static struct argp_option options[] = {
     { "debug", 'd', 0, 0, "Enable debug mode", 0 },
+    { "fps", 'f', "N", 0, "Render at most N frames per second, up to 1000 (default no cap)", 0 },
+    { "render-thread", 't', 0, 0, "Draw frames on the terminal from a separate thread", 0 },
+    { "backend", 'b', "NAME", 0, "Draw on the terminal with ncurses (default) or term", 0 },
+    { "record", 'r', "FILE", 0, "Record keys with their times into FILE", 0 },
+    { "replay", 'R', "FILE", 0, "Replay keys recorded into FILE", 0 },
+    { "max-speed", 'm', 0, 0, "Replay keys without waiting between them", 0 },
+    { "stats", 's', 0, 0, "Print memory used by the document to stderr on exit", 0 },
+    { "trace", 'T', "FILE", 0, "Write trace events of the editor into FILE", 0 },
+    { "frame-budget", 'B', "MS", 0, "Log frames slower than MS milliseconds with what the editor was doing", 0 },
+    { "frame-log", 'L', "FILE", 0, "Log slow frames into FILE (default " FRAME_LOG_FILE ")", 0 },
+    { "tab-width", 'w', "N", 0, "Put tab stops every N columns, up to 16 (default 4)", 0 },
+    { "view", 'v', 0, 0, "View the first file read-only, straight from its mapping", 0 },
+    { "follow", 'F', 0, 0, "Read text appended to the first file as it's written, like tail -f", 0 },
     { 0, 0, 0, 0, 0, 0},
 };
 
@@ -57,12 +74,72 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
         arguments->debug_mode = true;
         break;
 
-    case ARGP_KEY_ARG:
-        if (state->arg_num >= 1)
-            /* too many arguments */
-            argp_usage(state);
+    case 'f':
+        if (!arguments_parse_number(arg, 1, FPS_MAX, &arguments->max_fps))
+            argp_error(state, "frame rate must be from 1 to %d", FPS_MAX);
+        break;
+
+    case 't':
+        arguments->render_thread = true;
+        break;
+
+    case 'b':
+        if (strcmp(arg, "ncurses") != 0 && strcmp(arg, "term") != 0)
+            argp_error(state, "unknown backend '%s'", arg);
+
+        arguments->backend = arg;
+        break;
+
+    case 'r':
+        arguments->record = arg;
+        break;
+
+    case 'R':
+        arguments->replay = arg;
+        break;
+
+    case 'm':
+        arguments->replay_max_speed = true;
+        break;
+
+    case 's':
+        arguments->stats = true;
+        break;
+
+    case 'T':
+        arguments->trace = arg;
+        break;
 
-        arguments->file_name = arg;
+    case 'B':
+        if (!arguments_parse_number(arg, 1, FRAME_BUDGET_MAX,
+                                    &arguments->frame_budget))
+            argp_error(state, "frame budget must be from 1 to %d ms",
+                       FRAME_BUDGET_MAX);
+        break;
+
+    case 'L':
+        arguments->frame_log = arg;
+        break;
+
+    case 'w':
+        if (!arguments_parse_number(arg, 1, TAB_WIDTH_MAX, &arguments->tab_width))
+            argp_error(state, "tab width must be from 1 to %d", TAB_WIDTH_MAX);
+
+        break;
+
+    case 'v':
+        arguments->view = true;
+        break;
+
+    case 'F':
+        arguments->follow = true;
+        break;
+
+    case ARGP_KEY_ARGS:
+        /* the first file is shown, the others wait in the buffer list */
+        arguments->file_names = state->argv + state->next;
+        arguments->n_files = state->argc - state->next;
+        arguments->file_name = arguments->file_names[0];
         break;
 
     default:
@@ -82,30 +159,115 @@ static struct argp argp = { options, parse_opt, args_doc, doc, 0, 0, 0 };
 int main(int argc, char** argv) {
     /* parsing command line arguments */
     struct Arguments arguments;
-    arguments.debug_mode = false;
-    arguments.file_name = "";
+    arguments_init(&arguments);
     argp_parse(&argp, argc, argv, 0, 0, &arguments);
 
-    /* ncurses initialization */
-    initscr();
-    raw();
-    noecho();
-    keypad(stdscr, TRUE);
+    /* map the viewed file before taking over the terminal */
+    Viewer viewer = NULL;
+    if (arguments.follow && arguments.view) {
+        fprintf(stderr, "text-editor: --follow can't be used with --view\n");
+        return 1;
+    }
+
+    if (arguments.follow && arguments.n_files == 0) {
+        fprintf(stderr, "text-editor: --follow needs a file to follow\n");
+        return 1;
+    }
 
-    /* colors */
-    start_color();
+    if (arguments.view) {
+        if (arguments.n_files == 0) {
+            fprintf(stderr, "text-editor: --view needs a file to view\n");
+            return 1;
+        }
+
+        viewer = viewer_open(arguments.file_name, &arguments);
+
+        if (!viewer) {
+            fprintf(stderr, "text-editor: cannot view %s\n", arguments.file_name);
+            return 1;
+        }
+    }
 
-    init_pair(1, COLOR_BLUE, COLOR_BLACK);
-    init_pair(2, COLOR_GREEN, COLOR_BLACK);
-    init_pair(3, COLOR_YELLOW, COLOR_BLACK);
+    /* read the keys to replay before taking over the terminal */
+    KeyTrace replay = NULL;
+    if (arguments.replay) {
+        replay = keytrace_load(arguments.replay);
+
+        if (!replay) {
+            fprintf(stderr, "text-editor: cannot read recorded keys from %s\n",
+                    arguments.replay);
+            return 1;
+        }
+    }
+
+    /* keys are written into the recording with every frame shown */
+    KeyTrace record = NULL;
+    if (arguments.record) {
+        record = keytrace_new();
+
+        if (!keytrace_record(record, arguments.record)) {
+            fprintf(stderr, "text-editor: cannot record keys into %s\n",
+                    arguments.record);
+            return 1;
+        }
+    }
+
+    /* trace everything from the start, the render thread included */
+    if (arguments.trace && !trace_start(arguments.trace)) {
+        fprintf(stderr, "text-editor: cannot write trace events into %s\n",
+                arguments.trace);
+        return 1;
+    }
+
+    /* display the screen with the chosen backend, possibly drawn from
+       another thread */
+    Backend b;
+    if (strcmp(arguments.backend, "term") == 0)
+        b = backend_term_new(STDIN_FILENO, STDOUT_FILENO);
+    else
+        b = backend_ncurses_new();
+
+    if (arguments.render_thread)
+        b = backend_threaded_new(b);
+
+    /* feed the editor recorded keys, possibly recording them again */
+    if (replay)
+        b = backend_replay_new(b, replay, arguments.replay_max_speed);
+
+    if (record)
+        b = backend_record_new(b, record);
+
+    /* files are viewed without creating the editor's lines */
+    if (viewer) {
+        viewer_init_backend(viewer, b);
+        viewer_loop(viewer);
+
+        viewer_destroy(viewer);
+        backend_destroy(b);
+        trace_stop();
+
+        return 0;
+    }
 
     /* create new "screen" */
     Screen s = screen_init(&arguments);
-    screen_init_ncurses(s);
+    screen_init_backend(s, b);
 
     if (strlen(s->args->file_name) > 0)
         file_open(s, s->args->file_name);
 
+    /* watch the file for appended text, it has to exist for that */
+    if (arguments.follow && !file_follow(s)) {
+        screen_destroy(s);
+        backend_destroy(b);
+        fprintf(stderr, "text-editor: cannot follow %s\n", arguments.file_name);
+        return 1;
+    }
+
+    /* other files are only looked up until they are shown */
+    for (uint i = 1 ; i < arguments.n_files ; ++i)
+        screen_add_buffer(s, arguments.file_names[i]);
+
     /* start input loop */
     input_loop(s);
 
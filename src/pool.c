@@ -0,0 +1,102 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#include <stdlib.h>
+
+#include "pool.h"
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* objects are aligned like anything malloc returns */
+#define POOL_ALIGN (_Alignof(max_align_t))
+
+/* size rounded up to the alignment */
+static size_t aligned(size_t size) {
+    return (size + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+}
+
+/* puts every object of a new block on the free list */
+static void pool_grow(Pool p) {
+    size_t size = POOL_ALIGN + p->object_size * p->per_block;
+    char* block = malloc(size);
+
+    /* blocks are chained through their first bytes */
+    *(void**)block = p->blocks;
+    p->blocks = block;
+    p->n_blocks++;
+    p->allocated += size;
+
+    for (size_t i = p->per_block ; i > 0 ; --i)
+        pool_free(p, block + POOL_ALIGN + (i-1) * p->object_size);
+}
+
+/*****************************************************************************/
+/*                                    Pool                                   */
+/*****************************************************************************/
+
+/* creates an empty pool of objects of the given size */
+Pool pool_new(size_t object_size, size_t per_block) {
+    Pool p = malloc(sizeof *p);
+
+    if (object_size < sizeof(void*))
+        object_size = sizeof(void*);
+
+    p->object_size = aligned(object_size);
+    p->per_block = (per_block > 0) ? per_block : 1;
+    p->free = NULL;
+    p->blocks = NULL;
+    p->n_blocks = 0;
+    p->allocated = 0;
+    p->n_free = 0;
+
+    return p;
+}
+
+/* takes an object from the pool, allocating a new block if none is free */
+void* pool_alloc(Pool p) {
+    if (!p->free)
+        pool_grow(p);
+
+    void* object = p->free;
+    p->free = *(void**)object;
+    p->n_free--;
+
+    return object;
+}
+
+/* gives an object back to the pool */
+void pool_free(Pool p, void* object) {
+    *(void**)object = p->free;
+    p->free = object;
+    p->n_free++;
+}
+
+/* destroys the pool along with every object in it */
+void pool_destroy(Pool p) {
+    while (p->blocks) {
+        void* previous = *(void**)p->blocks;
+        free(p->blocks);
+        p->blocks = previous;
+    }
+
+    free(p);
+}
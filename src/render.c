@@ -18,66 +18,148 @@
  *                                                                      *
  ************************************************************************/
 
+#include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
-
-#include <ncurses.h>
+#include <limits.h>
 
 #include "render.h"
+#include "trace.h"
 #include "lib/gap_buffer.h"
 
-/* renders one line */
-void render_line(gpointer data, gpointer screen) {
-    /* cast the pointer to a screen */
-    Screen s = (Screen)screen;
+/* emits a finished row of cells into the contents window */
+static void render_row(Canvas contents, uint row, Cell* cells, int n) {
+    canvas_put(contents, row, 0, cells, n);
+}
+
+/* decodes the character at the given index of the buffer, whose bytes the
+   gap may be in between, moving the index onto the character's last byte */
+static uint32_t decode_char(gap_T buff, int* i) {
+    char bytes[UTF8_MAX_LENGTH];
+    int at[UTF8_MAX_LENGTH];
+    int n = 0;
+
+    for (int j = *i ; j <= buff->end && n < UTF8_MAX_LENGTH ; ++j) {
+        /* step over the whole gap at once */
+        if (j == buff->gap_start && buff->gap_end >= j) {
+            j = buff->gap_end;
+            continue;
+        }
+
+        at[n] = j;
+        bytes[n++] = buff->buffer[j];
+    }
+
+    uint32_t c;
+    uint length = utf8_decode(bytes, n, &c);
+    *i = at[length-1];
+
+    /* control characters would control the terminal instead */
+    if (c < 0xa0)
+        c = UTF8_REPLACEMENT;
+
+    return c;
+}
+
+/* renders one line into the given window starting at the given row, returns
+   the number of rows the line took up; each visual row is built in the cells
+   buffer and emitted at once instead of printing character by character */
+uint render_line(Screen s, Canvas contents, Line l, uint row, Cell* cells,
+                 int width) {
+    gap_T buff = l->buff;
+    uint first_row = row;
+    uint max_row = contents->rows;
+    int n = 0;
+
+    for (int i = 0 ; i <= buff->end && row < max_row ; ++i) {
+
+        /* jump over the gap, which may be empty, instead of stepping through
+           it a byte at a time */
+        if (i == buff->gap_start && buff->gap_end >= i) {
+            i = buff->gap_end;
+            continue;
+        }
+
+        /* omit nulls */
+        if (!buff->buffer[i])
+            continue;
 
-    /* cast the pointer to a line buffer */
-    gap_T buff = ((Line)data)->buff;
+        char c = buff->buffer[i];
 
-    for (int i = 0 ; i <= buff->end ; ++i) {
+        /* end of the line, emit whatever is left in the row */
+        if (c == '\n') {
+            /* mark the end of the line if debug mode is enabled */
+            if (s->args->debug_mode && n != width-1)
+                cells[n++] = (Cell){ '$', ATTR_BLUE, 0 };
 
-        /* skip the gap and omit nulls */
-        if ((i >= buff->gap_start && i <= buff->gap_end) || !buff->buffer[i])
+            render_row(contents, row++, cells, n);
+            n = 0;
             continue;
+        }
 
-        /*************************************************************/
-        /*     Print special characters if debug mode is enabled     */
-        /*************************************************************/
-        if (s->args->debug_mode) {
-            switch (buff->buffer[i]) {
-            case '\n':
-                if (getcurx(s->contents) != getmaxx(s->contents)-1)
-                    waddch(s->contents, '$' | COLOR_PAIR(1));
+        /* resolve the cells the character takes up */
+        Cell expanded[TAB_WIDTH_MAX];
+        int len = 1;
 
-                waddch(s->contents, '\n');
-                break;
+        /* ASCII lines are rendered a byte a cell */
+        if (!l->ascii && (c & 0x80)) {
+            uint32_t ch = decode_char(buff, &i);
 
-            case '\0':
-                wprintw(s->contents, "%");
-                break;
+            switch (utf8_width(ch)) {
+
+            case 0:
+                /* combining marks go over the character before them */
+                if (n > 0 && !cells[n-1].mark)
+                    cells[n-1].mark = ch;
+                continue;
 
-            case '\t':
-                wattron(s->contents, COLOR_PAIR(2));
-                wprintw(s->contents, " -> ");
-                wattroff(s->contents, COLOR_PAIR(2));
+            case 2:
+                /* a wide character the window's edge would split goes whole
+                   onto the next row, the last cell of this one is left
+                   blank, as the line's columns count it */
+                len = 0;
+                if (n == width-1)
+                    expanded[len++] = (Cell){ ' ', ATTR_NONE, 0 };
+
+                expanded[len++] = (Cell){ ch, ATTR_NONE, 0 };
+                expanded[len++] = (Cell){ CELL_WIDE, ATTR_NONE, 0 };
                 break;
 
             default:
-                wprintw(s->contents, "%c", buff->buffer[i]);
+                expanded[0] = (Cell){ ch, ATTR_NONE, 0 };
                 break;
             }
+        } else if (c == '\t') {
+            /* tabs go up to the next tab stop of the line */
+            uint col = (row-first_row)*width + n;
+            len = TAB_COLUMNS(col, s->tab_width);
+
+            for (int j = 0 ; j < len ; ++j) {
+                if (!s->args->debug_mode)
+                    expanded[j] = (Cell){ ' ', ATTR_NONE, 0 };
+                else if (j+2 == len)
+                    expanded[j] = (Cell){ '>', ATTR_GREEN, 0 };
+                else
+                    expanded[j] = (Cell){ (j == 0 || j+1 == len) ? ' ' : '-',
+                                          ATTR_GREEN, 0 };
+            }
+        } else {
+            expanded[0] = (Cell){ (unsigned char)c, ATTR_NONE, 0 };
         }
-        /*********************************************************/
-        /*        Print normally if debug mode is not enabled    */
-        /*********************************************************/
-        else {
-            if (buff->buffer[i] == '\t')
-                wprintw(s->contents, "    ");
-            else
-                wprintw(s->contents, "%c", buff->buffer[i]);
+
+        /* put the cells into the row, wrapping at the window's edge */
+        for (int j = 0 ; j < len ; ++j) {
+            cells[n++] = expanded[j];
+
+            if (n == width) {
+                render_row(contents, row++, cells, n);
+                n = 0;
+            }
         }
     }
+
+    return row - first_row;
 }
 
 /* macro for adjusting cursor position according to the gap */
@@ -88,20 +170,31 @@ void render_line(gpointer data, gpointer screen) {
                     ((CURR_LINE->wrap != CURR_LINE->wraps) ? s->cols :  \
                      CURR_LINE->visual_end-s->cols*CURR_LINE->wraps-CURR_LINE->wraps))
 
-/* renders the screen */
-void render_contents(Screen s) {
+/* renders lines from the given one down into the window, replacing what
+   was there */
+static void render_lines(Screen s, Canvas contents, GList* top) {
     /* erase previous contents */
-    werase(s->contents);
+    canvas_erase(contents);
+
+    /* buffer for building one visual row at a time */
+    int width = contents->cols;
+    Cell* cells = malloc(sizeof(Cell) * width);
 
     /* render every line, stop if window is filled */
-    uint cnt = 0;
-    for (GList* curr = s->top_line ; curr != NULL ; curr = curr->next) {
-        render_line(curr->data, s);
-        cnt += 1 + ((Line)curr->data)->wraps;
+    uint rows = contents->rows;
+    uint row = 0;
+    for (GList* curr = top ; curr != NULL && row < rows ;
+         curr = curr->next)
+        row += render_line(s, contents, curr->data, row, cells, width);
 
-        if (cnt >= s->rows)
-            break;
-    }
+    free(cells);
+}
+
+/* renders the screen */
+void render_contents(Screen s) {
+    uint64_t span = trace_begin();
+
+    render_lines(s, s->contents, s->top_line);
 
     /*************************************************************************/
     /*                         Render debug mode info                        */
@@ -109,173 +202,354 @@ void render_contents(Screen s) {
 
     if (s->args->debug_mode) {
         /* erase previous contents */
-        werase(s->debug_info);
+        canvas_erase(s->debug_info);
 
         /* render a bar separating debug info from contents ******************/
-        wattron(s->debug_info, A_REVERSE);
-
-        for (int i = 0 ; i < LINES ; ++i)
-            mvwprintw(s->debug_info, i, 0, " ");
-
-        wattroff(s->debug_info, A_REVERSE);
+        for (int i = 0 ; i < s->debug_info->rows ; ++i)
+            canvas_put_str(s->debug_info, i, 0, " ", ATTR_REVERSE);
 
         /* render actual debug information ***********************************/
 
         /* number of lines */
-        mvwprintw(s->debug_info, 0, 2, "Number of lines: %d", s->n_lines);
+        canvas_printf(s->debug_info, 0, 2, "Number of lines: %d", s->n_lines);
 
         /* visual cursor coordinates */
-        mvwprintw(s->debug_info, 1, 2, "Visual col: %d row: %d", s->col, s->row);
+        canvas_printf(s->debug_info, 1, 2, "Visual col: %d row: %d", s->col, s->row);
 
         /* actual cursor position */
-        mvwprintw(s->debug_info, 2, 2, "Line cursor: %d", CURR_LBUF->cursor);
+        canvas_printf(s->debug_info, 2, 2, "Line cursor: %d", CURR_LBUF->cursor);
 
-        mvwprintw(s->debug_info, 3, 2, "Visual line end: %d",
-                  CURR_LINE->visual_end);
+        canvas_printf(s->debug_info, 3, 2, "Visual line end: %d",
+                      CURR_LINE->visual_end);
 
-        mvwprintw(s->debug_info, 4, 2, "Line wraps: %d",
-                  CURR_LINE->wraps);
+        canvas_printf(s->debug_info, 4, 2, "Line wraps: %d",
+                      CURR_LINE->wraps);
 
         /* end of the current line */
-        mvwprintw(s->debug_info, 5, 2,
-                  "Line end: %d", CURR_LBUF->end - GAP_SIZE);
+        canvas_printf(s->debug_info, 5, 2,
+                      "Line end: %d", CURR_LBUF->end - GAP_SIZE);
 
         /* gap start & end */
-        mvwprintw(s->debug_info, 6, 2,
-                  "Line gap: %d - %d", CURR_LBUF->gap_start, CURR_LBUF->gap_end);
+        canvas_printf(s->debug_info, 6, 2,
+                      "Line gap: %d - %d", CURR_LBUF->gap_start, CURR_LBUF->gap_end);
 
 
         /* character currently under the cursor */
         switch (CURR_LBUF->buffer[CURSOR_CHAR]) {
 
         case '\n':
-            mvwprintw(s->debug_info, 7, 2, "Line cursor on: (\\n)");
+            canvas_printf(s->debug_info, 7, 2, "Line cursor on: (\\n)");
             break;
 
         case '\0':
-            mvwprintw(s->debug_info, 7, 2, "Line cursor on: (\\0)");
+            canvas_printf(s->debug_info, 7, 2, "Line cursor on: (\\0)");
             break;
 
         case '\t':
-            mvwprintw(s->debug_info, 7, 2, "Line cursor on: (\\t)");
+            canvas_printf(s->debug_info, 7, 2, "Line cursor on: (\\t)");
             break;
 
         default:
-            mvwprintw(s->debug_info, 7, 2, "Line cursor on: (%c)",
-                      CURR_LBUF->buffer[CURSOR_CHAR]);
+            canvas_printf(s->debug_info, 7, 2, "Line cursor on: (%c)",
+                          CURR_LBUF->buffer[CURSOR_CHAR]);
             break;
         }
 
-        mvwprintw(s->debug_info, 8, 2, "File name: %s", s->args->file_name);
-
-        mvwprintw(s->debug_info, 9, 2, "Top line num: %d", s->top_line_num);
-        mvwprintw(s->debug_info, 10, 2, "Curr l_num: %d", s->cur_line_num);
-        mvwprintw(s->debug_info, 11, 2, "s->rows: %d", s->rows);
-        mvwprintw(s->debug_info, 12, 2, "s->cols: %d", s->cols);
-        mvwprintw(s->debug_info, 13, 2, "line wrap: %d", CURR_LINE->wrap);
-        mvwprintw(s->debug_info, 14, 2, "VISUAL_END: %d", VISUAL_END);
-        mvwprintw(s->debug_info, 15, 2, "Stored col: %d", s->stored_col);
-        mvwprintw(s->debug_info, 16, 2, "Modified: %d", s->modified);
-        mvwprintw(s->debug_info, 17, 2, "Bottom info bar: %d", s->render_info_bar_bottom);
+        canvas_printf(s->debug_info, 8, 2, "File name: %s", CURR_BUFF->file_name);
+
+        canvas_printf(s->debug_info, 9, 2, "Top line num: %d", s->top_line_num);
+        canvas_printf(s->debug_info, 10, 2, "Curr l_num: %d", s->cur_line_num);
+        canvas_printf(s->debug_info, 11, 2, "s->rows: %d", s->rows);
+        canvas_printf(s->debug_info, 12, 2, "s->cols: %d", s->cols);
+        canvas_printf(s->debug_info, 13, 2, "line wrap: %d", CURR_LINE->wrap);
+        canvas_printf(s->debug_info, 14, 2, "VISUAL_END: %d", VISUAL_END);
+        canvas_printf(s->debug_info, 15, 2, "Stored col: %d", s->stored_col);
+        canvas_printf(s->debug_info, 16, 2, "Modified: %d", s->modified);
+        canvas_printf(s->debug_info, 17, 2, "Bottom info bar: %d", s->render_info_bar_bottom);
+        canvas_printf(s->debug_info, 18, 2, "Backend: %s", s->backend->name);
+
+        /* output of the last frame, if the backend knows it */
+        if (s->backend->frame_bytes >= 0)
+            canvas_printf(s->debug_info, 20, 2, "Frame bytes: %ld",
+                          s->backend->frame_bytes);
+
+        /* key which was not handled by the editor */
+        if (s->unhandled_key != ERR)
+            canvas_printf(s->debug_info, 19, 2, "Unhandled key: %d",
+                          s->unhandled_key);
+
+        /* timings of past frames */
+        Histogram frames = s->timings[STAGE_FRAME];
+        canvas_printf(s->debug_info, 21, 2, "Frame p50: %lu us",
+                      (unsigned long)histogram_percentile(frames, 50));
+        canvas_printf(s->debug_info, 22, 2, "Frame p99: %lu us",
+                      (unsigned long)histogram_percentile(frames, 99));
+        canvas_printf(s->debug_info, 23, 2, "Worst frame: %lu us",
+                      (unsigned long)frames->max);
+
+        static const char* stages[] = { "Input", "Edit", "Render", "Flush" };
+        for (int i = 0 ; i < 4 ; ++i)
+            canvas_printf(s->debug_info, 24+i, 2, "%s p99: %lu us", stages[i],
+                          (unsigned long)histogram_percentile(s->timings[i], 99));
+
+        /* memory used by all lines */
+        canvas_printf(s->debug_info, 29, 2, "Lines alive: %ld",
+                      line_stats.lines);
+        canvas_printf(s->debug_info, 30, 2, "Capacity: %ld KB",
+                      gap_buffer_stats.capacity / 1024);
+        canvas_printf(s->debug_info, 31, 2, "Text: %ld KB",
+                      gap_buffer_stats.text / 1024);
+        canvas_printf(s->debug_info, 32, 2, "Gap slack: %ld KB",
+                      (gap_buffer_stats.capacity - gap_buffer_stats.text) / 1024);
+        canvas_printf(s->debug_info, 33, 2, "Mallocs: %ld",
+                      line_stats.allocations + gap_buffer_stats.allocations);
+        canvas_printf(s->debug_info, 34, 2, "Malloc'd: %ld KB",
+                      (line_stats.allocated + gap_buffer_stats.allocated) / 1024);
+        canvas_printf(s->debug_info, 35, 2, "Pooled lines: %ld",
+                      line_stats.pooled);
+
+        /* buffers, most of which may not be read yet */
+        uint loaded = 0;
+        for (GList* curr = s->buffers ; curr != NULL ; curr = curr->next)
+            loaded += ((Buffer)curr->data)->loaded;
+
+        canvas_printf(s->debug_info, 37, 2, "Buffers: %u (%u read)",
+                      s->n_buffers, loaded);
     }
 
     /*************************************************************************/
     /*                        Adjust window attributes                       */
     /*************************************************************************/
-    wmove(s->contents, s->row, s->col);
-
-    if (s->args->debug_mode)
-        wrefresh(s->debug_info);
+    canvas_move(s->contents, s->row, s->col);
 
-    wrefresh(s->contents);
-    curs_set(1);
+    trace_end("render_contents", span);
 }
 
 #undef CURSOR_CHAR
 
-void render_line_numbers(Screen s) {
-    curs_set(0);
-
-    werase(s->line_numbers);
+/* values kept in gutter_rows of panes for rows without a line number */
+#define GUTTER_WRAP 0 /* continuation of a wrapped line */
+#define GUTTER_TILDE UINT_MAX /* row past the last line */
+#define GUTTER_UNKNOWN (UINT_MAX-1) /* row not painted yet */
+
+/* renders line numbers of lines from the given one down into the window,
+   repainting rows whose number differs from the one in gutter_rows only */
+static void render_gutter(Screen s, Canvas line_numbers, uint** gutter_rows,
+                          GList* top, uint top_num) {
+    uint rows = line_numbers->rows;
+
+    /* window was recreated, nothing is painted on it yet */
+    if (!*gutter_rows) {
+        *gutter_rows = malloc(sizeof(uint) * rows);
+        for (uint i = 0 ; i < rows ; ++i)
+            (*gutter_rows)[i] = GUTTER_UNKNOWN;
+    }
 
-    /* enable color for rendering lines */
-    wattron(s->line_numbers, COLOR_PAIR(3));
+    uint* painted = *gutter_rows;
+    int digits = s->gutter_width-1;
+    char text[32];
+
+    GList* curr = top;
+    uint line_number = top_num+1;
+    uint wraps_left = 0;
+
+    for (uint row = 0 ; row < rows ; ++row) {
+        /* find what belongs on this row */
+        uint value;
+        if (wraps_left > 0) {
+            value = GUTTER_WRAP;
+            wraps_left--;
+        } else if (curr != NULL) {
+            value = line_number++;
+            wraps_left = ((Line)curr->data)->wraps;
+            curr = curr->next;
+        } else {
+            value = GUTTER_TILDE;
+        }
 
-    /* render actual numbers */
-    GList* curr = s->top_line;
-    uint j;
-    uint line_number = s->top_line_num+1;
-    uint last_line_number = s->n_lines-s->top_line_num;
-    for (uint i = 0 ; i < last_line_number ; ++i) {
-        mvwprintw(s->line_numbers, i, 0, "%4d", line_number);
+        /* skip rows which already show the right thing */
+        if (painted[row] == value)
+            continue;
 
-        if (((Line)curr->data)->wraps != 0) {
-            for (j = 1 ; j < ((Line)curr->data)->wraps ; ++j) {
-                mvwprintw(s->line_numbers, i+j-1, 0, "");
-            }
+        painted[row] = value;
 
-            i += j;
-            last_line_number += j;
+        if (value == GUTTER_WRAP) {
+            snprintf(text, sizeof text, "%*s", digits+1, "");
+        } else if (value == GUTTER_TILDE) {
+            /* render tildes on non-existing lines */
+            snprintf(text, sizeof text, "%*s~ ", digits-1, "");
+        } else {
+            snprintf(text, sizeof text, "%*u ", digits, value);
         }
 
-        curr = curr->next;
-        line_number++;
+        text[digits+1] = '\0';
+        canvas_put_str(line_numbers, row, 0, text,
+                       (value == GUTTER_WRAP || value == GUTTER_TILDE) ?
+                       ATTR_NONE : ATTR_YELLOW);
     }
+}
 
-    /* disable the color */
-    wattroff(s->line_numbers, COLOR_PAIR(3));
+/* renders line numbers of the visible rows, repainting changed rows only */
+void render_line_numbers(Screen s) {
+    uint64_t span = trace_begin();
 
-    /* render tildes on non-existing lines */
-    for (uint i = last_line_number ; i <= s->rows ; ++i)
-        mvwprintw(s->line_numbers, i, 3, "~");
+    render_gutter(s, s->line_numbers, &CURR_PANE->gutter_rows,
+                  s->top_line, s->top_line_num);
 
-    wrefresh(s->line_numbers);
+    trace_end("render_line_numbers", span);
 }
 
-void render_info_bar_top(Screen s) {
-    curs_set(0);
+#undef GUTTER_WRAP
+#undef GUTTER_TILDE
+#undef GUTTER_UNKNOWN
+
+/* puts text into a bar at the given column, clipping it at the bar's end */
+void bar_put(char* bar, int width, int x, const char* text) {
+    for (int i = 0 ; text[i] && x+i < width ; ++i) {
+        if (x+i >= 0)
+            bar[x+i] = text[i];
+    }
+}
 
-    werase(s->info_bar_top);
-    wattron(s->info_bar_top, A_REVERSE);
+/* draws the bar if its text differs from the last one drawn on it,
+   takes ownership of the text */
+void bar_draw(Canvas bar, char** last, char* text) {
+    if (*last && strcmp(*last, text) == 0) {
+        free(text);
+        return;
+    }
 
-    /* render bacground ******************************************************/
+    canvas_put_str(bar, 0, 0, text, ATTR_REVERSE);
 
-    for (int i = 0 ; i < COLS ; ++i)
-        mvwprintw(s->info_bar_top, 0, i, " ");
+    free(*last);
+    *last = text;
+}
 
-    mvwprintw(s->info_bar_top, 0, 2, "text-editor 0.1");
+void render_info_bar_top(Screen s) {
+    int width = s->backend->cols;
+    char* bar = malloc(width+1);
+    memset(bar, ' ', width);
+    bar[width] = '\0';
+
+    bar_put(bar, width, 2, "text-editor 0.1");
+
+    /* number of the shown buffer, if there are more */
+    if (s->n_buffers > 1) {
+        char number[32];
+        snprintf(number, sizeof number, "[%d/%u]",
+                 g_list_position(s->buffers, s->cur_buffer)+1, s->n_buffers);
+        bar_put(bar, width, 19, number);
+    }
 
     /* render current file name or "New Buffer" */
-    if (strlen(s->args->file_name) > 0) {
-        mvwprintw(s->info_bar_top, 0, COLS/2-strlen(s->args->file_name)/2-3,
-                  "File: %s", s->args->file_name);
+    char* file_name = CURR_BUFF->file_name;
+    if (strlen(file_name) > 0) {
+        int x = width/2-strlen(file_name)/2-3;
+        bar_put(bar, width, x, "File: ");
+        bar_put(bar, width, x+6, file_name);
     } else {
-        mvwprintw(s->info_bar_top, 0, COLS/2-5, "New Buffer");
+        bar_put(bar, width, width/2-5, "New Buffer");
     }
 
     if (s->modified == true)
-        mvwprintw(s->info_bar_top, 0, COLS-10, "Modified");
+        bar_put(bar, width, width-10, "Modified");
 
-    wattroff(s->info_bar_top, A_REVERSE);
-    wrefresh(s->info_bar_top);
+    bar_draw(s->info_bar_top, &s->info_bar_top_text, bar);
 }
 
-
 void render_info_bar_bottom(Screen s) {
-    curs_set(0);
+    int width = s->backend->cols;
+    char* bar = malloc(width+1);
+    memset(bar, ' ', width);
+    bar[width] = '\0';
 
-    werase(s->info_bar_bottom);
-    wattron(s->info_bar_bottom, A_REVERSE);
+    /* render current line and column number */
+    char position[32];
+    snprintf(position, sizeof position, "%4d:%-4d",
+             s->cur_line_num+1, CURR_LINE->visual_cursor);
+    bar_put(bar, width, width-11, position);
 
-    /* render bacground ******************************************************/
+    bar_draw(s->info_bar_bottom, &s->info_bar_bottom_text, bar);
+}
 
-    for (int i = 0 ; i < COLS ; ++i)
-        mvwprintw(s->info_bar_bottom, 0, i, " ");
+/* renders a pane the cursor isn't in, with the view it keeps */
+static void render_pane(Screen s, Pane p) {
+    uint64_t span = trace_begin();
 
-    /* render current line and column number */
-    mvwprintw(s->info_bar_bottom, 0, COLS-11, "%4d:%-4d",
-              s->cur_line_num+1, CURR_LINE->visual_cursor);
+    render_gutter(s, p->line_numbers, &p->gutter_rows,
+                  p->top_line, p->top_line_num);
+    render_lines(s, p->contents, p->top_line);
+
+    p->paints++;
+
+    trace_end("render_pane", span);
+}
+
+/* renders and stages the bars between panes and the panes the cursor isn't
+   in, skipping those whose lines didn't change since they were painted;
+   staged windows stay on the terminal until staged again */
+static void render_panes(Screen s) {
+    for (GList* curr = s->panes ; curr != NULL ; curr = curr->next) {
+        Pane p = curr->data;
+
+        if (p->separator && p->dirty) {
+            for (int i = 0 ; i < p->separator->cols ; ++i)
+                canvas_put_str(p->separator, 0, i, " ", ATTR_REVERSE);
+            canvas_stage(p->separator);
+        }
+
+        if (curr == s->cur_pane) {
+            p->dirty = false;
+            continue;
+        }
+
+        /* lines past the pane's rows can't be on it, as every line takes
+           at least one row */
+        bool changed = s->changed_first < p->top_line_num + p->rows &&
+            s->changed_last >= p->top_line_num;
+
+        if (p->dirty || changed) {
+            render_pane(s, p);
+            canvas_stage(p->line_numbers);
+            canvas_stage(p->contents);
+        }
+
+        p->dirty = false;
+    }
+
+    s->changed_first = UINT_MAX;
+    s->changed_last = 0;
+}
+
+/* renders every window and updates the terminal once for the whole frame */
+void render_frame(Screen s) {
+    uint64_t start = time_us();
+
+    render_info_bar_top(s);
+    if (s->render_info_bar_bottom)
+        render_info_bar_bottom(s);
+    render_panes(s);
+    render_line_numbers(s);
+    render_contents(s);
+    CURR_PANE->paints++;
+
+    /* stage the windows, contents last so that the cursor ends up there */
+    canvas_stage(s->info_bar_top);
+    if (s->render_info_bar_bottom)
+        canvas_stage(s->info_bar_bottom);
+    canvas_stage(s->line_numbers);
+    if (s->args->debug_mode)
+        canvas_stage(s->debug_info);
+    canvas_stage(s->contents);
+
+    uint64_t composed = time_us();
+    uint64_t span = trace_begin();
+    backend_update(s->backend);
+    trace_end("backend_update", span);
+
+    s->stage_times[STAGE_RENDER] += composed - start;
+    s->stage_times[STAGE_FLUSH] += time_us() - composed;
 
-    wattroff(s->info_bar_bottom, A_REVERSE);
-    wrefresh(s->info_bar_bottom);
+    trace_counter("lines", line_stats.lines);
+    trace_counter("text bytes", gap_buffer_stats.text);
 }
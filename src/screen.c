@@ -19,24 +19,56 @@
  ************************************************************************/
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "screen.h"
 #include "render.h"
 #include "input.h"
 #include "files.h"
+#include "pool.h"
 #include "lib/gap_buffer.h"
 
+struct line_stats line_stats;
+
+/* a line together with its gap buffer struct, taken from the pool at once */
+struct line_node {
+    struct _line line;
+    struct gap_buffer buff;
+};
+
+/* lines of every buffer come from & go back to this pool */
+static Pool line_pool = NULL;
+
+static void* frame_watchdog(void*);
+
 Line line_create() {
+    if (!line_pool)
+        line_pool = pool_new(sizeof(struct line_node), LINE_POOL_BLOCK);
+
+    /* take memory for the line and its buffer from the pool */
+    long blocks = line_pool->n_blocks;
+    size_t allocated = line_pool->allocated;
+    struct line_node* node = pool_alloc(line_pool);
+    Line l = &node->line;
+    gap_T new_line = &node->buff;
+
     /* create a buffer for the new line */
-    gap_T new_line = gap_buffer_new();
+    gap_buffer_init(new_line);
 
     /* add \n to the line and move the cursor one character to the left */
     gap_buffer_put(new_line, '\n');
     gap_buffer_move_cursor(new_line, -1);
 
-    /* allocate memory for the new line */
-    Line l = malloc(sizeof *l);
+    /* only a new block of the pool is an allocation, not a reused line */
+    line_stats.lines++;
+    line_stats.allocations += line_pool->n_blocks - blocks;
+    line_stats.allocated += line_pool->allocated - allocated;
+    line_stats.pooled = line_pool->n_free;
 
     l->buff = new_line;
     l->visual_cursor = 0;
@@ -44,23 +76,560 @@ Line line_create() {
 
     l->wrap = 0;
     l->wraps = 0;
+    l->ascii = true;
+    l->wide = false;
+    l->marks = NULL;
+    l->n_marks = 0;
+    l->marks_size = 0;
 
     return l;
 }
 
 void line_destroy(Line l) {
-    gap_buffer_destroy(l->buff);
-    free(l);
+    line_stats.lines--;
+
+    /* the line is the first member of its node */
+    gap_buffer_release(l->buff);
+    free(l->marks);
+    pool_free(line_pool, l);
+
+    line_stats.pooled = line_pool->n_free;
 }
 
-/* initializes the screen & its buffer */
-Screen screen_init(struct Arguments* args) {
-    Screen s = malloc(sizeof *s);
+/* byte of the line's text at the given index, the gap not counted */
+static char line_byte(gap_T g, int i) {
+    return g->buffer[(i < g->gap_start) ? i : i + g->gap_end - g->gap_start + 1];
+}
+
+/* index of the cursor in the line's text, the gap not counted */
+static int line_cursor_index(gap_T g) {
+    return (g->cursor <= g->gap_start) ? g->cursor :
+        g->cursor - (g->gap_end - g->gap_start);
+}
+
+/* number of bytes of the line's text, the \n included */
+static int line_length(gap_T g) {
+    return g->end - g->gap_end + g->gap_start;
+}
+
+/* decodes the character at the given index of the line's text */
+static uint line_decode(gap_T g, int i, uint32_t* c) {
+    int length = line_length(g);
+
+    /* copy out the bytes, the gap may be in between them */
+    char bytes[UTF8_MAX_LENGTH];
+    int n = 0;
+    while (n < UTF8_MAX_LENGTH && i+n < length) {
+        bytes[n] = line_byte(g, i+n);
+        ++n;
+    }
+
+    return utf8_decode(bytes, n, c);
+}
+
+/* decodes the character beginning the given number of bytes after the
+   line's cursor, returns its number of bytes, 0 past the line's end */
+uint line_char_at(Line l, uint offset, uint32_t* c) {
+    gap_T g = l->buff;
+    int first = line_cursor_index(g) + offset;
+
+    if (first >= line_length(g))
+        return 0;
+
+    return line_decode(g, first, c);
+}
+
+/* decodes the character ending the given number of bytes before the line's
+   cursor, returns its number of bytes, 0 before the line's beginning */
+uint line_char_ending(Line l, uint offset, uint32_t* c) {
+    gap_T g = l->buff;
+    int end = line_cursor_index(g) - (int)offset;
+
+    if (end <= 0)
+        return 0;
+
+    /* go back over continuation bytes to the first byte */
+    int first = end-1;
+    while (first > 0 && end - first < UTF8_MAX_LENGTH &&
+           (line_byte(g, first) & 0xc0) == 0x80)
+        --first;
+
+    char bytes[UTF8_MAX_LENGTH];
+    for (int i = first ; i < end ; ++i)
+        bytes[i-first] = line_byte(g, i);
+
+    /* bytes which don't make up one character are one character each */
+    if (utf8_decode(bytes, end-first, c) != (uint)(end-first)) {
+        *c = UTF8_REPLACEMENT;
+        return 1;
+    }
+
+    return end-first;
+}
+
+/* offset of the line's cursor in its text, the gap not counted */
+uint line_cursor_offset(Line l) {
+    return line_cursor_index(l->buff);
+}
+
+/* index of the line's first mark at or after the offset */
+static uint line_mark_index(Line l, uint offset) {
+    uint first = 0;
+    uint last = l->n_marks;
+
+    while (first < last) {
+        uint middle = first + (last-first)/2;
+
+        if (l->marks[middle].offset < offset)
+            first = middle+1;
+        else
+            last = middle;
+    }
+
+    return first;
+}
+
+/* adds a mark at the given offset of the line, beginning on the column,
+   returns its index */
+static uint line_add_mark(Line l, uint offset, uint col, bool tab) {
+    if (l->n_marks == l->marks_size) {
+        l->marks_size = (l->marks_size) ? l->marks_size*2 : 4;
+        l->marks = realloc(l->marks, sizeof(struct line_mark) * l->marks_size);
+    }
+
+    uint i = line_mark_index(l, offset);
+    memmove(l->marks+i+1, l->marks+i, sizeof(struct line_mark) * (l->n_marks-i));
+
+    l->marks[i] = (struct line_mark){ offset, col, 0, tab, false };
+    l->n_marks++;
+
+    return i;
+}
+
+/* offset & column right after the mark */
+static void line_mark_end(struct line_mark* m, uint tab_width, uint* offset,
+                          uint* col) {
+    *offset = (m->tab) ? m->offset+1 : m->offset;
+    *col = (m->tab) ? m->col + TAB_COLUMNS(m->col, tab_width) : m->col;
+}
+
+/* the line's tab at the given offset, NULL if there's no tab there */
+struct line_mark* line_tab_at(Line l, uint offset) {
+    uint i = line_mark_index(l, offset);
+
+    if (i == l->n_marks || l->marks[i].offset != offset || !l->marks[i].tab)
+        return NULL;
+
+    return &l->marks[i];
+}
+
+/* adds a tab at the given offset of the line, beginning on the column */
+void line_add_tab(Line l, uint offset, uint col) {
+    line_add_mark(l, offset, col, true);
+}
+
+/* moves the marks of the line from the given offset on by a number of
+   bytes & columns, returns by how many columns the end of the line moved;
+   marks of removed bytes are removed, and the tab stop after a moved tab
+   may take in the columns, so the marks after it stay */
+int line_move_marks(Line l, uint offset, int bytes, int cols, uint tab_width) {
+    uint first = line_mark_index(l, offset);
+
+    if (bytes < 0) {
+        uint last = line_mark_index(l, offset-bytes);
+        memmove(l->marks+first, l->marks+last,
+                sizeof(struct line_mark) * (l->n_marks-last));
+        l->n_marks -= last-first;
+    }
+
+    for (uint i = first ; i < l->n_marks ; ++i) {
+        struct line_mark* m = &l->marks[i];
+        m->offset += bytes;
+
+        if (cols == 0)
+            continue;
+
+        if (!m->tab) {
+            m->col += cols;
+            continue;
+        }
+
+        /* the tab's end moves to the stop after its new beginning */
+        int end = m->col + TAB_COLUMNS(m->col, tab_width);
+        m->col += cols;
+        cols = m->col + TAB_COLUMNS(m->col, tab_width) - end;
+    }
+
+    return cols;
+}
+
+/* marks the character at the given offset of an edited line, beginning on
+   the column, if the marks around it are more than LINE_INDEX_STEP bytes
+   apart, so that edits keep the column index as dense as measuring does */
+void line_keep_index(Line l, uint offset, uint col) {
+    uint end = line_length(l->buff) - 1;
+    if (offset >= end)
+        return;
+
+    uint i = line_mark_index(l, offset);
+    if (i < l->n_marks && l->marks[i].offset == offset)
+        return;
+
+    uint before = (i > 0) ? l->marks[i-1].offset : 0;
+    uint after = (i < l->n_marks) ? l->marks[i].offset : end;
+
+    if (after - before > LINE_INDEX_STEP)
+        line_add_mark(l, offset, col, false);
+}
+
+/* number of columns a character beginning on the given column takes, a wide
+   one which the end of a row would split also takes the last column of the
+   row & goes whole onto the next one */
+uint char_columns(uint32_t c, uint col, uint row_width) {
+    uint width = utf8_width(c);
+
+    if (width == 2 && col % row_width == row_width-1)
+        return 3;
+
+    return width;
+}
+
+/* sets the kinds of characters up to the next mark on the mark, the text
+   before the first mark has nowhere to keep them */
+static void line_close_span(Line l, int mark, uint wides, bool narrow) {
+    if (mark < 0)
+        return;
+
+    l->marks[mark].wides = wides;
+    l->marks[mark].narrow = narrow;
+}
+
+/* marks a part of the line's text beginning on the given column, returns
+   the column after it; ascii is cleared if the part isn't ASCII & wide is
+   set if it has wide characters */
+uint line_measure_part(Line l, uint offset, uint length, uint col,
+                       uint tab_width, uint row_width) {
+    gap_T g = l->buff;
+    int i = offset;
+    int end = offset + length;
+    int marked = offset; /* offset of the last mark */
+
+    /* the mark the part begins after & the characters since it */
+    int current = (int)line_mark_index(l, offset+1) - 1;
+    uint wides = 0;
+    bool narrow = false;
+
+    while (i < end) {
+        /* mark a character every so often for finding columns quickly */
+        if (i - marked >= LINE_INDEX_STEP && line_byte(g, i) != '\t') {
+            line_close_span(l, current, wides, narrow);
+            current = line_add_mark(l, i, col, false);
+            marked = i;
+            wides = 0;
+            narrow = false;
+        }
+
+        /* bytes up to the gap, the end or the next mark are next to each
+           other */
+        int span = (i < g->gap_start) ? g->gap_start-i : end-i;
+        if (span > end-i)
+            span = end-i;
+        int step = (i - marked < LINE_INDEX_STEP) ?
+            marked + LINE_INDEX_STEP - i : LINE_INDEX_STEP;
+        if (span > step)
+            span = step;
+
+        const char* text = g->buffer + ((i < g->gap_start) ? i :
+                                        i + g->gap_end - g->gap_start + 1);
+
+        /* a byte of ASCII takes a column, tabs go to the next stop */
+        int run = utf8_ascii_length(text, span);
+        const char* from = text;
+        const char* tab;
+        while ((tab = memchr(from, '\t', text+run-from))) {
+            narrow = narrow || tab > from;
+            line_close_span(l, current, wides, narrow);
+
+            col += tab-from;
+            marked = i + (tab-text);
+            current = line_add_mark(l, marked, col, true);
+            col += TAB_COLUMNS(col, tab_width);
+            from = tab+1;
+            wides = 0;
+            narrow = false;
+        }
+        narrow = narrow || text+run > from;
+        col += text+run-from;
+
+        i += run;
+        if (run == span)
+            continue;
+
+        /* other characters are decoded, they may be split by the gap */
+        uint32_t c;
+        i += line_decode(g, i, &c);
+        l->ascii = false;
+
+        uint width = char_columns(c, col, row_width);
+        if (width >= 2) {
+            l->wide = true;
+            wides++;
+        } else if (width == 1) {
+            narrow = true;
+        }
+
+        col += width;
+    }
+
+    line_close_span(l, current, wides, narrow);
+
+    return col;
+}
+
+/* finds the line's marks, visual end & if it's ASCII from its whole text */
+void line_measure(Line l, uint tab_width, uint row_width) {
+    l->n_marks = 0;
+    l->ascii = true;
+    l->wide = false;
+    l->visual_end = line_measure_part(l, 0, line_length(l->buff) - 1, 0,
+                                      tab_width, row_width);
+}
+
+/* column after the characters from one offset of the line up to another,
+   the first one beginning on the given column */
+static uint line_scan_columns(Line l, uint from, uint to, uint col,
+                              uint row_width) {
+    while (from < to) {
+        uint32_t c;
+        from += line_decode(l->buff, from, &c);
+        col += char_columns(c, col, row_width);
+    }
+
+    return col;
+}
+
+/* moves the column & its column on the row over the given number of wide
+   characters, a row at a time; those the end of a row would split go onto
+   the next row */
+static void wide_run(uint* col, uint* row_col, uint wides, uint row_width) {
+    while (2*wides > row_width - *row_col) {
+        uint left = row_width - *row_col;
+        wides -= left/2;
+        *col += left;
+        *row_col = 0;
+
+        /* a column was left at the end of the row, the next one skipped it */
+        if (left % 2 == 1) {
+            wides--;
+            *col += 2;
+            *row_col = 2;
+
+            while (*row_col >= row_width)
+                *row_col -= row_width;
+        }
+    }
+
+    *col += 2*wides;
+    *row_col += 2*wides;
+    if (*row_col == row_width)
+        *row_col = 0;
+}
+
+/* moves the marks from the given one on after the text before them changed
+   to end on the column; spans of narrow or of wide characters are moved
+   at once & only mixed ones are read again, until a mark is where it was;
+   returns the column the line ends on */
+static uint line_shift_spans(Line l, uint first, uint col, uint tab_width,
+                             uint row_width) {
+    struct line_mark* last = l->marks + l->n_marks;
+    uint row_col = col % row_width;
+
+    for (struct line_mark* m = l->marks + first ; m < last ; ++m) {
+        /* the rest of the line is where it was */
+        if (m->col == col)
+            return l->visual_end;
+
+        uint old_col = m->col;
+        uint width = 0;
+        m->col = col;
+
+        if (m->tab) {
+            old_col += TAB_COLUMNS(old_col, tab_width);
+            width = TAB_COLUMNS(col, tab_width);
+        }
+
+        if (m->wides == 0) {
+            /* narrow characters take their columns anywhere */
+            width += ((m+1 < last) ? m[1].col : l->visual_end) - old_col;
+        } else if (!m->narrow && width == 0) {
+            wide_run(&col, &row_col, m->wides, row_width);
+            continue;
+        } else {
+            uint next = (m+1 < last) ? m[1].offset :
+                (uint)line_length(l->buff) - 1;
+            col = line_scan_columns(l, m->offset + m->tab, next, col + width,
+                                    row_width);
+            row_col = col % row_width;
+            continue;
+        }
+
+        col += width;
+        row_col += width;
+        if (row_col >= row_width)
+            row_col %= row_width;
+    }
+
+    return col;
+}
+
+/* measures a line with wide characters after bytes were inserted at the
+   offset, or -bytes removed there, from the mark before the change up to the
+   mark after it; the marks after those move a span at a time, since narrow
+   characters take the same columns anywhere & the end of a row splits only
+   wide ones */
+void line_remeasure(Line l, uint offset, int bytes, uint tab_width,
+                    uint row_width) {
+    line_move_marks(l, offset, bytes, 0, tab_width);
+
+    uint first = line_mark_index(l, offset);
+    uint from = 0;
+    uint col = 0;
+    if (first > 0)
+        line_mark_end(&l->marks[first-1], tab_width, &from, &col);
+
+    uint to = line_length(l->buff) - 1;
+    if (first < l->n_marks)
+        to = l->marks[first].offset;
+
+    col = line_measure_part(l, from, to - from, col, tab_width, row_width);
+    l->visual_end = line_shift_spans(l, line_mark_index(l, to), col,
+                                     tab_width, row_width);
+}
+
+/* column the character at the given offset of the line begins on, found
+   from the mark before it */
+uint line_column(Line l, uint offset, uint tab_width, uint row_width) {
+    uint col = 0;
+    uint i = 0;
+
+    /* start after the last mark before the offset */
+    uint mark = line_mark_index(l, offset);
+    if (mark > 0)
+        line_mark_end(&l->marks[mark-1], tab_width, &i, &col);
+
+    if (l->ascii)
+        return col + offset-i;
+
+    return line_scan_columns(l, i, offset, col, row_width);
+}
+
+/* offset of the character of the line the given column is in, found from
+   the mark before it; the offset of the line's \n past its end */
+uint line_offset(Line l, uint col, uint tab_width, uint row_width) {
+    uint end = line_length(l->buff) - 1;
+    uint first = 0;
+    uint last = l->n_marks;
+
+    /* the last mark beginning on or before the column */
+    while (first < last) {
+        uint middle = first + (last-first)/2;
+
+        if (l->marks[middle].col <= col)
+            first = middle+1;
+        else
+            last = middle;
+    }
+
+    uint at = 0;
+    uint i = 0;
+    if (first > 0) {
+        struct line_mark* m = &l->marks[first-1];
+        line_mark_end(m, tab_width, &i, &at);
+
+        if (col < at)
+            return m->offset;
+    }
+
+    if (l->ascii)
+        return (i + col-at < end) ? i + col-at : end;
+
+    while (i < end) {
+        uint32_t c;
+        uint length = line_decode(l->buff, i, &c);
+        uint width = char_columns(c, at, row_width);
+
+        if (at + width > col)
+            break;
+
+        at += width;
+        i += length;
+    }
+
+    return i;
+}
+
+/* writes the given memory counters of lines & their buffers into a file */
+void memory_stats_print(FILE* file, const struct line_stats* lines,
+                        const struct gap_buffer_stats* buffers) {
+    fprintf(file, "Lines: %ld\n", lines->lines);
+    fprintf(file, "Buffer capacity: %ld bytes (peak %ld)\n",
+            buffers->capacity, buffers->peak_capacity);
+    fprintf(file, "Text: %ld bytes\n", buffers->text);
+    fprintf(file, "Gap slack: %ld bytes\n", buffers->capacity - buffers->text);
+    fprintf(file, "Allocations: %ld (%ld bytes)\n",
+            lines->allocations + buffers->allocations,
+            lines->allocated + buffers->allocated);
+    fprintf(file, "Pooled lines: %ld\n", lines->pooled);
+}
+
+/* sets the arguments to their defaults */
+void arguments_init(struct Arguments* arguments) {
+    arguments->debug_mode = false;
+    arguments->file_name = "";
+    arguments->file_names = NULL;
+    arguments->n_files = 0;
+    arguments->max_fps = 0;
+    arguments->render_thread = false;
+    arguments->backend = "ncurses";
+    arguments->record = NULL;
+    arguments->replay = NULL;
+    arguments->replay_max_speed = false;
+    arguments->stats = false;
+    arguments->trace = NULL;
+    arguments->frame_budget = 0;
+    arguments->frame_log = NULL;
+    arguments->tab_width = TAB_WIDTH_DEFAULT;
+    arguments->view = false;
+    arguments->follow = false;
+}
+
+/* parses a whole decimal number from min to max given as an argument,
+   returns false if the text isn't one */
+bool arguments_parse_number(const char* text, uint min, uint max,
+                            uint* number) {
+    /* strtoul would take a sign or leading spaces */
+    if (text[0] < '0' || text[0] > '9')
+        return false;
+
+    char* end;
+    errno = 0;
+    unsigned long value = strtoul(text, &end, 10);
+
+    if (errno != 0 || *end != '\0' || value < min || value > max)
+        return false;
+
+    *number = value;
+    return true;
+}
+
+/* gives the screen an empty document with the cursor at its start */
+static void screen_init_document(Screen s) {
     Line new_line = line_create();
 
     s->lines = NULL; /* start with an empty list */
     s->lines = g_list_append(s->lines, new_line); /* add the first line */
     s->cur_line = s->lines; /* set the current line pointer */
+    s->last_line = s->lines; /* it's the last line too */
 
     s->cur_line_num = 0; /* first line number (index) is 0 */
     s->n_lines = 1; /* initial number of lines is 1 */
@@ -68,97 +637,392 @@ Screen screen_init(struct Arguments* args) {
     s->col = 0; /* visual cursor - first column */
     s->row = 0; /* visual cursor - first row */
 
-    /* default number of rows and cols, useful for debugging */
-    s->rows = 10;
-    s->cols = 30;
-
     s->top_line = s->lines; /* start rendering at the first line */
 
     s->top_line_num = 0; /* first top line's number is 0 */
     s->stored_col = 0; /* initial stored column to 0 */
 
+    s->file = NULL;
+    s->modified = false;
+}
+
+/* creates a buffer of the given file, without reading it */
+static Buffer buffer_new(const char* file_name) {
+    Buffer buf = malloc(sizeof *buf);
+    struct stat st;
+
+    buf->file_name = strdup(file_name);
+    buf->loaded = false;
+    buf->exists = stat(file_name, &st) == 0;
+    buf->file_size = (buf->exists) ? st.st_size : 0;
+
+    buf->lines = NULL;
+    buf->file = NULL;
+    buf->modified = false;
+
+    return buf;
+}
+
+/* creates a pane without windows */
+static Pane pane_new() {
+    Pane p = malloc(sizeof *p);
+
+    p->rows = 0;
+    p->contents = NULL;
+    p->line_numbers = NULL;
+    p->separator = NULL;
+    p->gutter_rows = NULL;
+    p->dirty = true;
+    p->paints = 0;
+
+    return p;
+}
+
+/* destroys a pane along with its windows */
+static void pane_destroy(Pane p) {
+    canvas_delete(p->contents);
+    canvas_delete(p->line_numbers);
+    canvas_delete(p->separator);
+    free(p->gutter_rows);
+    free(p);
+}
+
+/* destroys a buffer which isn't shown, closing its file */
+static void buffer_destroy(Buffer buf) {
+    g_list_free_full(buf->lines, (GDestroyNotify)line_destroy);
+
+    if (buf->file)
+        fclose(buf->file);
+
+    free(buf->file_name);
+    free(buf);
+}
+
+/* initializes the screen & its buffer */
+Screen screen_init(struct Arguments* args) {
+    Screen s = malloc(sizeof *s);
+
+    /* the first buffer is shown from the start */
+    Buffer first = buffer_new(args->file_name ? args->file_name : "");
+    first->loaded = true;
+
+    s->buffers = g_list_append(NULL, first);
+    s->cur_buffer = s->buffers;
+    s->n_buffers = 1;
+
+    screen_init_document(s);
+
+    /* default number of rows and cols, useful for debugging */
+    s->rows = 10;
+    s->cols = 30;
+
+    /* a single pane until it's split */
+    s->panes = g_list_append(NULL, pane_new());
+    s->cur_pane = s->panes;
+    s->changed_first = UINT_MAX;
+    s->changed_last = 0;
+
+    s->backend = NULL;
     s->line_numbers = NULL;
     s->contents = NULL;
     s->info_bar_top = NULL;
     s->info_bar_bottom = NULL;
     s->debug_info = NULL;
-    s->file = NULL;
+
+    s->gutter_width = 5; /* 4 digits + space */
+
+    s->info_bar_top_text = NULL;
+    s->info_bar_bottom_text = NULL;
 
     s->render_info_bar_bottom = true;
+    s->follow_fd = -1;
+    s->follow_pending = false;
 
-    s->modified = false;
+    s->unhandled_key = ERR;
+    s->n_key_bytes = 0;
+    s->tab_width = (args->tab_width) ? args->tab_width : TAB_WIDTH_DEFAULT;
+
+    for (int i = 0 ; i < N_STAGES ; ++i) {
+        s->timings[i] = histogram_new();
+        s->stage_times[i] = 0;
+    }
+    s->frame_start = 0;
+    s->frame_keys = 0;
+    s->frame_key = ERR;
 
     /* set argument structure */
     s->args = args;
 
+    /* the watchdog waits for frame deadlines on the clock of time_us */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+    pthread_mutex_init(&s->frame_lock, NULL);
+    pthread_cond_init(&s->watchdog_wake, &attr);
+    pthread_condattr_destroy(&attr);
+    s->watchdog_stop = false;
+    s->frame_reports = NULL;
+
+    if (args->frame_budget > 0)
+        pthread_create(&s->watchdog, NULL, frame_watchdog, s);
+
     return s;
 }
 
-void screen_init_ncurses(Screen s) {
-    /* create a window for top info bar */
-    s->info_bar_top = newwin(1, COLS, 0, 0);
+/* initializes the screen's windows on the given backend */
+void screen_init_backend(Screen s, Backend b) {
+    s->backend = b;
 
-    /* create a window for bottom info bar */
-    screen_create_info_bar_bottom(s);
+    /* create the windows */
+    screen_resize(s);
+}
+
+/* recomputes wraps of every line and the cursor's position after s->cols
+   has changed, scrolls to the current line if it went off the screen; lines
+   with wide characters are measured again, their columns depend on where
+   the rows end */
+static void screen_rewrap(Screen s) {
+    for (GList* curr = s->lines ; curr != NULL ; curr = curr->next) {
+        Line l = curr->data;
+
+        if (l->wide)
+            line_measure(l, s->tab_width, s->cols+1);
+
+        l->wraps = l->visual_end / (s->cols+1);
+    }
+
+    if (CURR_LINE->wide)
+        CURR_LINE->visual_cursor = line_column(CURR_LINE,
+                                               line_cursor_offset(CURR_LINE),
+                                               s->tab_width, s->cols+1);
+
+    CURR_LINE->wrap = CURR_LINE->visual_cursor / (s->cols+1);
+    s->col = CURR_LINE->visual_cursor % (s->cols+1);
+
+    /* count the rows between the top line and the current one */
+    uint row = 0;
+    for (GList* curr = s->top_line ; curr != s->cur_line && row < s->rows ;
+         curr = curr->next)
+        row += 1 + ((Line)curr->data)->wraps;
+
+    s->row = row + CURR_LINE->wrap;
+
+    if (s->row >= s->rows)
+        screen_scroll_to_current_line(s);
+}
+
+/* number of rows each pane gets, the bottom one gets the rest */
+static uint pane_rows(Screen s, uint n_panes, bool bottom) {
+    /* rows between the top and bottom bars, less separators between panes */
+    uint rows = s->backend->rows - 2 - (n_panes-1);
+
+    return (bottom) ? rows - (n_panes-1) * (rows / n_panes) : rows / n_panes;
+}
+
+/* recreates windows of every pane, one pane under another */
+static void screen_layout_panes(Screen s) {
+    Backend b = s->backend;
+    uint n_panes = g_list_length(s->panes);
+    uint y = 1; /* under the top bar */
+
+    for (GList* curr = s->panes ; curr != NULL ; curr = curr->next) {
+        Pane p = curr->data;
+        p->rows = pane_rows(s, n_panes, curr->next == NULL);
+
+        canvas_delete(p->line_numbers);
+        canvas_delete(p->contents);
+        canvas_delete(p->separator);
+
+        p->line_numbers = canvas_new(b, p->rows, s->gutter_width, y, 0);
+        p->contents = canvas_new(b, p->rows, s->cols+1, y, s->gutter_width);
+        p->separator = (curr->next) ?
+            canvas_new(b, 1, s->gutter_width + s->cols+1, y + p->rows, 0) : NULL;
+
+        y += p->rows + 1;
+    }
 
-    /* create a window for line numbers */
-    s->line_numbers = newwin(LINES-2, 5, 1, 0);
+    /* painted line numbers no longer match the new windows */
+    screen_repaint_panes(s);
 
-    /* create a window for contents */
-    s->contents = newwin(LINES-2,
-                         (s->args->debug_mode) ? COLS-26-5 : COLS-5,
-                         1, 5);
+    /* the screen works with the active pane's windows */
+    s->rows = CURR_PANE->rows;
+    s->contents = CURR_PANE->contents;
+    s->line_numbers = CURR_PANE->line_numbers;
+}
+
+/* lays out the windows according to the terminal size and line numbers */
+void screen_resize(Screen s) {
+    Backend b = s->backend;
+    uint debug_width = (s->args->debug_mode) ? 26 : 0;
+    uint old_cols = s->cols;
+
+    /* set number of cols depending on the window, rows depend on panes */
+    s->cols = b->cols - s->gutter_width - debug_width - 1;
 
-    /* set number of rows and cols depending on the window */
-    s->rows = LINES-2; /* -2 for top and bottom bar */
-    s->cols = (s->args->debug_mode) ? COLS-32 : COLS-6; /* -6 for line nums */
+    /* recreate the windows, they are redrawn entirely on the next render */
+    canvas_delete(s->info_bar_top);
+    canvas_delete(s->debug_info);
+
+    /* create a window for top info bar */
+    s->info_bar_top = canvas_new(b, 1, b->cols, 0, 0);
+
+    /* bottom info bar stays disabled while something else is shown there */
+    if (s->render_info_bar_bottom) {
+        canvas_delete(s->info_bar_bottom);
+        screen_create_info_bar_bottom(s);
+    }
+
+    /* create windows for line numbers and contents of every pane */
+    screen_layout_panes(s);
 
     /* if in debug mode, create additional window for debug information */
     if (s->args->debug_mode)
-        s->debug_info = newwin(LINES-2, 26, 1, COLS-25);
+        s->debug_info = canvas_new(b, b->rows-2, debug_width, 1,
+                                   b->cols-debug_width);
     else
         s->debug_info = NULL;
+
+    /* painted bars no longer match the new windows */
+    free(s->info_bar_top_text);
+    s->info_bar_top_text = NULL;
+    free(s->info_bar_bottom_text);
+    s->info_bar_bottom_text = NULL;
+
+    if (s->cols != old_cols)
+        screen_rewrap(s);
+    else if (s->row >= s->rows)
+        screen_scroll_to_current_line(s);
+}
+
+/* widens or narrows line numbers to fit the number of the last line */
+void screen_fit_line_numbers(Screen s) {
+    uint digits = 4; /* at least 4 digits, like 9999 */
+    for (uint n = s->n_lines ; n > 9999 ; n /= 10)
+        digits++;
+
+    /* digits and a space separating them from contents */
+    if (s->gutter_width != digits+1) {
+        s->gutter_width = digits+1;
+        screen_resize(s);
+    }
+}
+
+/* forgets what was painted on the panes so that they are painted whole on
+   the next frame, for when a window over them is taken away */
+void screen_repaint_panes(Screen s) {
+    for (GList* curr = s->panes ; curr != NULL ; curr = curr->next) {
+        Pane p = curr->data;
+
+        free(p->gutter_rows);
+        p->gutter_rows = NULL;
+        p->dirty = true;
+    }
 }
 
 /* create and enable the bottom info bar */
 void screen_create_info_bar_bottom(Screen s) {
     s->render_info_bar_bottom = true;
-    s->info_bar_bottom = newwin(1, COLS, LINES-1, 0);
+    s->info_bar_bottom = canvas_new(s->backend, 1, s->backend->cols,
+                                    s->backend->rows-1, 0);
+
+    /* the new window is empty, draw the bar on the next render */
+    free(s->info_bar_bottom_text);
+    s->info_bar_bottom_text = NULL;
 }
 
 /* delete and disable the bottom info bar */
 void screen_delete_info_bar_bottom(Screen s) {
     s->render_info_bar_bottom = false;
 
-    for (int i = 0 ; i < COLS ; ++i)
-        mvwprintw(s->info_bar_bottom, 0, i, " ");
+    canvas_erase(s->info_bar_bottom);
+    canvas_stage(s->info_bar_bottom);
+    backend_update(s->backend);
 
-    wrefresh(s->info_bar_bottom);
-    delwin(s->info_bar_bottom);
+    canvas_delete(s->info_bar_bottom);
+    s->info_bar_bottom = NULL;
 }
 
-/* creates a new line under the current one */
-void screen_new_line_under(Screen s) {
-    /* initialize a new line */
-    Line new_line = line_create();
+/* moves lines of inactive panes down after a line was inserted at
+   the given index */
+static void panes_line_inserted(Screen s, uint index) {
+    for (GList* curr = s->panes ; curr != NULL ; curr = curr->next) {
+        Pane p = curr->data;
+
+        if (curr == s->cur_pane)
+            continue;
+
+        if (p->cur_line_num >= index)
+            p->cur_line_num++;
+        if (p->top_line_num >= index)
+            p->top_line_num++;
+    }
+}
+
+/* moves inactive panes off the current line before it's removed, onto the
+   end of the previous line where its text goes */
+static void panes_line_removed(Screen s) {
+    uint index = s->cur_line_num;
+    uint prev_end = ((Line)s->cur_line->prev->data)->visual_end;
+
+    for (GList* curr = s->panes ; curr != NULL ; curr = curr->next) {
+        Pane p = curr->data;
+
+        if (curr == s->cur_pane)
+            continue;
+
+        if (p->cur_line == s->cur_line) {
+            p->cur_line = s->cur_line->prev;
+            p->cursor_col += prev_end;
+            p->cur_line_num--;
+        } else if (p->cur_line_num > index) {
+            p->cur_line_num--;
+        }
 
-    /* insert the new line buffer into the list in its correct position */
-    s->lines = g_list_insert(s->lines, new_line, s->cur_line_num+1);
+        if (p->top_line == s->cur_line) {
+            p->top_line = s->cur_line->prev;
+            p->top_line_num--;
+        } else if (p->top_line_num > index) {
+            p->top_line_num--;
+        }
+    }
+}
+
+/* links the given line under the current one and makes it current */
+void screen_insert_line_under(Screen s, Line line) {
+    panes_line_inserted(s, s->cur_line_num+1);
+
+    /* link the new line right after the current one, without walking
+       the list from its beginning */
+    if (s->cur_line->next)
+        g_list_insert_before(s->lines, s->cur_line->next, line);
+    else
+        g_list_append(s->cur_line, line);
 
     /* set the current line to the new (next) one */
     s->cur_line = s->cur_line->next;
 
+    if (s->cur_line->next == NULL)
+        s->last_line = s->cur_line;
+
     /* increase the number of lines */
     s->n_lines++;
 }
 
+/* creates a new line under the current one */
+void screen_new_line_under(Screen s) {
+    screen_insert_line_under(s, line_create());
+}
+
 /* creates a new line above the current one */
 void screen_new_line_above(Screen s) {
     /* initialize a new line */
     Line new_line = line_create();
 
-    /* insert the new line buffer into the list in its correct position */
-    s->lines = g_list_insert(s->lines, new_line, s->cur_line_num);
+    panes_line_inserted(s, s->cur_line_num);
+
+    /* link the new line right before the current one */
+    s->lines = g_list_insert_before(s->lines, s->cur_line, new_line);
 
     /* increase the number of lines */
     s->n_lines++;
@@ -176,36 +1040,251 @@ void screen_go_to_first_line(Screen s) {
     s->top_line_num = 0;
 
     CURR_LINE->visual_cursor = 0;
+    CURR_LINE->wrap = 0;
+    gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
+}
+
+/* scrolls the rendered lines so that the current line is at the bottom */
+void screen_scroll_to_current_line(Screen s) {
+    GList* top = s->cur_line;
+    uint top_num = s->cur_line_num;
+    uint row = CURR_LINE->wrap;
+
+    /* go up as long as the lines above still fit on the screen */
+    while (top->prev != NULL &&
+           row + 1 + ((Line)top->prev->data)->wraps < s->rows) {
+        top = top->prev;
+        top_num--;
+        row += 1 + ((Line)top->data)->wraps;
+    }
+
+    s->top_line = top;
+    s->top_line_num = top_num;
+    s->row = row;
+}
+
+/* lists a buffer of the given file after the others, the file is only
+   looked up until the buffer is shown */
+void screen_add_buffer(Screen s, const char* file_name) {
+    s->buffers = g_list_append(s->buffers, buffer_new(file_name));
+    s->n_buffers++;
+}
+
+/* moves the document & cursor of the shown buffer into the buffer */
+static void buffer_store(Screen s, Buffer buf) {
+    buf->lines = s->lines;
+    buf->last_line = s->last_line;
+    buf->n_lines = s->n_lines;
+    buf->cur_line = s->cur_line;
+    buf->cur_line_num = s->cur_line_num;
+    buf->stored_col = s->stored_col;
+    buf->top_line = s->top_line;
+    buf->top_line_num = s->top_line_num;
+    buf->row = s->row;
+    buf->col = s->col;
+    buf->rows = s->rows;
+    buf->cols = s->cols;
+    buf->file = s->file;
+    buf->modified = s->modified;
+}
+
+/* moves the document & cursor kept in the buffer onto the screen */
+static void buffer_restore(Screen s, Buffer buf) {
+    s->lines = buf->lines;
+    s->last_line = buf->last_line;
+    s->n_lines = buf->n_lines;
+    s->cur_line = buf->cur_line;
+    s->cur_line_num = buf->cur_line_num;
+    s->stored_col = buf->stored_col;
+    s->top_line = buf->top_line;
+    s->top_line_num = buf->top_line_num;
+    s->row = buf->row;
+    s->col = buf->col;
+    s->file = buf->file;
+    s->modified = buf->modified;
+
+    /* the screen owns them while the buffer is shown */
+    buf->lines = NULL;
+    buf->file = NULL;
+
+    /* the screen was resized while the buffer was away */
+    if (buf->cols != s->cols || buf->rows != s->rows)
+        screen_rewrap(s);
+}
+
+/* moves the view of the active pane from the screen into the pane */
+static void pane_store(Screen s, Pane p) {
+    p->cur_line = s->cur_line;
+    p->cur_line_num = s->cur_line_num;
+    p->cursor_col = CURR_LINE->visual_cursor;
+    p->stored_col = s->stored_col;
+    p->top_line = s->top_line;
+    p->top_line_num = s->top_line_num;
+}
+
+/* moves the view kept in the pane onto the screen, placing the cursor on
+   the pane's column of its line */
+static void pane_restore(Screen s, Pane p) {
+    s->cur_line = p->cur_line;
+    s->cur_line_num = p->cur_line_num;
+    s->stored_col = p->stored_col;
+    s->top_line = p->top_line;
+    s->top_line_num = p->top_line_num;
+
+    s->rows = p->rows;
+    s->contents = p->contents;
+    s->line_numbers = p->line_numbers;
+
+    /* rows taken by the lines above the current one */
+    uint row = 0;
+    for (GList* curr = s->top_line ; curr != s->cur_line ; curr = curr->next)
+        row += 1 + ((Line)curr->data)->wraps;
+
+    /* start at the beginning of the line */
     gap_buffer_move_cursor(CURR_LBUF, gap_buffer_distance_to_start(CURR_LBUF));
+    CURR_LINE->visual_cursor = 0;
+    CURR_LINE->wrap = 0;
+    s->col = 0;
+    s->row = row;
+
+    /* go to the column, which may have moved if the line was edited */
+    move_to_column(s, p->cursor_col);
+
+    if (s->row >= s->rows)
+        screen_scroll_to_current_line(s);
 }
 
-/* creates a save confirmation window */
-void screen_save_confirmation_window(Screen s) {
+/* shows the given buffer on the screen, reading its file if it's the first
+   time the buffer is shown */
+void screen_switch_buffer(Screen s, GList* buffer) {
+    if (buffer == s->cur_buffer)
+        return;
+
+    buffer_store(s, CURR_BUFF);
+    s->cur_buffer = buffer;
+
+    if (CURR_BUFF->loaded) {
+        buffer_restore(s, CURR_BUFF);
+    } else {
+        screen_init_document(s);
+        CURR_BUFF->loaded = true;
+
+        if (CURR_BUFF->exists)
+            file_open(s, CURR_BUFF->file_name);
+    }
+
+    /* text appended to the followed file while it wasn't shown */
+    if (buffer == s->buffers && s->follow_pending) {
+        s->follow_pending = false;
+        file_read_appended(s);
+    }
+
+    /* other panes show the new buffer where the active one does */
+    for (GList* curr = s->panes ; curr != NULL ; curr = curr->next) {
+        if (curr != s->cur_pane) {
+            pane_store(s, curr->data);
+            ((Pane)curr->data)->dirty = true;
+        }
+    }
+}
+
+/* if the given buffer has unsaved changes */
+bool screen_buffer_modified(Screen s, GList* buffer) {
+    return (buffer == s->cur_buffer) ? s->modified :
+        ((Buffer)buffer->data)->modified;
+}
+
+/* splits the active pane in two showing the same place, the upper one stays
+   active; returns false if the panes would be too small */
+bool screen_split_pane(Screen s) {
+    uint n_panes = g_list_length(s->panes);
+
+    if (pane_rows(s, n_panes+1, false) < PANE_MIN_ROWS)
+        return false;
+
+    Pane p = pane_new();
+    pane_store(s, p);
+
+    s->panes = g_list_insert_before(s->panes, s->cur_pane->next, p);
+
+    screen_resize(s);
+
+    return true;
+}
+
+/* moves the cursor into the given pane */
+void screen_switch_pane(Screen s, GList* pane) {
+    if (pane == s->cur_pane)
+        return;
+
+    /* the pane's windows keep showing what was last painted on them */
+    pane_store(s, CURR_PANE);
+
+    s->cur_pane = pane;
+    pane_restore(s, CURR_PANE);
+}
+
+/* closes the active pane unless it's the only one, the pane above it or
+   the next one if there is none becomes active */
+void screen_close_pane(Screen s) {
+    if (s->panes->next == NULL)
+        return;
+
+    GList* closed = s->cur_pane;
+    GList* next = (closed->prev) ? closed->prev : closed->next;
+
+    screen_switch_pane(s, next);
+
+    pane_destroy(closed->data);
+    s->panes = g_list_delete_link(s->panes, closed);
+
+    /* the remaining panes take up the space */
+    screen_resize(s);
+}
+
+/* marks the document modified from the first given line to the last one,
+   UINT_MAX for every line after the first, so that panes showing them
+   are painted again */
+void screen_mark_changed(Screen s, uint first, uint last) {
+    s->modified = true;
+
+    if (first < s->changed_first)
+        s->changed_first = first;
+    if (last > s->changed_last)
+        s->changed_last = last;
+}
+
+/* creates a save confirmation window, saving the buffer if asked to,
+   returns false if the question was cancelled */
+bool screen_save_confirmation_window(Screen s) {
+    Backend b = s->backend;
+
     screen_delete_info_bar_bottom(s);
 
-    WINDOW* confirmation = newwin(3, COLS, LINES-3, 0);
+    Canvas confirmation = canvas_new(b, 3, b->cols, b->rows-3, 0);
 
-    wattron(confirmation, A_REVERSE);
-    for (int i = 0 ; i < COLS ; ++i)
-        mvwprintw(confirmation, 0, i, " ");
+    for (uint i = 0 ; i < b->cols ; ++i)
+        canvas_put_str(confirmation, 0, i, " ", ATTR_REVERSE);
 
-    mvwprintw(confirmation, 0, 0, "Save modified buffer?");
-    mvwprintw(confirmation, 1, 0, " Y");
-    mvwprintw(confirmation, 2, 0, " N");
-    mvwprintw(confirmation, 2, 16, "^C");
+    canvas_put_str(confirmation, 0, 0, "Save modified buffer?", ATTR_REVERSE);
+    canvas_put_str(confirmation, 1, 0, " Y", ATTR_REVERSE);
+    canvas_put_str(confirmation, 2, 0, " N", ATTR_REVERSE);
+    canvas_put_str(confirmation, 2, 16, "^C", ATTR_REVERSE);
 
-    wattroff(confirmation, A_REVERSE);
+    canvas_put_str(confirmation, 1, 3, "Yes", ATTR_NONE);
+    canvas_put_str(confirmation, 2, 3, "No", ATTR_NONE);
+    canvas_put_str(confirmation, 2, 19, "Cancel", ATTR_NONE);
 
-    mvwprintw(confirmation, 1, 3, "Yes");
-    mvwprintw(confirmation, 2, 3, "No");
-    mvwprintw(confirmation, 2, 19, "Cancel");
+    canvas_stage(confirmation);
+    backend_update(b);
+    backend_show_cursor(b, false);
 
-    wrefresh(confirmation);
-    curs_set(0);
+    /* wait for the answer however long it takes */
+    backend_timeout(b, -1);
 
     int c;
     while (true) {
-        c = getch();
+        c = backend_read_key(b);
 
         if (c == 'Y' || c == 'y') {
             file_save(s);
@@ -215,22 +1294,31 @@ void screen_save_confirmation_window(Screen s) {
         }
     }
 
-    delwin(confirmation);
+    canvas_delete(confirmation);
 
-    if (c != 3)
-        handle_quit(s);
+    backend_show_cursor(b, true);
 
+    /* bring the bottom bar back & paint the rows the confirmation covered,
+       the line numbers there were skipped as unchanged otherwise */
     screen_create_info_bar_bottom(s);
+    screen_repaint_panes(s);
+
+    return c != 3;
 }
 
 /* removes a line and frees its memory */
 void screen_destroy_line(Screen s) {
+    panes_line_removed(s);
+
     /* free the line buffer's memory */
     line_destroy(s->cur_line->data);
 
     /* pointer to the new current line */
     GList* new_current = s->cur_line->prev;
 
+    if (s->cur_line == s->last_line)
+        s->last_line = new_current;
+
     /* remove the old line from the list */
     s->lines = g_list_remove_link(s->lines, s->cur_line);
 
@@ -246,18 +1334,261 @@ void free_buffer_node(gpointer data) {
     line_destroy(data);
 }
 
-/* destroyes all the lines and then the screen itself */
+/* file slow frames are logged into */
+static const char* frame_log_name(Screen s) {
+    return s->args->frame_log ? s->args->frame_log : FRAME_LOG_FILE;
+}
+
+/* counts times of the finished frame's stages, if it had any keys,
+   handing a report of the frame to the watchdog if it went over the frame
+   budget */
+void screen_finish_frame(Screen s) {
+    struct frame_report* report = NULL;
+
+    /* frames drawn without keys, such as the first one, are not counted */
+    if (s->frame_start != 0) {
+        s->stage_times[STAGE_FRAME] = time_us() - s->frame_start;
+
+        for (int i = 0 ; i < N_STAGES ; ++i)
+            histogram_add(s->timings[i], s->stage_times[i]);
+
+        uint budget = s->args->frame_budget;
+        if (budget > 0 && s->stage_times[STAGE_FRAME] > budget * 1000ull) {
+            report = malloc(sizeof *report);
+            report->time = time(NULL);
+            report->running = false;
+            memcpy(report->stage_times, s->stage_times,
+                   sizeof report->stage_times);
+            report->keys = s->frame_keys;
+            report->key = s->frame_key;
+            report->before = s->frame_before;
+            screen_get_frame_context(s, &report->after);
+        }
+    }
+
+    for (int i = 0 ; i < N_STAGES ; ++i)
+        s->stage_times[i] = 0;
+
+    /* the file is written by the watchdog, not to slow down the next frame */
+    pthread_mutex_lock(&s->frame_lock);
+    s->frame_start = 0;
+    s->frame_keys = 0;
+
+    if (report) {
+        s->frame_reports = g_list_append(s->frame_reports, report);
+        pthread_cond_signal(&s->watchdog_wake);
+    }
+
+    pthread_mutex_unlock(&s->frame_lock);
+}
+
+/* starts the frame with its first key, read at the given time, if it didn't
+   start yet & counts the key in, the watchdog sees all of it or none */
+void screen_frame_key(Screen s, int key, uint64_t time) {
+    pthread_mutex_lock(&s->frame_lock);
+
+    /* the watchdog waits for the frame's deadline from now on */
+    if (s->frame_start == 0) {
+        s->frame_start = time;
+        screen_get_frame_context(s, &s->frame_before);
+        pthread_cond_signal(&s->watchdog_wake);
+    }
+
+    s->frame_keys++;
+    s->frame_key = key;
+
+    pthread_mutex_unlock(&s->frame_lock);
+}
+
+/* fills in the state of the current line & document */
+void screen_get_frame_context(Screen s, struct frame_context* context) {
+    gap_T buff = CURR_LBUF;
+
+    context->line_num = s->cur_line_num;
+    context->n_lines = s->n_lines;
+    context->length = buff->end - buff->gap_end + buff->gap_start;
+    context->wraps = CURR_LINE->wraps;
+    context->gap_start = buff->gap_start;
+    context->gap_size = buff->gap_end - buff->gap_start + 1;
+}
+
+/* writes the state of the current line & document on one line,
+   with the line numbered as in the gutter */
+static void frame_context_print(FILE* file, const char* label,
+                                const struct frame_context* c) {
+    fprintf(file, "  %-7s line %u/%u, %d bytes, %u wraps, gap at %d of %d\n",
+            label, c->line_num + 1, c->n_lines, c->length, c->wraps,
+            c->gap_start, c->gap_size);
+}
+
+/* appends a report of a slow frame to a file, a frame which is still running
+   only with what's known before it changed anything, returns false on
+   failure */
+static bool frame_report_write(const struct frame_report* r, const char* name) {
+    FILE* file = fopen(name, "a");
+    if (!file)
+        return false;
+
+    char date[32];
+    struct tm tm;
+    strftime(date, sizeof date, "%Y-%m-%d %H:%M:%S",
+             localtime_r(&r->time, &tm));
+
+    if (r->running) {
+        fprintf(file, "%s: frame still running after %.1f ms, %u keys, "
+                "last key %d\n", date, r->stage_times[STAGE_FRAME] / 1000.0,
+                r->keys, r->key);
+        frame_context_print(file, "before:", &r->before);
+    } else {
+        fprintf(file, "%s: frame took %.1f ms, %u keys, last key %d\n", date,
+                r->stage_times[STAGE_FRAME] / 1000.0, r->keys, r->key);
+        frame_context_print(file, "before:", &r->before);
+        frame_context_print(file, "after:", &r->after);
+        fprintf(file, "  input %.1f ms, edit %.1f ms, render %.1f ms, "
+                "flush %.1f ms\n",
+                r->stage_times[STAGE_INPUT] / 1000.0,
+                r->stage_times[STAGE_EDIT] / 1000.0,
+                r->stage_times[STAGE_RENDER] / 1000.0,
+                r->stage_times[STAGE_FLUSH] / 1000.0);
+    }
+
+    return fclose(file) == 0;
+}
+
+/* writes the reports handed over by the editor & logs each frame running
+   for FRAME_HANG_BUDGETS frame budgets once, a frame which finishes after
+   that is logged again with its stages as it finishes, the reports are
+   copied under the lock & written without it so the editor never waits
+   for the file */
+static void* frame_watchdog(void* arg) {
+    Screen s = arg;
+    uint64_t hang = FRAME_HANG_BUDGETS * s->args->frame_budget * 1000ull;
+    uint64_t logged = 0;
+
+    pthread_mutex_lock(&s->frame_lock);
+
+    /* reports taken before stopping are still written */
+    while (!s->watchdog_stop || s->frame_reports) {
+        GList* reports = s->frame_reports;
+        struct frame_report hung;
+        bool is_hung = false;
+
+        uint64_t start = s->frame_start;
+        if (!reports && start != 0 && start != logged) {
+            uint64_t deadline = start + hang;
+
+            /* sleep until the frame is due to be logged as hung, waking
+               earlier if it finishes, a report waits or the watchdog stops */
+            if (time_us() < deadline) {
+                struct timespec until;
+                until.tv_sec = deadline / 1000000;
+                until.tv_nsec = deadline % 1000000 * 1000;
+
+                pthread_cond_timedwait(&s->watchdog_wake, &s->frame_lock,
+                                       &until);
+                continue;
+            }
+
+            hung.time = time(NULL);
+            hung.running = true;
+            hung.stage_times[STAGE_FRAME] = time_us() - start;
+            hung.keys = s->frame_keys;
+            hung.key = s->frame_key;
+            hung.before = s->frame_before;
+            is_hung = true;
+            logged = start;
+        } else if (!reports) {
+            /* nothing to do until a frame starts */
+            pthread_cond_wait(&s->watchdog_wake, &s->frame_lock);
+            continue;
+        }
+
+        s->frame_reports = NULL;
+        pthread_mutex_unlock(&s->frame_lock);
+
+        /* nothing can be shown about a failed write on the screen */
+        if (is_hung)
+            frame_report_write(&hung, frame_log_name(s));
+
+        for (GList* curr = reports ; curr != NULL ; curr = curr->next)
+            frame_report_write(curr->data, frame_log_name(s));
+
+        g_list_free_full(reports, free);
+
+        pthread_mutex_lock(&s->frame_lock);
+    }
+
+    pthread_mutex_unlock(&s->frame_lock);
+
+    return NULL;
+}
+
+/* writes histograms of frame timings into a file, returns false on failure */
+bool screen_dump_timings(Screen s, const char* name) {
+    static const char* stage_names[N_STAGES] = {
+        "input (us)", "edit (us)", "render (us)", "flush (us)", "frame (us)",
+    };
+
+    FILE* file = fopen(name, "w");
+    if (!file)
+        return false;
+
+    for (int i = 0 ; i < N_STAGES ; ++i)
+        histogram_dump(s->timings[i], file, stage_names[i]);
+
+    return fclose(file) == 0;
+}
+
+/* destroyes all the lines and then the screen itself,
+   buffers which aren't shown are destroyed along with their files */
 void screen_destroy(Screen s) {
     /* destroy each line */
     g_list_free_full(s->lines, free_buffer_node);
 
+    /* the shown buffer holds no lines, the screen had them */
+    for (GList* curr = s->buffers ; curr != NULL ; curr = curr->next)
+        buffer_destroy(curr->data);
+    g_list_free(s->buffers);
+
+    /* the pool goes once no screen has lines from it, the next one
+       allocates it again */
+    if (line_stats.lines == 0) {
+        pool_destroy(line_pool);
+        line_pool = NULL;
+        line_stats.pooled = 0;
+    }
+
     /* destroy windows */
-    delwin(s->line_numbers);
-    delwin(s->contents);
+    canvas_delete(s->info_bar_top);
+    canvas_delete(s->info_bar_bottom);
+
+    /* contents & line numbers are the active pane's windows */
+    g_list_free_full(s->panes, (GDestroyNotify)pane_destroy);
 
     /* if in debug mode, destroy debug information window */
     if (s->args->debug_mode)
-        delwin(s->debug_info);
+        canvas_delete(s->debug_info);
+
+    free(s->info_bar_top_text);
+    free(s->info_bar_bottom_text);
+
+    if (s->follow_fd >= 0)
+        close(s->follow_fd);
+
+    for (int i = 0 ; i < N_STAGES ; ++i)
+        histogram_destroy(s->timings[i]);
+
+    if (s->args->frame_budget > 0) {
+        pthread_mutex_lock(&s->frame_lock);
+        s->watchdog_stop = true;
+        pthread_cond_signal(&s->watchdog_wake);
+        pthread_mutex_unlock(&s->frame_lock);
+
+        pthread_join(s->watchdog, NULL);
+    }
+
+    pthread_mutex_destroy(&s->frame_lock);
+    pthread_cond_destroy(&s->watchdog_wake);
 
     /* free allocated screen */
     free(s);
@@ -0,0 +1,269 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trace.h"
+#include "histogram.h"
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* one trace event */
+struct trace_event {
+    const char* name; /* name of the span or counter */
+    char phase; /* 'X' for spans, 'C' for counters */
+    uint64_t time; /* start of the span or time of the counter */
+    uint64_t duration; /* length of the span */
+    const char* arg; /* name of the attached number, NULL if none */
+    long value; /* attached number or value of the counter */
+};
+
+/* events of one thread, only its thread adds them & they are written out
+   from the other end with the lock held, by the flushing thread or by its
+   own thread when it's full */
+struct trace_ring {
+    struct trace_event events[TRACE_RING_SIZE]; /* events in order */
+    uint64_t head; /* number of events ever added */
+    uint64_t tail; /* number of events ever written out */
+    int thread; /* number of the thread, starting from 1 */
+    struct trace_ring* next; /* ring of another thread */
+};
+
+bool trace_enabled = false;
+
+static FILE* trace_file = NULL; /* file events are written into */
+static bool trace_first = true; /* if no event was written yet */
+static uint64_t trace_origin = 0; /* time the trace started */
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER; /* held while
+                                           using the file or the ring list */
+static struct trace_ring* trace_rings = NULL; /* rings of all threads */
+static int trace_threads = 0; /* number of threads with a ring */
+
+static pthread_t trace_flusher; /* thread writing the rings out regularly */
+static pthread_cond_t trace_wake = PTHREAD_COND_INITIALIZER; /* wakes the
+                                                    flushing thread to stop */
+static bool trace_stopping = false; /* if the flushing thread should stop */
+static bool trace_exit_set = false; /* if the file is flushed on exit */
+
+/* ring of the calling thread */
+static __thread struct trace_ring* ring = NULL;
+
+/* writes out events of the ring, called with the lock held */
+static void ring_write(struct trace_ring* r) {
+    uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    for (uint64_t i = r->tail ; i < head ; ++i) {
+        struct trace_event* e = &r->events[i % TRACE_RING_SIZE];
+
+        fprintf(trace_file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,"
+                "\"tid\":%d,\"ts\":%llu", trace_first ? "" : ",", e->name,
+                e->phase, r->thread,
+                (unsigned long long)(e->time - trace_origin));
+        trace_first = false;
+
+        if (e->phase == 'X')
+            fprintf(trace_file, ",\"dur\":%llu",
+                    (unsigned long long)e->duration);
+
+        if (e->arg)
+            fprintf(trace_file, ",\"args\":{\"%s\":%ld}", e->arg, e->value);
+
+        fprintf(trace_file, "}");
+    }
+
+    /* the places can be taken again */
+    __atomic_store_n(&r->tail, head, __ATOMIC_RELEASE);
+}
+
+/* writes out events of every thread's ring so far, called with the lock held */
+static void rings_flush() {
+    for (struct trace_ring* r = trace_rings ; r ; r = r->next)
+        ring_write(r);
+
+    fflush(trace_file);
+}
+
+/* writes the rings out every TRACE_FLUSH_INTERVAL, so a killed or hung editor
+   leaves a trace of all but its last moments */
+static void* flush_loop(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&trace_lock);
+
+    while (!trace_stopping) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+
+        until.tv_nsec += TRACE_FLUSH_INTERVAL * 1000000L;
+        until.tv_sec += until.tv_nsec / 1000000000L;
+        until.tv_nsec %= 1000000000L;
+
+        pthread_cond_timedwait(&trace_wake, &trace_lock, &until);
+        rings_flush();
+    }
+
+    pthread_mutex_unlock(&trace_lock);
+
+    return NULL;
+}
+
+/* writes out what's traced so far when the editor exits without stopping */
+static void trace_exit() {
+    pthread_mutex_lock(&trace_lock);
+
+    if (trace_file)
+        rings_flush();
+
+    pthread_mutex_unlock(&trace_lock);
+}
+
+/* adds an event to the calling thread's ring */
+static void ring_push(const struct trace_event* e) {
+    /* the thread's first event, give it a ring */
+    if (!ring) {
+        ring = malloc(sizeof *ring);
+        ring->head = 0;
+        ring->tail = 0;
+
+        pthread_mutex_lock(&trace_lock);
+        ring->thread = ++trace_threads;
+        ring->next = trace_rings;
+        trace_rings = ring;
+        pthread_mutex_unlock(&trace_lock);
+    }
+
+    /* the ring is full, write it out without waiting for the flushing */
+    uint64_t head = ring->head;
+
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) ==
+        TRACE_RING_SIZE) {
+        pthread_mutex_lock(&trace_lock);
+        ring_write(ring);
+        pthread_mutex_unlock(&trace_lock);
+    }
+
+    ring->events[head % TRACE_RING_SIZE] = *e;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*****************************************************************************/
+/*                                  Tracing                                  */
+/*****************************************************************************/
+
+/* starts writing trace events into the file */
+bool trace_start(const char* name) {
+    trace_file = fopen(name, "w");
+    if (!trace_file)
+        return false;
+
+    fprintf(trace_file, "{\"traceEvents\":[");
+
+    trace_first = true;
+    trace_origin = time_us();
+    trace_enabled = true;
+
+    trace_stopping = false;
+    pthread_create(&trace_flusher, NULL, flush_loop, NULL);
+
+    if (!trace_exit_set) {
+        atexit(trace_exit);
+        trace_exit_set = true;
+    }
+
+    return true;
+}
+
+/* writes out events left in every thread's ring & closes the file */
+void trace_stop() {
+    if (!trace_enabled)
+        return;
+
+    trace_enabled = false;
+
+    pthread_mutex_lock(&trace_lock);
+    trace_stopping = true;
+    pthread_cond_signal(&trace_wake);
+    pthread_mutex_unlock(&trace_lock);
+
+    pthread_join(trace_flusher, NULL);
+
+    pthread_mutex_lock(&trace_lock);
+
+    while (trace_rings) {
+        struct trace_ring* r = trace_rings;
+        trace_rings = r->next;
+
+        ring_write(r);
+        free(r);
+    }
+
+    fprintf(trace_file, "\n]}\n");
+    fclose(trace_file);
+    trace_file = NULL;
+
+    pthread_mutex_unlock(&trace_lock);
+
+    /* rings of other threads are gone, they would be of no use anyway */
+    ring = NULL;
+}
+
+/* returns the time a span starts, 0 when not tracing */
+uint64_t trace_begin() {
+    return trace_enabled ? time_us() : 0;
+}
+
+/* records a span from its start until now */
+void trace_end(const char* name, uint64_t start) {
+    trace_end_arg(name, start, NULL, 0);
+}
+
+/* records a span with a number attached to it */
+void trace_end_arg(const char* name, uint64_t start,
+                   const char* arg, long value) {
+    /* tracing started or stopped in the middle of the span */
+    if (!trace_enabled || start == 0)
+        return;
+
+    struct trace_event e = {
+        .name = name, .phase = 'X', .time = start,
+        .duration = time_us() - start, .arg = arg, .value = value
+    };
+
+    ring_push(&e);
+}
+
+/* records the current value of a counter */
+void trace_counter(const char* name, long value) {
+    if (!trace_enabled)
+        return;
+
+    struct trace_event e = {
+        .name = name, .phase = 'C', .time = time_us(),
+        .duration = 0, .arg = "value", .value = value
+    };
+
+    ring_push(&e);
+}
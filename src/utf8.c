@@ -0,0 +1,262 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "utf8.h"
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+/* ranges of codepoints, sorted */
+struct range {
+    uint32_t first;
+    uint32_t last;
+};
+
+/* combining marks & other characters taking no columns */
+static const struct range zero_width[] = {
+    { 0x0300, 0x036f }, { 0x0483, 0x0489 }, { 0x0591, 0x05bd },
+    { 0x05bf, 0x05bf }, { 0x05c1, 0x05c2 }, { 0x05c4, 0x05c5 },
+    { 0x05c7, 0x05c7 }, { 0x0610, 0x061a }, { 0x064b, 0x065f },
+    { 0x0670, 0x0670 }, { 0x06d6, 0x06dc }, { 0x06df, 0x06e4 },
+    { 0x06e7, 0x06e8 }, { 0x06ea, 0x06ed }, { 0x0711, 0x0711 },
+    { 0x0730, 0x074a }, { 0x0900, 0x0902 }, { 0x093a, 0x093a },
+    { 0x093c, 0x093c }, { 0x0941, 0x0948 }, { 0x094d, 0x094d },
+    { 0x0951, 0x0957 }, { 0x0e31, 0x0e31 }, { 0x0e34, 0x0e3a },
+    { 0x0e47, 0x0e4e }, { 0x1ab0, 0x1aff }, { 0x1dc0, 0x1dff },
+    { 0x200b, 0x200f }, { 0x202a, 0x202e }, { 0x2060, 0x2064 },
+    { 0x20d0, 0x20ff }, { 0x302a, 0x302d }, { 0x3099, 0x309a },
+    { 0xfe00, 0xfe0f }, { 0xfe20, 0xfe2f }, { 0xfeff, 0xfeff },
+    { 0x1f3fb, 0x1f3ff }, { 0xe0100, 0xe01ef },
+};
+
+/* east asian wide & fullwidth characters and emoji taking two columns */
+static const struct range wide[] = {
+    { 0x1100, 0x115f }, { 0x231a, 0x231b }, { 0x2329, 0x232a },
+    { 0x23e9, 0x23ec }, { 0x23f0, 0x23f0 }, { 0x23f3, 0x23f3 },
+    { 0x25fd, 0x25fe }, { 0x2614, 0x2615 }, { 0x2648, 0x2653 },
+    { 0x267f, 0x267f }, { 0x2693, 0x2693 }, { 0x26a1, 0x26a1 },
+    { 0x26aa, 0x26ab }, { 0x26bd, 0x26be }, { 0x26c4, 0x26c5 },
+    { 0x26ce, 0x26ce }, { 0x26d4, 0x26d4 }, { 0x26ea, 0x26ea },
+    { 0x26f2, 0x26f3 }, { 0x26f5, 0x26f5 }, { 0x26fa, 0x26fa },
+    { 0x26fd, 0x26fd }, { 0x2705, 0x2705 }, { 0x270a, 0x270b },
+    { 0x2728, 0x2728 }, { 0x274c, 0x274c }, { 0x274e, 0x274e },
+    { 0x2753, 0x2755 }, { 0x2757, 0x2757 }, { 0x2795, 0x2797 },
+    { 0x27b0, 0x27b0 }, { 0x27bf, 0x27bf }, { 0x2b1b, 0x2b1c },
+    { 0x2b50, 0x2b50 }, { 0x2b55, 0x2b55 }, { 0x2e80, 0x303e },
+    { 0x3041, 0x33ff }, { 0x3400, 0x4dbf }, { 0x4e00, 0x9fff },
+    { 0xa000, 0xa4cf }, { 0xa960, 0xa97f }, { 0xac00, 0xd7a3 },
+    { 0xf900, 0xfaff }, { 0xfe10, 0xfe19 }, { 0xfe30, 0xfe6f },
+    { 0xff00, 0xff60 }, { 0xffe0, 0xffe6 }, { 0x16fe0, 0x16fe4 },
+    { 0x17000, 0x18aff }, { 0x1b000, 0x1b2ff }, { 0x1f004, 0x1f004 },
+    { 0x1f0cf, 0x1f0cf }, { 0x1f18e, 0x1f18e }, { 0x1f191, 0x1f19a },
+    { 0x1f200, 0x1f2ff }, { 0x1f300, 0x1f64f }, { 0x1f680, 0x1f6ff },
+    { 0x1f7e0, 0x1f7eb }, { 0x1f90c, 0x1f9ff }, { 0x1fa70, 0x1faff },
+    { 0x20000, 0x2fffd }, { 0x30000, 0x3fffd },
+};
+
+/* if the codepoint is in one of the sorted ranges */
+static bool in_ranges(uint32_t c, const struct range* ranges, int n) {
+    int low = 0, high = n-1;
+
+    if (c < ranges[0].first || c > ranges[n-1].last)
+        return false;
+
+    while (low <= high) {
+        int middle = (low + high) / 2;
+
+        if (c > ranges[middle].last)
+            low = middle+1;
+        else if (c < ranges[middle].first)
+            high = middle-1;
+        else
+            return true;
+    }
+
+    return false;
+}
+
+/* decodes a valid character, returns 0 if the text doesn't begin with one */
+static uint decode_valid(const unsigned char* text, size_t length,
+                         uint32_t* c) {
+    uint n = utf8_sequence_length(text[0]);
+
+    if (n == 0 || n > length)
+        return 0;
+
+    /* bits of the first byte which belong to the codepoint */
+    static const unsigned char lead_mask[] = { 0, 0x7f, 0x1f, 0x0f, 0x07 };
+    uint32_t codepoint = text[0] & lead_mask[n];
+
+    for (uint i = 1 ; i < n ; ++i) {
+        if ((text[i] & 0xc0) != 0x80)
+            return 0;
+
+        codepoint = (codepoint << 6) | (text[i] & 0x3f);
+    }
+
+    /* shortest encodings only, no surrogates or codepoints past unicode */
+    static const uint32_t least[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (codepoint < least[n] || codepoint > 0x10ffff ||
+        (codepoint >= 0xd800 && codepoint <= 0xdfff))
+        return 0;
+
+    *c = codepoint;
+    return n;
+}
+
+/*****************************************************************************/
+/*                                   UTF-8                                   */
+/*****************************************************************************/
+
+/* number of bytes of a character starting with the given byte, 0 if no
+   character starts with it */
+uint utf8_sequence_length(char lead) {
+    unsigned char c = lead;
+
+    if (c < 0x80)
+        return 1;
+    if (c < 0xc2) /* continuation bytes & overlong two byte encodings */
+        return 0;
+    if (c < 0xe0)
+        return 2;
+    if (c < 0xf0)
+        return 3;
+    if (c < 0xf5)
+        return 4;
+
+    return 0;
+}
+
+/* decodes the character at the beginning of the text into the codepoint,
+   returns the number of bytes it took; a byte which doesn't begin a valid
+   character is decoded on its own as UTF8_REPLACEMENT */
+uint utf8_decode(const char* text, size_t length, uint32_t* c) {
+    const unsigned char* bytes = (const unsigned char*)text;
+
+    if (bytes[0] < 0x80) {
+        *c = bytes[0];
+        return 1;
+    }
+
+    uint n = decode_valid(bytes, length, c);
+    if (n > 0)
+        return n;
+
+    *c = UTF8_REPLACEMENT;
+    return 1;
+}
+
+/* encodes the codepoint into the given bytes, returns their number */
+uint utf8_encode(uint32_t c, char* bytes) {
+    if (c < 0x80) {
+        bytes[0] = c;
+        return 1;
+    }
+
+    if (c < 0x800) {
+        bytes[0] = 0xc0 | (c >> 6);
+        bytes[1] = 0x80 | (c & 0x3f);
+        return 2;
+    }
+
+    if (c < 0x10000) {
+        bytes[0] = 0xe0 | (c >> 12);
+        bytes[1] = 0x80 | ((c >> 6) & 0x3f);
+        bytes[2] = 0x80 | (c & 0x3f);
+        return 3;
+    }
+
+    bytes[0] = 0xf0 | (c >> 18);
+    bytes[1] = 0x80 | ((c >> 12) & 0x3f);
+    bytes[2] = 0x80 | ((c >> 6) & 0x3f);
+    bytes[3] = 0x80 | (c & 0x3f);
+    return 4;
+}
+
+/* number of bytes the text begins with which are ASCII, checked many
+   bytes at once */
+size_t utf8_ascii_length(const char* text, size_t length) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    /* the top bit of every byte of a block at once */
+    for ( ; i + 16 <= length ; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(text + i));
+        int high = _mm_movemask_epi8(block);
+
+        if (high)
+            return i + __builtin_ctz(high);
+    }
+#else
+    /* eight bytes at a time, the byte with the top bit is found below */
+    for ( ; i + 8 <= length ; i += 8) {
+        uint64_t block;
+        memcpy(&block, text + i, sizeof block);
+
+        if (block & 0x8080808080808080ull)
+            break;
+    }
+#endif
+
+    while (i < length && !(text[i] & 0x80))
+        ++i;
+
+    return i;
+}
+
+/* number of bytes at the end of the text which begin a character the text
+   is too short for, 0 if the text ends with a whole character */
+uint utf8_incomplete_length(const char* text, size_t length) {
+    /* look for the first byte of the last character */
+    for (uint n = 1 ; n < UTF8_MAX_LENGTH && n <= length ; ++n) {
+        char c = text[length-n];
+
+        if ((c & 0xc0) == 0x80)
+            continue;
+
+        return (utf8_sequence_length(c) > n) ? n : 0;
+    }
+
+    return 0;
+}
+
+/* number of columns the codepoint takes on a terminal, 0 for combining
+   marks and 2 for wide characters */
+uint utf8_width(uint32_t c) {
+    /* latin, which most text is, takes one column */
+    if (c < zero_width[0].first)
+        return 1;
+
+    if (in_ranges(c, zero_width, sizeof zero_width / sizeof zero_width[0]))
+        return 0;
+
+    if (in_ranges(c, wide, sizeof wide / sizeof wide[0]))
+        return 2;
+
+    return 1;
+}
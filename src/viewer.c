@@ -0,0 +1,947 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "viewer.h"
+#include "render.h"
+#include "trace.h"
+#include "utf8.h"
+
+/*****************************************************************************/
+/*                                 Truncation                                */
+/*****************************************************************************/
+
+/* mapping of the viewed file, for the SIGBUS handler */
+static const char* volatile mapped_data = NULL;
+static volatile size_t mapped_size = 0;
+static size_t page_size;
+
+/* touching a page of the mapping past the end of a file truncated since it
+   was mapped raises SIGBUS, the page is replaced with one of zeros so that
+   the viewer carries on until it notices the file is shorter */
+static void viewer_sigbus(int sig, siginfo_t* info, void* context) {
+    (void)context;
+    const char* address = info->si_addr;
+    const char* data = mapped_data;
+
+    if (!data || address < data || address >= data + mapped_size) {
+        /* not the viewer's fault, the access is tried again & ends the
+           program as it would have */
+        signal(sig, SIG_DFL);
+        return;
+    }
+
+    uintptr_t page = (uintptr_t)address & ~(uintptr_t)(page_size-1);
+    mmap((void*)page, page_size, PROT_READ,
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+}
+
+/* lets the handler above know about the mapping, NULL for none */
+static void viewer_guard(const char* data, size_t size) {
+    mapped_data = NULL;
+    mapped_size = size;
+    mapped_data = data;
+
+    if (!data)
+        return;
+
+    page_size = sysconf(_SC_PAGESIZE);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof action);
+    action.sa_sigaction = viewer_sigbus;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGBUS, &action, NULL);
+}
+
+/*****************************************************************************/
+/*                                 Line Index                                */
+/*****************************************************************************/
+
+/* drops mapped pages of a part of the file from the process, they stay in
+   the page cache & are mapped again once touched */
+static void viewer_drop(Viewer v, size_t offset, size_t length) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t start = offset - offset % page;
+
+    madvise((char*)v->data + start, offset + length - start, MADV_DONTNEED);
+}
+
+/* scans the file chunk by chunk, publishing offsets of every
+   VIEW_INDEX_STEP-th line after each chunk */
+static void* viewer_index(void* arg) {
+    Viewer v = arg;
+    uint64_t lines = 0;
+    size_t* found = malloc(sizeof(size_t) * (VIEW_SCAN_CHUNK / VIEW_INDEX_STEP + 1));
+
+    for (size_t start = 0 ; start < v->size ; start += VIEW_SCAN_CHUNK) {
+        uint64_t span = trace_begin();
+        size_t end = (v->size - start > VIEW_SCAN_CHUNK) ?
+            start + VIEW_SCAN_CHUNK : v->size;
+        const char* p = v->data + start;
+        size_t n_found = 0;
+
+        while ((p = memchr(p, '\n', v->data + end - p)) != NULL) {
+            p++;
+
+            /* the newline ending the file doesn't begin a line */
+            if (++lines % VIEW_INDEX_STEP == 0 && p != v->data + v->size)
+                found[n_found++] = p - v->data;
+        }
+
+        pthread_mutex_lock(&v->lock);
+
+        if (v->n_index + n_found > v->index_size) {
+            v->index_size = 2 * (v->n_index + n_found);
+            v->index = realloc(v->index, sizeof(size_t) * v->index_size);
+        }
+
+        memcpy(v->index + v->n_index, found, sizeof(size_t) * n_found);
+        v->n_index += n_found;
+        v->scanned = end;
+        v->scanned_lines = lines;
+        bool stop = v->stop;
+
+        pthread_mutex_unlock(&v->lock);
+
+        viewer_drop(v, start, end - start);
+        trace_end("viewer_index", span);
+
+        if (stop)
+            break;
+    }
+
+    free(found);
+
+    pthread_mutex_lock(&v->lock);
+    v->indexed = v->scanned == v->size;
+    pthread_mutex_unlock(&v->lock);
+
+    return NULL;
+}
+
+/* maps the first size bytes of the file & starts indexing their lines,
+   returns false if they can't be mapped */
+static bool viewer_map(Viewer v, size_t size) {
+    /* an empty file can't be mapped, there's nothing to show anyway */
+    const char* data = NULL;
+    if (size > 0) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, v->fd, 0);
+
+        if (data == MAP_FAILED)
+            return false;
+    }
+
+    v->data = data;
+    v->size = size;
+    viewer_guard(data, size);
+
+    v->index[0] = 0; /* the first line begins the file */
+    v->n_index = 1;
+    v->scanned = 0;
+    v->scanned_lines = 0;
+    v->indexed = false;
+    v->stop = false;
+    v->joined = false;
+
+    pthread_create(&v->indexer, NULL, viewer_index, v);
+
+    return true;
+}
+
+/* stops indexing & unmaps the file */
+static void viewer_unmap(Viewer v) {
+    pthread_mutex_lock(&v->lock);
+    v->stop = true;
+    pthread_mutex_unlock(&v->lock);
+
+    viewer_wait_index(v);
+
+    viewer_guard(NULL, 0);
+    if (v->data)
+        munmap((char*)v->data, v->size);
+}
+
+/* maps the file & starts indexing its lines, NULL if it can't be read */
+Viewer viewer_open(const char* file_name, struct Arguments* args) {
+    int fd = open(file_name, O_RDONLY);
+    struct stat st;
+
+    if (fd == -1)
+        return NULL;
+
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    Viewer v = malloc(sizeof *v);
+
+    v->file_name = strdup(file_name);
+    v->fd = fd;
+
+    pthread_mutex_init(&v->lock, NULL);
+    v->index_size = 64;
+    v->index = malloc(sizeof(size_t) * v->index_size);
+
+    if (!viewer_map(v, st.st_size)) {
+        close(fd);
+        pthread_mutex_destroy(&v->lock);
+        free(v->index);
+        free(v->file_name);
+        free(v);
+        return NULL;
+    }
+
+    v->top = 0;
+    v->top_num = 0;
+    v->shift = 0;
+    v->pattern[0] = '\0';
+    v->key = ERR;
+    v->message = NULL;
+
+    v->backend = NULL;
+    v->info_bar_top = NULL;
+    v->line_numbers = NULL;
+    v->contents = NULL;
+    v->info_bar_bottom = NULL;
+    v->info_bar_top_text = NULL;
+    v->info_bar_bottom_text = NULL;
+    v->gutter_width = 5;
+    v->rows = 0;
+    v->cols = 0;
+    v->args = args;
+
+    return v;
+}
+
+/* waits until the whole file is indexed */
+void viewer_wait_index(Viewer v) {
+    if (!v->joined)
+        pthread_join(v->indexer, NULL);
+
+    v->joined = true;
+}
+
+/* stops indexing, unmaps the file & frees the viewer's memory */
+void viewer_destroy(Viewer v) {
+    viewer_unmap(v);
+
+    canvas_delete(v->info_bar_top);
+    canvas_delete(v->line_numbers);
+    canvas_delete(v->contents);
+    canvas_delete(v->info_bar_bottom);
+    free(v->info_bar_top_text);
+    free(v->info_bar_bottom_text);
+
+    close(v->fd);
+    pthread_mutex_destroy(&v->lock);
+    free(v->index);
+    free(v->file_name);
+    free(v);
+}
+
+/* number of the line beginning at the given offset, VIEW_UNKNOWN if the
+   file isn't indexed up to it yet */
+uint64_t viewer_line_number(Viewer v, size_t offset) {
+    if (v->size == 0)
+        return 0;
+
+    pthread_mutex_lock(&v->lock);
+
+    if (offset > v->scanned) {
+        pthread_mutex_unlock(&v->lock);
+        return VIEW_UNKNOWN;
+    }
+
+    /* the last indexed line beginning at or before the offset */
+    size_t low = 0;
+    size_t high = v->n_index;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+
+        if (v->index[middle] <= offset)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    size_t from = v->index[low];
+    pthread_mutex_unlock(&v->lock);
+
+    /* count the lines after it, fewer than VIEW_INDEX_STEP */
+    uint64_t number = (uint64_t)low * VIEW_INDEX_STEP;
+    const char* p = v->data + from;
+    while ((p = memchr(p, '\n', v->data + offset - p)) != NULL) {
+        number++;
+        p++;
+    }
+
+    return number;
+}
+
+/* number of lines of the file, of those indexed so far until it's done */
+uint64_t viewer_n_lines(Viewer v) {
+    pthread_mutex_lock(&v->lock);
+    uint64_t lines = v->scanned_lines;
+    bool indexed = v->indexed;
+    pthread_mutex_unlock(&v->lock);
+
+    /* the last line doesn't have to end with a newline */
+    if (indexed && (v->size == 0 || v->data[v->size-1] != '\n'))
+        lines++;
+
+    return lines;
+}
+
+/*****************************************************************************/
+/*                                   Lines                                   */
+/*****************************************************************************/
+
+/* offset of the beginning of the line the offset is in */
+static size_t line_start(Viewer v, size_t offset) {
+    if (offset == 0)
+        return 0;
+
+    const char* p = memrchr(v->data, '\n', offset);
+    return (p) ? (size_t)(p - v->data) + 1 : 0;
+}
+
+/* moves the offset onto the next line, returns false at the last line; the
+   newline ending the file doesn't begin another line */
+static bool next_line(Viewer v, size_t* offset) {
+    if (*offset >= v->size)
+        return false;
+
+    const char* p = memchr(v->data + *offset, '\n', v->size - *offset);
+    if (!p || p+1 == v->data + v->size)
+        return false;
+
+    *offset = p+1 - v->data;
+    return true;
+}
+
+/* moves the offset onto the previous line, returns false at the first line */
+static bool prev_line(Viewer v, size_t* offset) {
+    if (*offset == 0)
+        return false;
+
+    *offset = line_start(v, *offset - 1);
+    return true;
+}
+
+/* offset of the top line when the last line is at the bottom */
+static size_t last_top(Viewer v) {
+    size_t end = v->size;
+    if (end > 0 && v->data[end-1] == '\n')
+        end--;
+
+    size_t top = line_start(v, end);
+    uint rows = 1;
+    while (rows < v->rows && prev_line(v, &top))
+        rows++;
+
+    return top;
+}
+
+/*****************************************************************************/
+/*                                    View                                   */
+/*****************************************************************************/
+
+/* scrolls down by the given number of lines, at most until the last line
+   is at the bottom */
+void viewer_scroll_down(Viewer v, uint n) {
+    size_t last = last_top(v);
+
+    for (uint i = 0 ; i < n && v->top < last && next_line(v, &v->top) ; ++i) {
+        if (v->top_num != VIEW_UNKNOWN)
+            v->top_num++;
+    }
+}
+
+/* scrolls up by the given number of lines */
+void viewer_scroll_up(Viewer v, uint n) {
+    for (uint i = 0 ; i < n && prev_line(v, &v->top) ; ++i) {
+        if (v->top_num != VIEW_UNKNOWN)
+            v->top_num--;
+    }
+}
+
+/* shows the beginning of the file */
+void viewer_go_to_start(Viewer v) {
+    v->top = 0;
+    v->top_num = 0;
+}
+
+/* shows the end of the file, the last line at the bottom */
+void viewer_go_to_end(Viewer v) {
+    v->top = last_top(v);
+    v->top_num = viewer_line_number(v, v->top);
+}
+
+/* shows the given line at the top through the line index, returns false if
+   the file isn't indexed up to it yet or it's past the end */
+bool viewer_go_to_line(Viewer v, uint64_t number) {
+    pthread_mutex_lock(&v->lock);
+    size_t k = number / VIEW_INDEX_STEP;
+    bool known = k < v->n_index;
+    size_t offset = (known) ? v->index[k] : 0;
+    pthread_mutex_unlock(&v->lock);
+
+    if (!known)
+        return false;
+
+    /* lines after the indexed one, fewer than VIEW_INDEX_STEP */
+    for (uint64_t i = (uint64_t)k * VIEW_INDEX_STEP ; i < number ; ++i) {
+        if (!next_line(v, &offset))
+            return false;
+    }
+
+    v->top = offset;
+    v->top_num = number;
+
+    return true;
+}
+
+/* maps the file again if it was truncated since it was mapped, which makes
+   pages past its new end read as zeros; returns true if it was */
+bool viewer_check_size(Viewer v) {
+    struct stat st;
+
+    if (fstat(v->fd, &st) == -1 || (size_t)st.st_size >= v->size)
+        return false;
+
+    size_t top = v->top;
+    viewer_unmap(v);
+
+    /* nothing is shown if the rest can't be mapped, as if it was emptied */
+    if (!viewer_map(v, st.st_size))
+        viewer_map(v, 0);
+
+    /* the top line stays if it's still there */
+    v->top = (top < v->size) ? line_start(v, top) : 0;
+    size_t last = last_top(v);
+    if (v->top > last)
+        v->top = last;
+
+    v->top_num = viewer_line_number(v, v->top);
+    v->message = "File was truncated";
+
+    return true;
+}
+
+static void viewer_render_info_bar_bottom(Viewer, const char*);
+
+/* shows how far a search got & checks for a key stopping it, the key is
+   kept to be handled next unless it's one cancelling things anyway */
+static bool viewer_search_stopped(Viewer v, size_t offset) {
+    if (!v->backend)
+        return false;
+
+    char bar[64];
+    snprintf(bar, sizeof bar, "Searching... %d%%",
+             (int)(offset * 100 / v->size));
+    viewer_render_info_bar_bottom(v, bar);
+    canvas_stage(v->info_bar_bottom);
+    backend_update(v->backend);
+
+    backend_timeout(v->backend, 0);
+    int c = backend_read_key(v->backend);
+
+    if (c == ERR)
+        return false;
+
+    /* escape or Ctrl-C */
+    v->key = (c == 27 || c == 3) ? ERR : c;
+    v->message = "Search stopped";
+
+    return true;
+}
+
+/* finds the text from the given offset on, a chunk at a time, dropping
+   the chunks searched through from memory; NULL if it's not found or a
+   key stops the search between chunks */
+static const char* viewer_find(Viewer v, size_t from, const char* text,
+                               size_t length) {
+    for (size_t start = from ; start < v->size ; start += VIEW_SCAN_CHUNK) {
+        if (start != from && viewer_search_stopped(v, start))
+            return NULL;
+
+        /* chunks overlap so that the text can be found across them */
+        size_t end = (v->size - start > VIEW_SCAN_CHUNK + length) ?
+            start + VIEW_SCAN_CHUNK + length-1 : v->size;
+
+        const char* found = memmem(v->data + start, end - start, text, length);
+        if (found)
+            return found;
+
+        viewer_drop(v, start, end - start);
+    }
+
+    return NULL;
+}
+
+/* shows the next line after the top one containing the text at the top,
+   returns false if there is none */
+bool viewer_search(Viewer v, const char* text) {
+    uint64_t span = trace_begin();
+    size_t length = strlen(text);
+
+    if (length == 0 || length > VIEW_PATTERN_MAX)
+        return false;
+
+    if (text != v->pattern)
+        strcpy(v->pattern, text);
+
+    size_t from = v->top;
+    const char* found = (next_line(v, &from)) ?
+        viewer_find(v, from, text, length) : NULL;
+
+    trace_end("viewer_search", span);
+
+    if (!found)
+        return false;
+
+    v->top = line_start(v, found - v->data);
+
+    /* a match near the end is shown with the last line at the bottom */
+    size_t last = last_top(v);
+    if (v->top > last)
+        v->top = last;
+
+    v->top_num = viewer_line_number(v, v->top);
+
+    return true;
+}
+
+/*****************************************************************************/
+/*                                 Rendering                                 */
+/*****************************************************************************/
+
+/* decodes the character at the offset, returns its number of bytes */
+static uint viewer_decode(Viewer v, size_t offset, uint32_t* c) {
+    size_t left = v->size - offset;
+    uint length = utf8_decode(v->data + offset,
+                              (left < UTF8_MAX_LENGTH) ? left : UTF8_MAX_LENGTH, c);
+
+    /* control characters would control the terminal instead */
+    if ((*c < ' ' && *c != '\t') || (*c >= 0x7f && *c < 0xa0))
+        *c = UTF8_REPLACEMENT;
+
+    return length;
+}
+
+/* renders the line beginning at the offset into the row, from the column
+   the lines are scrolled to; offsets keep the offset of each cell's
+   character so that matches of the searched text can be highlighted */
+static void viewer_render_line(Viewer v, uint row, size_t offset, Cell* cells,
+                               size_t* offsets) {
+    int width = v->contents->cols;
+    uint first = v->shift;
+    uint last = v->shift + width;
+    uint col = 0;
+    int n = 0;
+    size_t i = offset;
+
+    while (i < v->size && v->data[i] != '\n' && col < last) {
+        uint32_t c;
+        uint length = viewer_decode(v, i, &c);
+        uint columns = (c == '\t') ? TAB_COLUMNS(col, v->args->tab_width) :
+            utf8_width(c);
+
+        /* combining marks go over the character before them */
+        if (columns == 0) {
+            if (n > 0 && col > first && !cells[n-1].mark)
+                cells[n-1].mark = c;
+
+            i += length;
+            continue;
+        }
+
+        for (uint j = 0 ; j < columns ; ++j) {
+            if (col+j < first || col+j >= last)
+                continue;
+
+            Cell cell = { ' ', ATTR_NONE, 0 };
+
+            if (c == '\t') {
+                if (v->args->debug_mode)
+                    cell = (Cell){ (j+2 == columns) ? '>' :
+                                   (j == 0 || j+1 == columns) ? ' ' : '-',
+                                   ATTR_GREEN, 0 };
+            } else if (columns == 2 && col+1 == last) {
+                /* a wide character split by the window's edge */
+                cell = (Cell){ '>', ATTR_BLUE, 0 };
+            } else if (columns == 1 || (j == 0 && col >= first)) {
+                cell.ch = c;
+            } else if (j == 1 && col >= first) {
+                cell.ch = CELL_WIDE;
+            }
+
+            offsets[n] = i;
+            cells[n++] = cell;
+        }
+
+        col += columns;
+        i += length;
+    }
+
+    /* highlight matches of the searched text among the rendered bytes */
+    size_t length = strlen(v->pattern);
+    if (length > 0 && n > 0) {
+        size_t end = (v->size - i > length) ? i + length-1 : v->size;
+        const char* p = v->data + offset;
+
+        while ((p = memmem(p, v->data + end - p, v->pattern, length)) != NULL) {
+            size_t match = p - v->data;
+
+            for (int j = 0 ; j < n ; ++j) {
+                if (offsets[j] >= match && offsets[j] < match + length)
+                    cells[j].attr = ATTR_REVERSE;
+            }
+
+            p += length;
+        }
+    }
+
+    canvas_put(v->contents, row, 0, cells, n);
+}
+
+/* renders the lines from the top one down */
+static void viewer_render_contents(Viewer v) {
+    uint64_t span = trace_begin();
+    int width = v->contents->cols;
+    Cell* cells = malloc(sizeof(Cell) * width);
+    size_t* offsets = malloc(sizeof(size_t) * width);
+
+    canvas_erase(v->contents);
+
+    size_t offset = v->top;
+    for (uint row = 0 ; row < v->rows ; ++row) {
+        viewer_render_line(v, row, offset, cells, offsets);
+
+        if (!next_line(v, &offset))
+            break;
+    }
+
+    free(cells);
+    free(offsets);
+
+    trace_end("viewer_render_contents", span);
+}
+
+/* renders numbers of the shown lines, left blank while they aren't known
+   and tildes past the last line */
+static void viewer_render_line_numbers(Viewer v) {
+    int digits = v->gutter_width-1;
+    char text[32];
+
+    canvas_erase(v->line_numbers);
+
+    size_t offset = v->top;
+    bool more = true;
+    for (uint row = 0 ; row < v->rows ; ++row) {
+        if (!more) {
+            snprintf(text, sizeof text, "%*s~ ", digits-1, "");
+            canvas_put_str(v->line_numbers, row, 0, text, ATTR_NONE);
+        } else if (v->top_num != VIEW_UNKNOWN) {
+            snprintf(text, sizeof text, "%*" PRIu64 " ", digits,
+                     v->top_num + row + 1);
+            canvas_put_str(v->line_numbers, row, 0, text, ATTR_YELLOW);
+        }
+
+        more = next_line(v, &offset);
+    }
+}
+
+/* renders the top bar with the file name */
+static void viewer_render_info_bar_top(Viewer v) {
+    int width = v->backend->cols;
+    char* bar = malloc(width+1);
+    memset(bar, ' ', width);
+    bar[width] = '\0';
+
+    bar_put(bar, width, 2, "text-editor 0.1");
+
+    int x = width/2-strlen(v->file_name)/2-3;
+    bar_put(bar, width, x, "File: ");
+    bar_put(bar, width, x+6, v->file_name);
+
+    bar_put(bar, width, width-10, "Read-only");
+
+    bar_draw(v->info_bar_top, &v->info_bar_top_text, bar);
+}
+
+/* renders the bottom bar with the message & the position in the file,
+   lines are counted as they are indexed */
+static void viewer_render_info_bar_bottom(Viewer v, const char* message) {
+    int width = v->backend->cols;
+    char* bar = malloc(width+1);
+    memset(bar, ' ', width);
+    bar[width] = '\0';
+
+    if (message)
+        bar_put(bar, width, 1, message);
+
+    pthread_mutex_lock(&v->lock);
+    bool indexed = v->indexed;
+    pthread_mutex_unlock(&v->lock);
+
+    char line[24];
+    if (v->top_num != VIEW_UNKNOWN)
+        snprintf(line, sizeof line, "%" PRIu64, v->top_num+1);
+    else
+        snprintf(line, sizeof line, "?");
+
+    char position[80];
+    snprintf(position, sizeof position, "%s/%" PRIu64 "%s %3d%%", line,
+             viewer_n_lines(v), (indexed) ? "" : "+",
+             (v->size > 0) ? (int)(v->top * 100 / v->size) : 100);
+    bar_put(bar, width, width-1-strlen(position), position);
+
+    bar_draw(v->info_bar_bottom, &v->info_bar_bottom_text, bar);
+}
+
+/* widens line numbers to fit the number of the last shown line */
+static void viewer_fit_line_numbers(Viewer v) {
+    if (v->top_num == VIEW_UNKNOWN)
+        return;
+
+    uint digits = 4; /* at least 4 digits, like 9999 */
+    for (uint64_t n = v->top_num + v->rows ; n > 9999 ; n /= 10)
+        digits++;
+
+    if (v->gutter_width != digits+1) {
+        v->gutter_width = digits+1;
+        viewer_resize(v);
+    }
+}
+
+/* lays out the windows according to the terminal size */
+void viewer_resize(Viewer v) {
+    Backend b = v->backend;
+
+    canvas_delete(v->info_bar_top);
+    canvas_delete(v->line_numbers);
+    canvas_delete(v->contents);
+    canvas_delete(v->info_bar_bottom);
+
+    v->rows = b->rows - 2;
+    v->cols = b->cols - v->gutter_width;
+
+    v->info_bar_top = canvas_new(b, 1, b->cols, 0, 0);
+    v->line_numbers = canvas_new(b, v->rows, v->gutter_width, 1, 0);
+    v->contents = canvas_new(b, v->rows, v->cols, 1, v->gutter_width);
+    v->info_bar_bottom = canvas_new(b, 1, b->cols, b->rows-1, 0);
+
+    /* painted bars no longer match the new windows */
+    free(v->info_bar_top_text);
+    v->info_bar_top_text = NULL;
+    free(v->info_bar_bottom_text);
+    v->info_bar_bottom_text = NULL;
+}
+
+/* starts showing the viewer on the backend */
+void viewer_init_backend(Viewer v, Backend b) {
+    v->backend = b;
+    viewer_resize(v);
+
+    /* there's no cursor to show */
+    backend_show_cursor(b, false);
+}
+
+/* renders every window and updates the terminal once */
+void viewer_render(Viewer v) {
+    /* the top line may have been indexed since it was scrolled to */
+    if (v->top_num == VIEW_UNKNOWN)
+        v->top_num = viewer_line_number(v, v->top);
+
+    viewer_fit_line_numbers(v);
+
+    viewer_render_info_bar_top(v);
+    viewer_render_info_bar_bottom(v, v->message);
+    viewer_render_line_numbers(v);
+    viewer_render_contents(v);
+
+    canvas_stage(v->info_bar_top);
+    canvas_stage(v->info_bar_bottom);
+    canvas_stage(v->line_numbers);
+    canvas_stage(v->contents);
+
+    uint64_t span = trace_begin();
+    backend_update(v->backend);
+    trace_end("backend_update", span);
+}
+
+/*****************************************************************************/
+/*                                   Input                                   */
+/*****************************************************************************/
+
+/* reads text typed after the label on the bottom bar into the given
+   buffer, returns false if it was cancelled */
+static bool viewer_prompt(Viewer v, const char* label, char* text) {
+    char bar[VIEW_PATTERN_MAX + 64];
+    uint length = 0;
+    text[0] = '\0';
+
+    backend_timeout(v->backend, -1);
+
+    while (true) {
+        snprintf(bar, sizeof bar, "%s%s", label, text);
+        viewer_render_info_bar_bottom(v, bar);
+        canvas_stage(v->info_bar_bottom);
+        backend_update(v->backend);
+
+        int c = backend_read_key(v->backend);
+
+        if (c == '\n')
+            return true;
+
+        /* escape or Ctrl-C */
+        if (c == 27 || c == 3)
+            return false;
+
+        if ((c == 127 || c == KEY_BACKSPACE) && length > 0) {
+            /* remove the whole last character */
+            while (length > 1 && (text[length-1] & 0xc0) == 0x80)
+                length--;
+            text[--length] = '\0';
+        } else if (c >= ' ' && c < 256 && c != 127 &&
+                   length < VIEW_PATTERN_MAX) {
+            /* bytes of UTF-8 characters are typed one by one */
+            text[length++] = c;
+            text[length] = '\0';
+        }
+    }
+}
+
+/* handles a key, returns false if it quits the viewer */
+bool viewer_handle_key(Viewer v, int c) {
+    char text[VIEW_PATTERN_MAX+1];
+    v->message = NULL;
+
+    switch (c) {
+
+    case KEY_UP:
+        viewer_scroll_up(v, 1);
+        break;
+
+    case KEY_DOWN:
+    case '\n':
+        viewer_scroll_down(v, 1);
+        break;
+
+    case KEY_PPAGE:
+        viewer_scroll_up(v, v->rows);
+        break;
+
+    case KEY_NPAGE:
+    case ' ':
+        viewer_scroll_down(v, v->rows);
+        break;
+
+    case KEY_LEFT:
+        v->shift = (v->shift > v->cols/2) ? v->shift - v->cols/2 : 0;
+        break;
+
+    case KEY_RIGHT:
+        v->shift += v->cols/2;
+        break;
+
+    case KEY_HOME:
+    case KEY_CTRL_HOME:
+        viewer_go_to_start(v);
+        break;
+
+    case KEY_END:
+    case KEY_CTRL_END:
+        viewer_go_to_end(v);
+        break;
+
+    case '/':
+        if (viewer_prompt(v, "Search: ", text) && !viewer_search(v, text) &&
+            !v->message)
+            v->message = "Not found";
+        break;
+
+    case 'n':
+        if (v->pattern[0] == '\0')
+            v->message = "Nothing searched for yet";
+        else if (!viewer_search(v, v->pattern) && !v->message)
+            v->message = "Not found";
+        break;
+
+    case ':':
+        if (!viewer_prompt(v, "Line: ", text))
+            break;
+
+        if (atoll(text) < 1 || !viewer_go_to_line(v, atoll(text)-1))
+            v->message = "Line not indexed yet or past the end";
+        break;
+
+    case KEY_RESIZE:
+        viewer_resize(v);
+        break;
+
+        /* ascii CAN (cancel) control character, Ctrl-X, as in the editor */
+    case 24:
+    case 'q':
+        return false;
+    }
+
+    return true;
+}
+
+/* renders & handles keys until the viewer is quit, showing how far the
+   file is indexed while it is */
+void viewer_loop(Viewer v) {
+    while (true) {
+        viewer_check_size(v);
+        viewer_render(v);
+
+        /* a key which stopped a search is handled first */
+        int c = v->key;
+        v->key = ERR;
+
+        if (c == ERR) {
+            pthread_mutex_lock(&v->lock);
+            bool indexed = v->indexed;
+            pthread_mutex_unlock(&v->lock);
+
+            backend_timeout(v->backend, (indexed) ? -1 : VIEW_INDEX_REFRESH);
+            c = backend_read_key(v->backend);
+        }
+
+        if (c != ERR && !viewer_handle_key(v, c))
+            return;
+    }
+}
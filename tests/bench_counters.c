@@ -0,0 +1,184 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "bench_counters.h"
+
+/*****************************************************************************/
+/*                                 Internals                                 */
+/*****************************************************************************/
+
+const char* counter_names[N_COUNTERS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses",
+};
+
+#ifdef __linux__
+
+/* type & config of every event for perf_event_open */
+static const struct {
+    unsigned type;
+    unsigned long long config;
+} events[N_COUNTERS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+/* opens a counter of the calling thread in user space, -1 on failure */
+static int event_open(int event) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+
+    attr.size = sizeof attr;
+    attr.type = events[event].type;
+    attr.config = events[event].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+        PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* reads a counter, scaled up if it had to share the hardware */
+static double event_read(int fd) {
+    unsigned long long values[3]; /* count, time enabled, time running */
+
+    if (read(fd, values, sizeof values) != sizeof values || values[2] == 0)
+        return 0;
+
+    return (double)values[0] * values[1] / values[2];
+}
+
+#endif
+
+/*****************************************************************************/
+/*                                  Counters                                 */
+/*****************************************************************************/
+
+/* opens whichever counters the machine lets us read */
+Counters counters_open() {
+#ifdef __linux__
+    Counters c = malloc(sizeof *c);
+    int opened = 0, error = 0;
+
+    for (int i = 0 ; i < N_COUNTERS ; ++i) {
+        c->fds[i] = event_open(i);
+        c->start[i] = 0;
+
+        if (c->fds[i] >= 0)
+            opened++;
+        else if (!error)
+            error = errno;
+    }
+
+    if (opened > 0)
+        return c;
+
+    fprintf(stderr, "hardware counters unavailable: %s%s\n", strerror(error),
+            (error == EACCES || error == EPERM) ?
+            " (see /proc/sys/kernel/perf_event_paranoid)" : "");
+    free(c);
+#else
+    fprintf(stderr, "hardware counters unavailable on this system\n");
+#endif
+
+    return NULL;
+}
+
+/* marks the beginning of a measured region */
+void counters_start(Counters c) {
+    if (!c)
+        return;
+
+#ifdef __linux__
+    for (int i = 0 ; i < N_COUNTERS ; ++i) {
+        if (c->fds[i] >= 0)
+            c->start[i] = event_read(c->fds[i]);
+    }
+#endif
+}
+
+/* adds events counted since counters_start to the totals */
+void counters_stop(Counters c, double totals[N_COUNTERS]) {
+    if (!c)
+        return;
+
+#ifdef __linux__
+    for (int i = 0 ; i < N_COUNTERS ; ++i) {
+        if (c->fds[i] >= 0)
+            totals[i] += event_read(c->fds[i]) - c->start[i];
+    }
+#else
+    (void)totals;
+#endif
+}
+
+/* if the event is being counted */
+bool counters_available(Counters c, enum counter event) {
+    return c && c->fds[event] >= 0;
+}
+
+/* writes the totals divided by the number of operations as table columns */
+void counters_print(Counters c, FILE* file, const double totals[N_COUNTERS],
+                    double ops) {
+    for (int i = 0 ; i < N_COUNTERS ; ++i) {
+        if (counters_available(c, i))
+            fprintf(file, " %14.1f", totals[i] / ops);
+        else
+            fprintf(file, " %14s", "-");
+    }
+}
+
+/* writes the header of the table columns */
+void counters_print_header(FILE* file) {
+    for (int i = 0 ; i < N_COUNTERS ; ++i)
+        fprintf(file, " %14s", counter_names[i]);
+}
+
+/* closes the counters, freeing their memory */
+void counters_close(Counters c) {
+    if (!c)
+        return;
+
+    for (int i = 0 ; i < N_COUNTERS ; ++i) {
+        if (c->fds[i] >= 0)
+            close(c->fds[i]);
+    }
+
+    free(c);
+}
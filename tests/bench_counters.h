@@ -0,0 +1,76 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#ifndef TEXT_EDITOR_BENCH_COUNTERS_H
+#define TEXT_EDITOR_BENCH_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*****************************************************************************/
+/*                                  Counters                                 */
+/*****************************************************************************/
+
+/* hardware events counted around measured regions */
+enum counter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    N_COUNTERS
+};
+
+/* short names of the events, used as column names */
+extern const char* counter_names[N_COUNTERS];
+
+/* struct representing the counters of the calling thread */
+typedef struct _counters* Counters;
+struct _counters {
+    int fds[N_COUNTERS]; /* file descriptors of the events, -1 if missing */
+    double start[N_COUNTERS]; /* counts when the measured region started */
+};
+
+/* opens whichever counters the machine lets us read; returns NULL after
+   saying why on stderr if there are none, e.g. in a container */
+Counters counters_open();
+
+/* marks the beginning of a measured region, does nothing given NULL */
+void counters_start(Counters);
+
+/* adds events counted since counters_start to the totals,
+   does nothing given NULL */
+void counters_stop(Counters, double totals[N_COUNTERS]);
+
+/* if the event is being counted */
+bool counters_available(Counters, enum counter);
+
+/* writes the totals divided by the number of operations as table columns,
+   with a dash for missing events */
+void counters_print(Counters, FILE*, const double totals[N_COUNTERS],
+                    double ops);
+
+/* writes the header of the table columns */
+void counters_print_header(FILE*);
+
+/* closes the counters, freeing their memory; does nothing given NULL */
+void counters_close(Counters);
+
+#endif
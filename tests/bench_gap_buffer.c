@@ -0,0 +1,423 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib/gap_buffer.h"
+#include "bench_counters.h"
+
+/*****************************************************************************/
+/*                                  Settings                                 */
+/*****************************************************************************/
+
+/* buffer sizes measured, from 10 B to 100 MB */
+static const long sizes[] = {
+    10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+};
+
+/* distances the gap is moved by */
+static const long distances[] = { 1, 64, 4096, 262144, 16777216 };
+
+/* default milliseconds spent measuring each operation at each size */
+#define BENCH_BUDGET 50
+
+/* most operations done on a single buffer before building a fresh one */
+#define MAX_OPS_PER_RUN (1L << 20)
+
+/* most bytes moved on a single buffer before building a fresh one */
+#define MAX_BYTES_PER_RUN (64L << 20)
+
+/*****************************************************************************/
+/*                                  Helpers                                  */
+/*****************************************************************************/
+
+/* result of measuring an operation */
+struct result {
+    const char* op; /* name of the operation */
+    long size; /* size of the buffer the operation is done on */
+    long distance; /* distance the gap is moved by, 0 if not applicable */
+    long ops; /* number of operations done */
+    double ns; /* nanoseconds they took */
+    double bytes; /* bytes moved around within the buffer by memmove */
+    double counts[N_COUNTERS]; /* hardware events counted meanwhile */
+};
+
+/* current monotonic time in nanoseconds */
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* hardware counters, NULL unless asked for & available */
+static Counters counters = NULL;
+
+/* text the buffers are filled with */
+static char* text;
+
+/* creates a buffer holding size characters with the cursor and the gap at
+   the given position */
+static gap_T buffer_create(long size, long position) {
+    gap_T g = gap_buffer_new();
+
+    gap_buffer_insert_str(g, text, size);
+    gap_buffer_move_cursor(g, position - size);
+    gap_buffer_move_gap(g);
+
+    return g;
+}
+
+/* number of operations done on one buffer, fewer on small buffers so that
+   the operations do not change their size much */
+static long ops_per_run(long size) {
+    long ops = size / 8;
+
+    if (ops < 1)
+        ops = 1;
+    if (ops > MAX_OPS_PER_RUN)
+        ops = MAX_OPS_PER_RUN;
+
+    return ops;
+}
+
+/* lowers the number of operations done on one buffer so that they move at
+   most MAX_BYTES_PER_RUN bytes, so that large buffers fit in the budget */
+static long limit_ops(long ops, double bytes_per_op) {
+    if (bytes_per_op * ops > MAX_BYTES_PER_RUN)
+        ops = MAX_BYTES_PER_RUN / bytes_per_op;
+
+    return (ops < 1) ? 1 : ops;
+}
+
+/* number of times the buffer grows while inserting the given number of
+   characters into a gap of the given size */
+static long grows(long inserted, long room) {
+    if (inserted <= room)
+        return 0;
+
+    return (inserted - room + GROW_SIZE-1) / GROW_SIZE;
+}
+
+/*****************************************************************************/
+/*                                 Benchmarks                                */
+/*****************************************************************************/
+
+/* inserting characters one by one in the middle of the buffer */
+static void bench_insert(struct result* r, double budget) {
+    long ops = ops_per_run(r->size);
+
+    while (r->ns < budget) {
+        gap_T g = buffer_create(r->size, r->size/2);
+        long room = g->gap_end - g->gap_start;
+        long tail = g->end - g->gap_end;
+        ops = limit_ops(ops, (double)tail / GROW_SIZE);
+
+        counters_start(counters);
+        double start = now_ns();
+        for (long i = 0 ; i < ops ; ++i)
+            gap_buffer_insert(g, 'x');
+        r->ns += now_ns() - start;
+        counters_stop(counters, r->counts);
+
+        /* every time the gap fills up, the text after it is moved */
+        r->bytes += grows(ops, room) * tail;
+        r->ops += ops;
+
+        gap_buffer_destroy(g);
+    }
+}
+
+/* deleting characters one by one in the middle of the buffer */
+static void bench_delete(struct result* r, double budget) {
+    long ops = ops_per_run(r->size);
+    if (ops > r->size/2)
+        ops = r->size/2;
+
+    while (r->ns < budget) {
+        gap_T g = buffer_create(r->size, r->size/2);
+
+        counters_start(counters);
+        double start = now_ns();
+        for (long i = 0 ; i < ops ; ++i)
+            gap_buffer_delete(g);
+        r->ns += now_ns() - start;
+        counters_stop(counters, r->counts);
+
+        r->ops += ops;
+
+        gap_buffer_destroy(g);
+    }
+}
+
+/* overwriting characters one by one from the beginning of the buffer */
+static void bench_replace(struct result* r, double budget) {
+    long ops = ops_per_run(r->size);
+    if (ops > r->size/2)
+        ops = r->size/2;
+
+    while (r->ns < budget) {
+        gap_T g = buffer_create(r->size, r->size/2);
+        gap_buffer_move_cursor(g, -r->size/2);
+
+        counters_start(counters);
+        double start = now_ns();
+        for (long i = 0 ; i < ops ; ++i)
+            gap_buffer_replace(g, 'x');
+        r->ns += now_ns() - start;
+        counters_stop(counters, r->counts);
+
+        r->ops += ops;
+
+        gap_buffer_destroy(g);
+    }
+}
+
+/* moving the gap back and forth by the given distance */
+static void bench_move_gap(struct result* r, double budget) {
+    long distance = r->distance;
+    long ops = limit_ops(MAX_OPS_PER_RUN, distance);
+
+    while (r->ns < budget) {
+        gap_T g = buffer_create(r->size, (r->size - distance) / 2);
+
+        counters_start(counters);
+        double start = now_ns();
+        for (long i = 0 ; i < ops ; ++i) {
+            gap_buffer_move_cursor(g, (i % 2 == 0) ? distance : -distance);
+            gap_buffer_move_gap(g);
+        }
+        r->ns += now_ns() - start;
+        counters_stop(counters, r->counts);
+
+        r->bytes += (double)ops * distance;
+        r->ops += ops;
+
+        gap_buffer_destroy(g);
+    }
+}
+
+/* growing the buffer with the gap in the middle */
+static void bench_resize(struct result* r, double budget) {
+    long ops = ops_per_run(r->size);
+
+    while (r->ns < budget) {
+        gap_T g = buffer_create(r->size, r->size/2);
+        long tail = g->end - g->gap_end;
+        ops = limit_ops(ops, tail);
+
+        counters_start(counters);
+        double start = now_ns();
+        for (long i = 0 ; i < ops ; ++i)
+            gap_buffer_resize_buffer(g);
+        r->ns += now_ns() - start;
+        counters_stop(counters, r->counts);
+
+        r->bytes += (double)ops * tail;
+        r->ops += ops;
+
+        gap_buffer_destroy(g);
+    }
+}
+
+/* inserting a whole string of the given size into an empty buffer */
+static void bench_put_str(struct result* r, double budget) {
+    /* put_str takes a null-terminated string */
+    char* str = malloc(r->size + 1);
+    memcpy(str, text, r->size);
+    str[r->size] = '\0';
+
+    while (r->ns < budget) {
+        gap_T g = gap_buffer_new();
+
+        counters_start(counters);
+        double start = now_ns();
+        gap_buffer_put_str(g, str);
+        r->ns += now_ns() - start;
+        counters_stop(counters, r->counts);
+
+        /* nothing follows the gap, growing moves nothing */
+        r->ops++;
+
+        gap_buffer_destroy(g);
+    }
+
+    free(str);
+}
+
+/*****************************************************************************/
+/*                                   Output                                  */
+/*****************************************************************************/
+
+enum format { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON };
+
+static void print_header(enum format format) {
+    if (format == FORMAT_CSV) {
+        printf("op,size,distance,ops,ns_per_op,bytes_moved_per_op");
+
+        for (int i = 0 ; counters && i < N_COUNTERS ; ++i)
+            printf(",%s_per_op", counter_names[i]);
+        printf("\n");
+    } else if (format == FORMAT_JSON) {
+        printf("[\n");
+    } else {
+        printf("%-10s %12s %10s %10s %14s %16s", "op", "size",
+               "distance", "ops", "ns/op", "bytes moved/op");
+
+        if (counters)
+            counters_print_header(stdout);
+        printf("\n");
+    }
+}
+
+static void print_result(enum format format, struct result* r, bool first) {
+    double ns = r->ns / r->ops;
+    double bytes = r->bytes / r->ops;
+
+    if (format == FORMAT_CSV) {
+        printf("%s,%ld,%ld,%ld,%.2f,%.0f", r->op, r->size, r->distance,
+               r->ops, ns, bytes);
+
+        /* missing events are left empty */
+        for (int i = 0 ; counters && i < N_COUNTERS ; ++i) {
+            if (counters_available(counters, i))
+                printf(",%.2f", r->counts[i] / r->ops);
+            else
+                printf(",");
+        }
+        printf("\n");
+    } else if (format == FORMAT_JSON) {
+        printf("%s  {\"op\": \"%s\", \"size\": %ld, \"distance\": %ld, "
+               "\"ops\": %ld, \"ns_per_op\": %.2f, \"bytes_moved_per_op\": %.0f",
+               first ? "" : ",\n", r->op, r->size, r->distance, r->ops,
+               ns, bytes);
+
+        /* missing events are null */
+        for (int i = 0 ; counters && i < N_COUNTERS ; ++i) {
+            if (counters_available(counters, i))
+                printf(", \"%s_per_op\": %.2f", counter_names[i],
+                       r->counts[i] / r->ops);
+            else
+                printf(", \"%s_per_op\": null", counter_names[i]);
+        }
+        printf("}");
+    } else {
+        printf("%-10s %12ld %10ld %10ld %14.2f %16.0f", r->op, r->size,
+               r->distance, r->ops, ns, bytes);
+
+        if (counters)
+            counters_print(counters, stdout, r->counts, r->ops);
+        printf("\n");
+    }
+
+    fflush(stdout);
+}
+
+static void print_footer(enum format format) {
+    if (format == FORMAT_JSON)
+        printf("\n]\n");
+}
+
+/*****************************************************************************/
+/*                                 Benchmark                                 */
+/*****************************************************************************/
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [--csv | --json] [--max-size BYTES] "
+            "[--budget MS] [--counters]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    enum format format = FORMAT_TABLE;
+    long max_size = sizes[sizeof sizes / sizeof sizes[0] - 1];
+    double budget = BENCH_BUDGET;
+
+    for (int i = 1 ; i < argc ; ++i) {
+        if (strcmp(argv[i], "--csv") == 0)
+            format = FORMAT_CSV;
+        else if (strcmp(argv[i], "--json") == 0)
+            format = FORMAT_JSON;
+        else if (strcmp(argv[i], "--max-size") == 0 && i+1 < argc)
+            max_size = atol(argv[++i]);
+        else if (strcmp(argv[i], "--budget") == 0 && i+1 < argc)
+            budget = atof(argv[++i]);
+        else if (strcmp(argv[i], "--counters") == 0)
+            counters = counters_open();
+        else
+            usage(argv[0]);
+    }
+
+    budget *= 1e6; /* in nanoseconds */
+
+    /* printable text to fill the buffers with */
+    text = malloc(max_size);
+    for (long i = 0 ; i < max_size ; ++i)
+        text[i] = 'a' + i % 26;
+
+    static const struct {
+        const char* name;
+        void (*run)(struct result*, double);
+    } benches[] = {
+        { "insert", bench_insert },
+        { "delete", bench_delete },
+        { "replace", bench_replace },
+        { "move_gap", bench_move_gap },
+        { "resize", bench_resize },
+        { "put_str", bench_put_str },
+    };
+
+    print_header(format);
+    bool first = true;
+
+    for (size_t i = 0 ; i < sizeof sizes / sizeof sizes[0] ; ++i) {
+        if (sizes[i] > max_size)
+            break;
+
+        for (size_t j = 0 ; j < sizeof benches / sizeof benches[0] ; ++j) {
+            bool moves = benches[j].run == bench_move_gap;
+            size_t n = moves ? sizeof distances / sizeof distances[0] : 1;
+
+            for (size_t k = 0 ; k < n ; ++k) {
+                /* the gap can only move as far as the buffer reaches */
+                if (moves && distances[k] > sizes[i])
+                    break;
+
+                struct result r = { benches[j].name, sizes[i],
+                                    moves ? distances[k] : 0, 0, 0, 0, {0} };
+
+                benches[j].run(&r, budget);
+                print_result(format, &r, first);
+                first = false;
+            }
+        }
+    }
+
+    print_footer(format);
+    free(text);
+    counters_close(counters);
+
+    return 0;
+}
@@ -0,0 +1,248 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ncurses.h>
+
+#include "lib/gap_buffer.h"
+#include "screen.h"
+#include "input.h"
+#include "render.h"
+#include "bench_counters.h"
+
+/*****************************************************************************/
+/*                                  Settings                                 */
+/*****************************************************************************/
+
+/* size of the contents window being rendered */
+#define BENCH_ROWS 100
+#define BENCH_COLS 300
+
+/* default number of rendered frames per measurement */
+#define BENCH_FRAMES 200
+
+/*****************************************************************************/
+/*                                  Helpers                                  */
+/*****************************************************************************/
+
+/* current monotonic time in seconds */
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* window the previous renderer prints into */
+static WINDOW* legacy_contents;
+
+/* previous renderer, printing every character with wprintw */
+static void legacy_render_line(gpointer data, gpointer screen) {
+    (void)screen;
+    gap_T buff = ((Line)data)->buff;
+
+    for (int i = 0 ; i <= buff->end ; ++i) {
+        if ((i >= buff->gap_start && i <= buff->gap_end) || !buff->buffer[i])
+            continue;
+
+        if (buff->buffer[i] == '\t')
+            wprintw(legacy_contents, "    ");
+        else
+            wprintw(legacy_contents, "%c", buff->buffer[i]);
+    }
+}
+
+/* renders the contents window the way the previous renderer did */
+static void legacy_render_contents(Screen s) {
+    werase(legacy_contents);
+
+    uint cnt = 0;
+    for (GList* curr = s->top_line ; curr != NULL ; curr = curr->next) {
+        legacy_render_line(curr->data, s);
+        cnt += 1 + ((Line)curr->data)->wraps;
+
+        if (cnt >= s->rows)
+            break;
+    }
+
+    wmove(legacy_contents, s->row, s->col);
+}
+
+/* fills the buffer with lines exactly as wide as the contents window */
+static void fill_screen(Screen s, int lines) {
+    for (int i = 0 ; i < lines ; ++i) {
+        /* one tab to exercise expansion, the rest printable characters */
+        handle_tab(s);
+        for (int j = 4 ; j < BENCH_COLS-1 ; ++j)
+            handle_insert_char(s, 'a' + (i+j) % 26);
+
+        if (i+1 < lines)
+            handle_enter(s);
+    }
+
+    screen_go_to_first_line(s);
+}
+
+/* hardware counters, NULL unless asked for & available */
+static Counters counters = NULL;
+
+/* renders the given number of frames, returns rendered cells per second */
+static double measure(Screen s, void (*render)(Screen), int frames,
+                      double counts[N_COUNTERS]) {
+    counters_start(counters);
+    double start = now();
+
+    for (int i = 0 ; i < frames ; ++i)
+        render(s);
+
+    double elapsed = now() - start;
+    counters_stop(counters, counts);
+
+    return (double)BENCH_ROWS * BENCH_COLS * frames / elapsed;
+}
+
+/*****************************************************************************/
+/*                                 Benchmark                                 */
+/*****************************************************************************/
+
+int main(int argc, char** argv) {
+    int frames = BENCH_FRAMES;
+
+    for (int i = 1 ; i < argc ; ++i) {
+        if (strcmp(argv[i], "--counters") == 0) {
+            counters = counters_open();
+        } else if (atoi(argv[i]) > 0) {
+            frames = atoi(argv[i]);
+        } else {
+            fprintf(stderr, "usage: %s [FRAMES] [--counters]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* render into a terminal of the right size, with output thrown away */
+    int terminal = dup(STDOUT_FILENO);
+    freopen("/dev/null", "w", stdout);
+    setenv("TERM", "xterm", 0);
+
+    char size[16];
+    snprintf(size, sizeof size, "%d", BENCH_ROWS+2);
+    setenv("LINES", size, 1);
+    snprintf(size, sizeof size, "%d", BENCH_COLS+5);
+    setenv("COLUMNS", size, 1);
+
+    struct Arguments arguments;
+    arguments_init(&arguments);
+
+    Screen s = screen_init(&arguments);
+    screen_init_backend(s, backend_ncurses_new());
+    fill_screen(s, BENCH_ROWS);
+
+    legacy_contents = newwin(s->contents->rows, s->contents->cols,
+                             s->contents->y, s->contents->x);
+
+    /* warm up both paths before measuring */
+    legacy_render_contents(s);
+    render_contents(s);
+
+    double legacy_counts[N_COUNTERS] = {0};
+    double batched_counts[N_COUNTERS] = {0};
+    double headless_counts[N_COUNTERS] = {0};
+
+    double legacy = measure(s, legacy_render_contents, frames, legacy_counts);
+    double batched = measure(s, render_contents, frames, batched_counts);
+
+    delwin(legacy_contents);
+
+    Backend b = s->backend;
+    screen_destroy(s);
+    backend_destroy(b);
+
+    /* the same screen rendered into memory only */
+    s = screen_init(&arguments);
+    screen_init_backend(s, backend_headless_new(BENCH_ROWS+2, BENCH_COLS+5));
+    fill_screen(s, BENCH_ROWS);
+
+    render_contents(s);
+    double headless = measure(s, render_contents, frames, headless_counts);
+
+    b = s->backend;
+    screen_destroy(s);
+    backend_destroy(b);
+
+    /* bytes the terminal backend writes while scrolling line by line */
+    s = screen_init(&arguments);
+    screen_init_backend(s, backend_term_new(STDIN_FILENO, STDOUT_FILENO));
+    fill_screen(s, BENCH_ROWS*2);
+
+    render_frame(s);
+    long full_frame = s->backend->frame_bytes;
+
+    for (int i = 1 ; i < BENCH_ROWS ; ++i)
+        handle_move_down(s);
+    render_frame(s);
+
+    int scrolls = (frames < BENCH_ROWS) ? frames : BENCH_ROWS;
+    long scroll_bytes = 0;
+
+    for (int i = 0 ; i < scrolls ; ++i) {
+        handle_move_down(s);
+        render_frame(s);
+        scroll_bytes += s->backend->frame_bytes;
+    }
+
+    b = s->backend;
+    screen_destroy(s);
+    backend_destroy(b);
+
+    /* report on the real standard output */
+    fflush(stdout);
+    dup2(terminal, STDOUT_FILENO);
+    close(terminal);
+
+    printf("screen: %dx%d, frames: %d\n", BENCH_COLS, BENCH_ROWS, frames);
+    printf("per-character wprintw: %12.0f cells/s\n", legacy);
+    printf("row-batched output:    %12.0f cells/s\n", batched);
+    printf("speedup:               %12.2fx\n", batched / legacy);
+    printf("headless backend:      %12.0f cells/s\n", headless);
+    printf("term backend, full:    %12ld bytes/frame\n", full_frame);
+    printf("term backend, scroll:  %12ld bytes/frame\n", scroll_bytes / scrolls);
+
+    if (counters) {
+        printf("\nper frame:            ");
+        counters_print_header(stdout);
+        printf("\nper-character wprintw:");
+        counters_print(counters, stdout, legacy_counts, frames);
+        printf("\nrow-batched output:   ");
+        counters_print(counters, stdout, batched_counts, frames);
+        printf("\nheadless backend:     ");
+        counters_print(counters, stdout, headless_counts, frames);
+        printf("\n");
+    }
+
+    counters_close(counters);
+
+    return 0;
+}
@@ -0,0 +1,432 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "screen.h"
+#include "input.h"
+#include "render.h"
+#include "files.h"
+#include "histogram.h"
+#include "keytrace.h"
+#include "bench_counters.h"
+
+/*****************************************************************************/
+/*                                  Settings                                 */
+/*****************************************************************************/
+
+/* size of the screen the keys are replayed on */
+#define REPLAY_ROWS 50
+#define REPLAY_COLS 160
+
+/* default number of keys of the synthetic trace */
+#define REPLAY_KEYS 2000
+
+/* size of the text pasted by the synthetic trace */
+#define REPLAY_PASTE_SIZE (64 << 10)
+
+/*****************************************************************************/
+/*                                  Helpers                                  */
+/*****************************************************************************/
+
+/* deterministic pseudo-random numbers, the same trace on every machine */
+static unsigned long long seed = 1;
+
+static unsigned rnd(unsigned n) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (seed >> 33) % n;
+}
+
+static const char* words[] = {
+    "int", "char", "return", "if", "else", "while", "for", "static", "void",
+    "screen", "line", "buffer", "gap", "cursor", "render", "size", "length",
+};
+
+#define N_WORDS (sizeof words / sizeof words[0])
+
+/*****************************************************************************/
+/*                                 Scenarios                                 */
+/*****************************************************************************/
+
+/* source code: indented lines of statements */
+static void generate_source(FILE* file, long size) {
+    long written = 0;
+
+    while (written < size) {
+        int depth = rnd(4);
+        for (int i = 0 ; i < depth ; ++i)
+            written += fprintf(file, "\t");
+
+        int n = 2 + rnd(8);
+        for (int i = 0 ; i < n ; ++i)
+            written += fprintf(file, "%s%s", words[rnd(N_WORDS)],
+                               (i+1 < n) ? " " : ";\n");
+    }
+}
+
+/* log: long lines with timestamps */
+static void generate_log(FILE* file, long size) {
+    long written = 0;
+
+    for (long i = 0 ; written < size ; ++i)
+        written += fprintf(file, "2026-10-19 %02ld:%02ld:%02ld.%03ld INFO "
+                           "[worker-%u] request %ld handled in %u ms by %s\n",
+                           i / 3600000 % 24, i / 60000 % 60, i / 1000 % 60,
+                           i % 1000, rnd(64), i, rnd(500), words[rnd(N_WORDS)]);
+}
+
+/* one line of words without a single line break until the end */
+static void generate_line(FILE* file, long size) {
+    long written = 0;
+
+    while (written < size)
+        written += fprintf(file, "%s ", words[rnd(N_WORDS)]);
+
+    fprintf(file, "\n");
+}
+
+/* standard scenarios, sizes in bytes at scale 1
+   lines taller than the screen cannot be scrolled through vertically yet,
+   so up & down arrows are skipped on the single line */
+static const struct {
+    const char* name;
+    long size;
+    void (*generate)(FILE*, long);
+    bool vertical; /* if up & down arrows are replayed */
+} scenarios[] = {
+    { "source", 1L << 20, generate_source, true },
+    { "log", 500L << 20, generate_log, true },
+    { "line", 50L << 20, generate_line, false },
+};
+
+#define N_SCENARIOS (sizeof scenarios / sizeof scenarios[0])
+
+/*****************************************************************************/
+/*                                   Traces                                  */
+/*****************************************************************************/
+
+/* kinds of keys latencies are reported for */
+enum kind { KIND_CHAR, KIND_ENTER, KIND_BACKSPACE, KIND_TAB, KIND_ARROW,
+            KIND_PASTE, KIND_OTHER, N_KINDS };
+
+static const char* kind_names[] = {
+    "char", "enter", "backspace", "tab", "arrow", "paste", "other",
+};
+
+static enum kind kind_of(int key) {
+    switch (key) {
+    case '\n':
+        return KIND_ENTER;
+    case 127:
+    case KEY_BACKSPACE:
+        return KIND_BACKSPACE;
+    case '\t':
+        return KIND_TAB;
+    case KEY_LEFT:
+    case KEY_RIGHT:
+    case KEY_UP:
+    case KEY_DOWN:
+        return KIND_ARROW;
+    case KEY_PASTE_BEGIN:
+        return KIND_PASTE;
+    default:
+        return (key >= 32 && key < 127) ? KIND_CHAR : KIND_OTHER;
+    }
+}
+
+/* makes up a trace of someone typing, moving around and pasting */
+static KeyTrace generate_trace(long keys) {
+    static const int arrows[] = { KEY_LEFT, KEY_RIGHT, KEY_UP, KEY_DOWN };
+
+    KeyTrace t = keytrace_new();
+    uint64_t time = 0;
+
+    for (long i = 0 ; i < keys ; ++i) {
+        time += 20000 + rnd(100000); /* 20 to 120 ms between keys */
+
+        unsigned dice = rnd(100);
+
+        if (dice < 60) {
+            const char* word = words[rnd(N_WORDS)];
+            for ( ; *word && i < keys ; ++word, ++i)
+                keytrace_add(t, *word, time);
+            keytrace_add(t, ' ', time);
+        } else if (dice < 68) {
+            keytrace_add(t, '\n', time);
+        } else if (dice < 76) {
+            keytrace_add(t, KEY_BACKSPACE, time);
+        } else if (dice < 80) {
+            keytrace_add(t, '\t', time);
+        } else if (dice < 98) {
+            keytrace_add(t, arrows[rnd(4)], time);
+        } else {
+            /* pasted text arrives all at once between the markers */
+            keytrace_add(t, KEY_PASTE_BEGIN, time);
+            for (long j = 0 ; j < REPLAY_PASTE_SIZE ; ++j)
+                keytrace_add(t, (rnd(40) == 0) ? '\n' : 'a' + rnd(26), time);
+            keytrace_add(t, KEY_PASTE_END, time);
+        }
+    }
+
+    return t;
+}
+
+/*****************************************************************************/
+/*                                   Replay                                  */
+/*****************************************************************************/
+
+/* latencies of one kind of keys */
+struct latencies {
+    double* us; /* latency of every key in microseconds */
+    size_t length;
+    size_t size;
+    double counts[N_COUNTERS]; /* hardware events counted over all keys */
+};
+
+/* hardware counters, NULL unless asked for & available */
+static Counters counters = NULL;
+
+static void latencies_add(struct latencies* l, double us) {
+    if (l->length == l->size) {
+        l->size = (l->size) ? l->size * 2 : 256;
+        l->us = realloc(l->us, sizeof(double) * l->size);
+    }
+
+    l->us[l->length++] = us;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* value below which the given fraction of the sorted latencies lie */
+static double percentile(struct latencies* l, double fraction) {
+    return l->us[(size_t)((l->length-1) * fraction)];
+}
+
+/* replays the trace, timing each key from reading it to a ready frame */
+static void replay(Screen s, KeyTrace t, struct latencies* kinds,
+                   bool vertical) {
+    Backend b = s->backend;
+
+    for (size_t i = 0 ; i < t->length ; ++i) {
+        int key = t->events[i].key;
+
+        /* quitting would end the benchmark */
+        if (key == 24)
+            continue;
+
+        if (!vertical && (key == KEY_UP || key == KEY_DOWN))
+            continue;
+
+        backend_headless_push_key(b, key);
+
+        /* the whole paste is read by the editor in one go */
+        if (key == KEY_PASTE_BEGIN) {
+            while (++i < t->length && t->events[i].key != KEY_PASTE_END)
+                backend_headless_push_key(b, t->events[i].key);
+            backend_headless_push_key(b, KEY_PASTE_END);
+        }
+
+
+        struct latencies* l = &kinds[kind_of(key)];
+
+        counters_start(counters);
+        uint64_t start = time_us();
+
+        insert_mode(s);
+        screen_fit_line_numbers(s);
+        render_frame(s);
+
+        double elapsed = time_us() - start;
+        counters_stop(counters, l->counts);
+
+        latencies_add(l, elapsed);
+    }
+}
+
+static void print_results(const char* scenario, struct latencies* kinds,
+                          bool csv) {
+    for (int k = 0 ; k < N_KINDS ; ++k) {
+        struct latencies* l = &kinds[k];
+        if (l->length == 0)
+            continue;
+
+        qsort(l->us, l->length, sizeof(double), compare_doubles);
+
+        if (csv) {
+            printf("%s,%s,%zu,%.1f,%.1f,%.1f", scenario, kind_names[k],
+                   l->length, percentile(l, 0.5), percentile(l, 0.99),
+                   l->us[l->length-1]);
+
+            for (int i = 0 ; counters && i < N_COUNTERS ; ++i) {
+                if (counters_available(counters, i))
+                    printf(",%.1f", l->counts[i] / l->length);
+                else
+                    printf(",");
+            }
+        } else {
+            printf("  %-10s %8zu %12.1f %12.1f %12.1f", kind_names[k],
+                   l->length, percentile(l, 0.5), percentile(l, 0.99),
+                   l->us[l->length-1]);
+
+            if (counters)
+                counters_print(counters, stdout, l->counts, l->length);
+        }
+
+        printf("\n");
+    }
+}
+
+/*****************************************************************************/
+/*                                 Benchmark                                 */
+/*****************************************************************************/
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [--scenario source|log|line] [--scale F] "
+            "[--keys N] [--trace FILE] [--dir DIR] [--csv] [--counters]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    const char* only = NULL;
+    const char* trace_name = NULL;
+    const char* dir = "/tmp";
+    double scale = 1;
+    long keys = REPLAY_KEYS;
+    bool csv = false;
+
+    for (int i = 1 ; i < argc ; ++i) {
+        if (strcmp(argv[i], "--scenario") == 0 && i+1 < argc)
+            only = argv[++i];
+        else if (strcmp(argv[i], "--scale") == 0 && i+1 < argc)
+            scale = atof(argv[++i]);
+        else if (strcmp(argv[i], "--keys") == 0 && i+1 < argc)
+            keys = atol(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i+1 < argc)
+            trace_name = argv[++i];
+        else if (strcmp(argv[i], "--dir") == 0 && i+1 < argc)
+            dir = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0)
+            csv = true;
+        else if (strcmp(argv[i], "--counters") == 0)
+            counters = counters_open();
+        else
+            usage(argv[0]);
+    }
+
+    KeyTrace trace = (trace_name) ? keytrace_load(trace_name) :
+        generate_trace(keys);
+
+    if (!trace) {
+        fprintf(stderr, "%s: cannot read trace %s\n", argv[0], trace_name);
+        return EXIT_FAILURE;
+    }
+
+    struct Arguments arguments;
+    arguments_init(&arguments);
+    arguments.backend = "headless";
+
+    if (csv) {
+        printf("scenario,key,count,p50_us,p99_us,max_us");
+
+        for (int i = 0 ; counters && i < N_COUNTERS ; ++i)
+            printf(",%s_per_key", counter_names[i]);
+        printf("\n");
+    }
+
+    for (size_t i = 0 ; i < N_SCENARIOS ; ++i) {
+        if (only && strcmp(only, scenarios[i].name) != 0)
+            continue;
+
+        /* write the scenario's file */
+        char name[4096];
+        snprintf(name, sizeof name, "%s/bench_replay_%s.txt", dir,
+                 scenarios[i].name);
+
+        FILE* file = fopen(name, "w");
+        if (!file) {
+            fprintf(stderr, "%s: cannot write %s\n", argv[0], name);
+            return EXIT_FAILURE;
+        }
+
+        seed = 1;
+        scenarios[i].generate(file, scenarios[i].size * scale);
+        fclose(file);
+
+        /* open it the way the editor does */
+        arguments.file_name = name;
+
+        Backend b = backend_headless_new(REPLAY_ROWS, REPLAY_COLS);
+        Screen s = screen_init(&arguments);
+        screen_init_backend(s, b);
+
+        uint64_t start = time_us();
+        file_open(s, name);
+        screen_fit_line_numbers(s);
+        render_frame(s);
+        double load = time_us() - start;
+
+        struct latencies kinds[N_KINDS];
+        memset(kinds, 0, sizeof kinds);
+
+        replay(s, trace, kinds, scenarios[i].vertical);
+
+        if (csv) {
+            printf("%s,load,1,%.1f,%.1f,%.1f", scenarios[i].name,
+                   load, load, load);
+
+            for (int k = 0 ; counters && k < N_COUNTERS ; ++k)
+                printf(",");
+            printf("\n");
+        } else {
+            printf("%s: %.2f MB, %u lines, loaded in %.1f ms\n",
+                   scenarios[i].name, scenarios[i].size * scale / (1 << 20),
+                   s->n_lines, load / 1000);
+            printf("  %-10s %8s %12s %12s %12s", "key", "count",
+                   "p50 (us)", "p99 (us)", "max (us)");
+
+            if (counters)
+                counters_print_header(stdout);
+            printf("\n");
+        }
+
+        print_results(scenarios[i].name, kinds, csv);
+
+        for (int k = 0 ; k < N_KINDS ; ++k)
+            free(kinds[k].us);
+
+        file_close(s);
+        screen_destroy(s);
+        backend_destroy(b);
+        remove(name);
+    }
+
+    keytrace_destroy(trace);
+    counters_close(counters);
+
+    return 0;
+}
@@ -19,6 +19,11 @@
  ************************************************************************/
 
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include <check.h>
 #include <glib-2.0/glib.h>
@@ -26,6 +31,11 @@
 #include "lib/gap_buffer.h"
 #include "screen.h"
 #include "input.h"
+#include "render.h"
+#include "files.h"
+#include "trace.h"
+#include "pool.h"
+#include "viewer.h"
 
 /*****************************************************************************/
 /*                                   Macros                                  */
@@ -194,6 +204,510 @@ START_TEST (test_go_to_first_line) {
     screen_destroy(s);
 } END_TEST
 
+/* test rendering a frame on a backend with no terminal */
+START_TEST (test_render_headless) {
+    Backend b = backend_headless_new(10, 30);
+    Screen s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+
+    /* contents take up what is left next to the line numbers */
+    ck_assert_int_eq(8, s->rows);
+    ck_assert_int_eq(24, s->cols);
+
+    /* keys are read from the backend */
+    backend_headless_push_key(b, 'h');
+    backend_headless_push_key(b, 'i');
+    backend_headless_push_key(b, '\t');
+    backend_headless_push_key(b, 'x');
+    backend_headless_push_key(b, '\n');
+    backend_headless_push_key(b, 'a');
+
+    for (int i = 0 ; i < 6 ; ++i)
+        ck_assert(insert_mode(s));
+
+    /* no more keys */
+    ck_assert(!insert_mode(s));
+
+    render_frame(s);
+    ck_assert_int_eq(1, backend_headless_frames(b));
+
+    char text[31];
+
+    backend_headless_row_text(b, 1, text);
+    ck_assert_str_eq("   1 hi  x                    ", text);
+
+    backend_headless_row_text(b, 2, text);
+    ck_assert_str_eq("   2 a                        ", text);
+
+    backend_headless_row_text(b, 3, text);
+    ck_assert_str_eq("   ~                          ", text);
+
+    /* line numbers are colored, bars reversed */
+    ck_assert_int_eq(ATTR_YELLOW, backend_headless_row(b, 1)[3].attr);
+    ck_assert_int_eq(ATTR_NONE, backend_headless_row(b, 1)[5].attr);
+    ck_assert_int_eq(ATTR_REVERSE, backend_headless_row(b, 0)[0].attr);
+    ck_assert_int_eq(ATTR_REVERSE, backend_headless_row(b, 9)[0].attr);
+
+    /* the cursor is shown in the contents */
+    uint row, col;
+    backend_headless_cursor(b, &row, &col);
+    ck_assert_int_eq(2, row);
+    ck_assert_int_eq(6, col);
+
+    /* rows under a window which is taken away are painted again */
+    backend_headless_push_key(b, 3);
+    ck_assert(!screen_save_confirmation_window(s));
+    ck_assert_ptr_eq(NULL, CURR_PANE->gutter_rows);
+
+    render_frame(s);
+    backend_headless_row_text(b, 8, text);
+    ck_assert_str_eq("   ~                          ", text);
+    ck_assert_ptr_ne(NULL, s->info_bar_bottom);
+
+    screen_destroy(s);
+    backend_destroy(b);
+
+    /* debug mode shows its panel on the right */
+    struct Arguments debug_arguments = test_arguments;
+    debug_arguments.debug_mode = true;
+
+    b = backend_headless_new(10, 60);
+    s = screen_init(&debug_arguments);
+    screen_init_backend(s, b);
+
+    render_frame(s);
+
+    char debug_text[61];
+    backend_headless_row_text(b, 1, debug_text);
+    ck_assert_str_eq("Number of lines: 1      ", debug_text+36);
+    ck_assert_int_eq(ATTR_REVERSE, backend_headless_row(b, 1)[34].attr);
+
+    screen_destroy(s);
+    backend_destroy(b);
+} END_TEST
+
+/* test drawing frames from the render thread */
+START_TEST (test_render_threaded) {
+    Backend terminal = backend_headless_new(10, 30);
+    Backend b = backend_threaded_new(terminal);
+    Screen s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+
+    /* publish frames faster than they might get drawn */
+    for (int i = 0 ; i < 50 ; ++i) {
+        handle_insert_char(s, 'a' + i % 26);
+        render_frame(s);
+    }
+
+    backend_threaded_flush(b);
+
+    /* every frame was either drawn or dropped */
+    ck_assert_int_eq(50, backend_headless_frames(terminal) +
+                     backend_threaded_dropped(b));
+
+    /* the last frame is the one shown */
+    char text[31];
+    backend_headless_row_text(terminal, 1, text);
+    ck_assert_str_eq("   1 abcdefghijklmnopqrstuvwxy", text);
+
+    uint row, col;
+    backend_headless_cursor(terminal, &row, &col);
+    ck_assert_int_eq(3, row);
+    ck_assert_int_eq(5 + 50 - 25*2, col);
+
+    /* the editor follows the terminal's size */
+    backend_headless_resize(terminal, 12, 40);
+    ck_assert_int_eq(KEY_RESIZE, backend_read_key(b));
+    ck_assert_int_eq(40, b->cols);
+
+    screen_destroy(s);
+    backend_destroy(b);
+} END_TEST
+
+/* test counting memory used by lines */
+START_TEST (test_memory_stats) {
+    struct line_stats lines = line_stats;
+    struct gap_buffer_stats buffers = gap_buffer_stats;
+
+    Screen s = screen_init(&test_arguments);
+
+    /* an empty line holds its line break */
+    ck_assert_int_eq(lines.lines + 1, line_stats.lines);
+    ck_assert_int_eq(buffers.buffers + 1, gap_buffer_stats.buffers);
+    ck_assert_int_eq(buffers.text + 1, gap_buffer_stats.text);
+    ck_assert_int_gt(line_stats.allocations, lines.allocations);
+
+    for (int i = 0 ; i < 25 ; ++i)
+        handle_insert_char(s, 'a');
+    handle_paste(s, "bc\nde", 5);
+    handle_backspace(s);
+
+    /* text is counted as it changes, gaps make up the rest */
+    ck_assert_int_eq(lines.lines + 2, line_stats.lines);
+    ck_assert_int_eq(lines.allocations + 1, line_stats.allocations);
+    ck_assert_int_eq(buffers.text + 25 + 4 - 1 + 2, gap_buffer_stats.text);
+    ck_assert_int_gt(gap_buffer_stats.capacity - buffers.capacity,
+                     gap_buffer_stats.text - buffers.text);
+    ck_assert_int_ge(gap_buffer_stats.peak_capacity, gap_buffer_stats.capacity);
+
+    screen_destroy(s);
+
+    /* everything is given back, the pool of lines too */
+    ck_assert_int_eq(lines.lines, line_stats.lines);
+    ck_assert_int_eq(0, line_stats.pooled);
+    ck_assert_int_eq(buffers.buffers, gap_buffer_stats.buffers);
+    ck_assert_int_eq(buffers.capacity, gap_buffer_stats.capacity);
+    ck_assert_int_eq(buffers.text, gap_buffer_stats.text);
+} END_TEST
+
+/* test reusing objects of a pool */
+START_TEST (test_pool) {
+    Pool p = pool_new(20, 4);
+    void* objects[10];
+
+    for (int i = 0 ; i < 10 ; ++i) {
+        objects[i] = pool_alloc(p);
+        memset(objects[i], i, 20);
+
+        /* objects are aligned like malloc's */
+        ck_assert_int_eq(0, (uintptr_t)objects[i] % _Alignof(max_align_t));
+    }
+
+    ck_assert_int_eq(3, p->n_blocks);
+    ck_assert_int_eq(2, p->n_free);
+
+    /* objects don't overlap */
+    for (int i = 0 ; i < 10 ; ++i)
+        ck_assert_int_eq(i, ((char*)objects[i])[19]);
+
+    /* freed objects are given out again before allocating */
+    pool_free(p, objects[3]);
+    pool_free(p, objects[7]);
+    ck_assert_ptr_eq(objects[7], pool_alloc(p));
+    ck_assert_ptr_eq(objects[3], pool_alloc(p));
+    ck_assert_int_eq(3, p->n_blocks);
+
+    pool_destroy(p);
+} END_TEST
+
+/* test counting values in histograms */
+START_TEST (test_histogram) {
+    Histogram h = histogram_new();
+    ck_assert_int_eq(0, histogram_percentile(h, 50));
+
+    for (uint64_t i = 1 ; i <= 1000 ; ++i)
+        histogram_add(h, i);
+
+    ck_assert_int_eq(1000, h->count);
+    ck_assert_int_eq(1000, h->max);
+
+    /* small values are exact, big ones within a few percent */
+    ck_assert_int_eq(1, histogram_percentile(h, 0));
+    ck_assert_int_ge(histogram_percentile(h, 50), 500);
+    ck_assert_int_le(histogram_percentile(h, 50), 500 * 1.04);
+    ck_assert_int_ge(histogram_percentile(h, 99), 990);
+    ck_assert_int_le(histogram_percentile(h, 99), 1000);
+    ck_assert_int_eq(1000, histogram_percentile(h, 100));
+
+    /* huge values still get a bucket */
+    histogram_add(h, UINT64_MAX);
+    ck_assert_int_eq(UINT64_MAX, histogram_percentile(h, 100));
+
+    histogram_destroy(h);
+} END_TEST
+
+/* test timing stages of frames */
+START_TEST (test_frame_timings) {
+    Backend b = backend_headless_new(10, 30);
+    Screen s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+
+    /* frames without keys are not counted */
+    render_frame(s);
+    screen_finish_frame(s);
+    ck_assert_int_eq(0, s->timings[STAGE_FRAME]->count);
+
+    backend_headless_push_key(b, 'a');
+    backend_headless_push_key(b, 'b');
+    while (insert_mode(s));
+    render_frame(s);
+    screen_finish_frame(s);
+
+    for (int i = 0 ; i < N_STAGES ; ++i) {
+        ck_assert_int_eq(1, s->timings[i]->count);
+        ck_assert_int_eq(0, s->stage_times[i]);
+    }
+
+    /* the frame covers its stages */
+    ck_assert_int_ge(s->timings[STAGE_FRAME]->max,
+                     s->timings[STAGE_EDIT]->max + s->timings[STAGE_RENDER]->max);
+
+    char name[] = "/tmp/logic_test_XXXXXX";
+    close(mkstemp(name));
+    ck_assert(screen_dump_timings(s, name));
+
+    FILE* file = fopen(name, "r");
+    char line[64];
+    ck_assert_ptr_nonnull(fgets(line, sizeof line, file));
+    ck_assert_str_eq("input (us): 1 values\n", line);
+    fclose(file);
+    unlink(name);
+
+    screen_destroy(s);
+    backend_destroy(b);
+} END_TEST
+
+/* moves the start of the running frame back by the given microseconds,
+   under the lock the watchdog reads it with & waking it to see the change */
+static void move_frame_start(Screen s, uint64_t us) {
+    pthread_mutex_lock(&s->frame_lock);
+    s->frame_start -= us;
+    pthread_cond_signal(&s->watchdog_wake);
+    pthread_mutex_unlock(&s->frame_lock);
+}
+
+/* waits up to five seconds for a file to have at least the given number of
+   lines, returns false if it doesn't */
+static bool wait_for_lines(const char* name, int lines) {
+    for (int tries = 0 ; tries < 5000 ; ++tries) {
+        FILE* file = fopen(name, "r");
+        int n = 0;
+
+        for (int c ; (c = fgetc(file)) != EOF ; )
+            n += (c == '\n');
+
+        fclose(file);
+
+        if (n >= lines)
+            return true;
+
+        usleep(1000);
+    }
+
+    return false;
+}
+
+/* test logging frames over the frame budget */
+START_TEST (test_slow_frame_log) {
+    char name[] = "/tmp/logic_test_XXXXXX";
+    close(mkstemp(name));
+
+    struct Arguments arguments = test_arguments;
+    arguments.frame_budget = 10;
+    arguments.frame_log = name;
+
+    Backend b = backend_headless_new(10, 30);
+    Screen s = screen_init(&arguments);
+    screen_init_backend(s, b);
+
+    /* a fast frame isn't logged */
+    backend_headless_push_key(b, 'a');
+    while (insert_mode(s));
+    render_frame(s);
+    screen_finish_frame(s);
+
+    FILE* file = fopen(name, "r");
+    ck_assert_int_eq(EOF, fgetc(file));
+    fclose(file);
+
+    /* a frame which started long ago is */
+    backend_headless_push_key(b, 'b');
+    backend_headless_push_key(b, '\n');
+    while (insert_mode(s));
+    move_frame_start(s, 50000);
+    render_frame(s);
+    screen_finish_frame(s);
+
+    ck_assert_int_eq(0, s->frame_keys);
+
+    /* by the watchdog, not to hold up the next frame */
+    ck_assert(wait_for_lines(name, 4));
+
+    char line[128];
+    file = fopen(name, "r");
+    ck_assert_ptr_nonnull(fgets(line, sizeof line, file));
+    ck_assert_ptr_nonnull(strstr(line, "2 keys, last key 10\n"));
+    ck_assert_ptr_nonnull(fgets(line, sizeof line, file));
+    ck_assert_ptr_nonnull(strstr(line, "before: line 1/1, 2 bytes"));
+    ck_assert_ptr_nonnull(fgets(line, sizeof line, file));
+    ck_assert_ptr_nonnull(strstr(line, "after:  line 2/2, 1 bytes"));
+    ck_assert_ptr_nonnull(fgets(line, sizeof line, file));
+    ck_assert_ptr_nonnull(strstr(line, "input"));
+    ck_assert_ptr_null(fgets(line, sizeof line, file));
+    fclose(file);
+
+    /* a frame which hangs is logged before it finishes */
+    backend_headless_push_key(b, 'c');
+    while (insert_mode(s));
+    move_frame_start(s, 2 * FRAME_HANG_BUDGETS * arguments.frame_budget * 1000);
+    ck_assert(wait_for_lines(name, 6));
+
+    file = fopen(name, "r");
+    for (int i = 0 ; i < 4 ; ++i)
+        ck_assert_ptr_nonnull(fgets(line, sizeof line, file));
+    ck_assert_ptr_nonnull(fgets(line, sizeof line, file));
+    ck_assert_ptr_nonnull(strstr(line, "frame still running after"));
+    ck_assert_ptr_nonnull(strstr(line, "1 keys, last key 99\n"));
+    ck_assert_ptr_nonnull(fgets(line, sizeof line, file));
+    ck_assert_ptr_nonnull(strstr(line, "before: line 2/2, 1 bytes"));
+    ck_assert_ptr_null(fgets(line, sizeof line, file));
+    fclose(file);
+    unlink(name);
+
+    screen_destroy(s);
+    backend_destroy(b);
+} END_TEST
+
+/* traces spans from another thread */
+static void* trace_thread(void* arg) {
+    (void)arg;
+
+    for (int i = 0 ; i < 10 ; ++i)
+        trace_end("thread span", trace_begin());
+
+    return NULL;
+}
+
+/* counts occurences of a string in another one */
+static int count_occurences(const char* haystack, const char* needle) {
+    int n = 0;
+
+    for (const char* p = haystack ; (p = strstr(p, needle)) ; ++p)
+        n++;
+
+    return n;
+}
+
+/* test writing trace events */
+START_TEST (test_trace) {
+    char name[] = "/tmp/logic_test_XXXXXX";
+    close(mkstemp(name));
+
+    /* nothing is recorded when not tracing */
+    ck_assert_int_eq(0, trace_begin());
+    trace_counter("ignored", 1);
+
+    ck_assert(trace_start(name));
+
+    /* more events than a ring holds */
+    for (int i = 0 ; i < TRACE_RING_SIZE + 10 ; ++i)
+        trace_end_arg("main span", trace_begin(), "key", i);
+    trace_counter("lines", 42);
+
+    /* events are written out regularly, not only when stopping */
+    usleep(2 * TRACE_FLUSH_INTERVAL * 1000);
+
+    FILE* file = fopen(name, "r");
+    static char trace[1 << 20];
+    size_t length = fread(trace, 1, sizeof trace - 1, file);
+    trace[length] = '\0';
+    fclose(file);
+
+    ck_assert_int_eq(1, count_occurences(trace, "\"name\":\"lines\",\"ph\":\"C\""));
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, trace_thread, NULL);
+    pthread_join(thread, NULL);
+
+    trace_stop();
+    ck_assert(!trace_enabled);
+
+    /* read the whole trace */
+    file = fopen(name, "r");
+    length = fread(trace, 1, sizeof trace - 1, file);
+    trace[length] = '\0';
+    fclose(file);
+    unlink(name);
+
+    ck_assert(strncmp(trace, "{\"traceEvents\":[\n{", 17) == 0);
+    ck_assert_str_eq("}\n]}\n", trace + length - 5);
+
+    ck_assert_int_eq(TRACE_RING_SIZE + 10,
+                     count_occurences(trace, "\"name\":\"main span\",\"ph\":\"X\",\"pid\":1,\"tid\":1"));
+    ck_assert_int_eq(10, count_occurences(trace, "\"name\":\"thread span\",\"ph\":\"X\",\"pid\":1,\"tid\":2"));
+    ck_assert_int_eq(1, count_occurences(trace, "\"args\":{\"key\":4100}"));
+    ck_assert_int_eq(1, count_occurences(trace, "\"name\":\"lines\",\"ph\":\"C\""));
+    ck_assert_int_eq(1, count_occurences(trace, "\"args\":{\"value\":42}"));
+    ck_assert_int_eq(0, count_occurences(trace, "ignored"));
+} END_TEST
+
+/* reads everything written into a pipe so far */
+static char* pipe_read(int fd) {
+    static char output[65536];
+    ssize_t n = read(fd, output, sizeof output - 1);
+
+    output[(n > 0) ? n : 0] = '\0';
+    return output;
+}
+
+/* test drawing on a terminal with own escape sequences */
+START_TEST (test_render_term) {
+    int input[2], output[2];
+    ck_assert_int_eq(0, pipe(input));
+    ck_assert_int_eq(0, pipe(output));
+    fcntl(output[0], F_SETFL, O_NONBLOCK);
+
+    /* pipes have no size */
+    setenv("LINES", "10", 1);
+    setenv("COLUMNS", "30", 1);
+
+    Backend b = backend_term_new(input[0], output[1]);
+    Screen s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+    pipe_read(output[0]);
+
+    ck_assert_int_eq(10, b->rows);
+    ck_assert_int_eq(30, b->cols);
+
+    /* keys and escape sequences are decoded */
+    ck_assert_int_eq(11, write(input[1], "ab\033[D\033[200~", 11));
+    ck_assert_int_eq('a', backend_read_key(b));
+    ck_assert_int_eq('b', backend_read_key(b));
+    ck_assert_int_eq(KEY_LEFT, backend_read_key(b));
+    ck_assert_int_eq(KEY_PASTE_BEGIN, backend_read_key(b));
+
+    backend_timeout(b, 0);
+    ck_assert_int_eq(ERR, backend_read_key(b));
+
+    /* a lone escape is reported once nothing follows it */
+    ck_assert_int_eq(1, write(input[1], "\033", 1));
+    ck_assert_int_eq('\033', backend_read_key(b));
+
+    /* the first frame writes everything */
+    render_frame(s);
+    char* frame = pipe_read(output[0]);
+    ck_assert_int_eq(strlen(frame), b->frame_bytes);
+    ck_assert_ptr_nonnull(strstr(frame, "   1 "));
+    ck_assert_ptr_nonnull(strstr(frame, "File: -"));
+
+    /* a typed character writes little more than itself */
+    handle_insert_char(s, 'x');
+    render_frame(s);
+    frame = pipe_read(output[0]);
+    ck_assert_ptr_nonnull(strstr(frame, "x"));
+    ck_assert_int_lt(b->frame_bytes, 60);
+
+    /* going past the last row scrolls the contents instead of redrawing */
+    for (int i = 0 ; i < 8 ; ++i)
+        handle_enter(s);
+    render_frame(s);
+    pipe_read(output[0]);
+
+    handle_enter(s);
+    render_frame(s);
+    frame = pipe_read(output[0]);
+    ck_assert_ptr_nonnull(strstr(frame, "\033[2;9r\033[1S\033[r"));
+    ck_assert_int_lt(b->frame_bytes, 80);
+
+    screen_destroy(s);
+    backend_destroy(b);
+
+    close(input[0]);
+    close(input[1]);
+    close(output[0]);
+    close(output[1]);
+} END_TEST
+
 Suite* s_screen() {
     Suite* s_screen = suite_create("screen");
 
@@ -208,6 +722,24 @@ Suite* s_screen() {
     tcase_add_test(tc_lines, test_go_to_first_line);
     suite_add_tcase(s_screen, tc_lines);
 
+    TCase* tc_render = tcase_create("rendering");
+    tcase_add_test(tc_render, test_render_headless);
+    tcase_add_test(tc_render, test_render_threaded);
+    tcase_add_test(tc_render, test_render_term);
+    suite_add_tcase(s_screen, tc_render);
+
+    TCase* tc_memory = tcase_create("memory");
+    tcase_add_test(tc_memory, test_memory_stats);
+    tcase_add_test(tc_memory, test_pool);
+    suite_add_tcase(s_screen, tc_memory);
+
+    TCase* tc_timing = tcase_create("timing");
+    tcase_add_test(tc_timing, test_histogram);
+    tcase_add_test(tc_timing, test_frame_timings);
+    tcase_add_test(tc_timing, test_trace);
+    tcase_add_test(tc_timing, test_slow_frame_log);
+    suite_add_tcase(s_screen, tc_timing);
+
     return s_screen;
 }
 
@@ -320,10 +852,10 @@ START_TEST (test_move_left) {
 
     /* state before move */
     ck_assert_int_eq(1, s->n_lines);
-    ck_assert_int_eq(6, s->col);
+    ck_assert_int_eq(4, s->col);
     ck_assert_int_eq(0, s->row);
-    ck_assert_int_eq(7, CURR_LINE->visual_end);
-    ck_assert_int_eq(6, CURR_LINE->visual_cursor);
+    ck_assert_int_eq(5, CURR_LINE->visual_end);
+    ck_assert_int_eq(4, CURR_LINE->visual_cursor);
     ck_assert_int_eq(3, CURR_LBUF->cursor);
     ck_assert_int_eq('\t', CURR_LBUF->buffer[CURR_LBUF->cursor-1]);
 
@@ -333,7 +865,7 @@ START_TEST (test_move_left) {
     ck_assert_int_eq(1, s->n_lines);
     ck_assert_int_eq(2, s->col);
     ck_assert_int_eq(0, s->row);
-    ck_assert_int_eq(7, CURR_LINE->visual_end);
+    ck_assert_int_eq(5, CURR_LINE->visual_end);
     ck_assert_int_eq(2, CURR_LINE->visual_cursor);
     ck_assert_int_eq(2, CURR_LBUF->cursor);
     ck_assert_int_eq('b', CURR_LBUF->buffer[CURR_LBUF->cursor-1]);
@@ -359,10 +891,10 @@ START_TEST (test_move_left) {
 
     /* state after move, at the end of the upper line */
     ck_assert_int_eq(2, s->n_lines);
-    ck_assert_int_eq(7, s->col);
+    ck_assert_int_eq(5, s->col);
     ck_assert_int_eq(0, s->row);
     ck_assert_int_eq(0, s->cur_line_num);
-    ck_assert_int_eq(7, CURR_LINE->visual_end);
+    ck_assert_int_eq(5, CURR_LINE->visual_end);
     ck_assert_int_eq(CURR_LINE->visual_end, CURR_LINE->visual_cursor);
     ck_assert_int_eq(8, CURR_LBUF->cursor);
     ck_assert_int_eq('\n', CURR_LBUF->buffer[CURR_LBUF->cursor+1]);
@@ -380,7 +912,7 @@ START_TEST (test_move_left) {
     ck_assert_int_eq(31, CURR_LINE->visual_cursor);
     ck_assert_int_eq(1, CURR_LINE->wraps);
     ck_assert_int_eq(1, CURR_LINE->wrap);
-    ck_assert_int_eq(28, CURR_LBUF->cursor);
+    ck_assert_int_eq(30, CURR_LBUF->cursor);
 
     handle_move_left(s);
 
@@ -392,7 +924,7 @@ START_TEST (test_move_left) {
     ck_assert_int_eq(30, CURR_LINE->visual_cursor);
     ck_assert_int_eq(1, CURR_LINE->wraps);
     ck_assert_int_eq(0, CURR_LINE->wrap);
-    ck_assert_int_eq(27, CURR_LBUF->cursor);
+    ck_assert_int_eq(29, CURR_LBUF->cursor);
 
     /* beginning of a top line ***********************************************/
 
@@ -424,7 +956,7 @@ START_TEST (test_move_left) {
     ck_assert_int_eq(30, CURR_LINE->visual_cursor);
     ck_assert_int_eq(1, CURR_LINE->wraps);
     ck_assert_int_eq(0, CURR_LINE->wrap);
-    ck_assert_int_eq(27, CURR_LBUF->cursor);
+    ck_assert_int_eq(29, CURR_LBUF->cursor);
 
     ck_assert_ptr_eq(s->top_line, new_top_line);
 
@@ -512,7 +1044,7 @@ START_TEST (test_move_right) {
     ck_assert_int_eq(0, s->row);
     ck_assert_int_eq(0, s->cur_line_num);
     ck_assert_int_eq(0, s->top_line_num);
-    ck_assert_int_eq(7, CURR_LINE->visual_end);
+    ck_assert_int_eq(4, CURR_LINE->visual_end);
     ck_assert_int_eq(3, CURR_LINE->visual_cursor);
     ck_assert_int_eq(3, CURR_LBUF->cursor);
     ck_assert_int_eq('c', CURR_LBUF->buffer[CURR_LBUF->cursor-1]);
@@ -523,12 +1055,12 @@ START_TEST (test_move_right) {
 
     /* state after move */
     ck_assert_int_eq(1, s->n_lines);
-    ck_assert_int_eq(7, s->col);
+    ck_assert_int_eq(4, s->col);
     ck_assert_int_eq(0, s->row);
     ck_assert_int_eq(0, s->cur_line_num);
     ck_assert_int_eq(0, s->top_line_num);
-    ck_assert_int_eq(7, CURR_LINE->visual_end);
-    ck_assert_int_eq(7, CURR_LINE->visual_cursor);
+    ck_assert_int_eq(4, CURR_LINE->visual_end);
+    ck_assert_int_eq(4, CURR_LINE->visual_cursor);
     ck_assert_int_eq(4, CURR_LBUF->cursor);
     ck_assert_int_eq('\t', CURR_LBUF->buffer[CURR_LBUF->cursor-1]);
     ck_assert_int_eq(0, CURR_LINE->wraps);
@@ -544,12 +1076,12 @@ START_TEST (test_move_right) {
 
     /* state before move */
     ck_assert_int_eq(2, s->n_lines);
-    ck_assert_int_eq(7, s->col);
+    ck_assert_int_eq(4, s->col);
     ck_assert_int_eq(0, s->row);
     ck_assert_int_eq(0, s->cur_line_num);
     ck_assert_int_eq(0, s->top_line_num);
-    ck_assert_int_eq(7, CURR_LINE->visual_end);
-    ck_assert_int_eq(7, CURR_LINE->visual_cursor);
+    ck_assert_int_eq(4, CURR_LINE->visual_end);
+    ck_assert_int_eq(4, CURR_LINE->visual_cursor);
     ck_assert_int_eq(4, CURR_LBUF->cursor);
     ck_assert_int_eq('\n', CURR_LBUF->buffer[9]);
     ck_assert_int_eq(0, CURR_LINE->wraps);
@@ -901,11 +1433,233 @@ START_TEST (test_tab) {
 
     /* state after tab */
     ck_assert_int_eq(1, s->n_lines);
-    ck_assert_int_eq(5, s->col);
+    ck_assert_int_eq(4, s->col);
     ck_assert_int_eq(0, s->row);
     ck_assert_int_eq('\t', CURR_LBUF->buffer[CURR_LBUF->cursor-1]);
     ck_assert_int_eq(2, CURR_LBUF->cursor);
-    ck_assert_int_eq(6, CURR_LINE->visual_end);
+    ck_assert_int_eq(5, CURR_LINE->visual_end);
+
+    /* characters before a tab take its columns until it's at the stop */
+    handle_move_left(s);
+    handle_insert_char(s, 'c');
+    handle_insert_char(s, 'd');
+    ck_assert_int_eq(3, s->col);
+    ck_assert_int_eq(5, CURR_LINE->visual_end);
+
+    handle_insert_char(s, 'e');
+    ck_assert_int_eq(4, s->col);
+    ck_assert_int_eq(9, CURR_LINE->visual_end);
+
+    handle_backspace(s);
+    ck_assert_int_eq(3, s->col);
+    ck_assert_int_eq(5, CURR_LINE->visual_end);
+
+    /* columns & offsets of the line are found from its tabs */
+    ck_assert_uint_eq(1, CURR_LINE->n_marks);
+    ck_assert_uint_eq(4, line_column(CURR_LINE, 4, s->tab_width, s->cols+1));
+    ck_assert_uint_eq(2, line_offset(CURR_LINE, 2, s->tab_width, s->cols+1));
+    ck_assert_uint_eq(3, line_offset(CURR_LINE, 3, s->tab_width, s->cols+1));
+    ck_assert_uint_eq(4, line_offset(CURR_LINE, 4, s->tab_width, s->cols+1));
+    ck_assert_uint_eq(5, line_offset(CURR_LINE, 99, s->tab_width, s->cols+1));
+
+    /* pasted text moves the tabs after it too */
+    char text[] = "x\ty";
+    handle_paste(s, text, strlen(text));
+    ck_assert_int_eq(9, s->col);
+    ck_assert_int_eq(13, CURR_LINE->visual_end);
+    ck_assert_uint_eq(2, CURR_LINE->n_marks);
+    ck_assert_ptr_nonnull(line_tab_at(CURR_LINE, 6));
+    ck_assert_uint_eq(9, line_tab_at(CURR_LINE, 6)->col);
+
+    screen_destroy(s);
+
+    /* tab stops can be further apart */
+    struct Arguments arguments = test_arguments;
+    arguments.tab_width = 8;
+    s = screen_init(&arguments);
+
+    handle_insert_char(s, 'a');
+    handle_tab(s);
+    ck_assert_int_eq(8, s->col);
+
+    handle_move_left(s);
+    ck_assert_int_eq(1, s->col);
+
+    screen_destroy(s);
+} END_TEST
+
+/* test moving up & down long lines through their column index */
+START_TEST (test_column_index) {
+    Screen s = screen_init(&test_arguments);
+
+    /* a line of two byte characters, a tab & a long line of ASCII */
+    size_t length = 2000 + 1 + 1 + 1 + 2000;
+    char* text = malloc(length);
+    for (int i = 0 ; i < 1000 ; ++i)
+        memcpy(text + 2*i, "\xc3\xa9", 2);
+    memcpy(text + 2000, "\tx\n", 3);
+    memset(text + 2003, 'a', 2000);
+    handle_paste(s, text, length);
+    free(text);
+
+    /* long lines are marked every so often, not only on tabs */
+    Line first = s->lines->data;
+    ck_assert_int_eq(1005, first->visual_end);
+    ck_assert_uint_lt(2000 / LINE_INDEX_STEP, first->n_marks);
+    ck_assert_int_eq(2000, CURR_LINE->visual_end);
+
+    /* columns & offsets agree, in the middle of the tab too */
+    for (uint col = 0 ; col < 1000 ; col += 7) {
+        ck_assert_uint_eq(2*col, line_offset(first, col, s->tab_width, s->cols+1));
+        ck_assert_uint_eq(col, line_column(first, 2*col, s->tab_width, s->cols+1));
+    }
+    ck_assert_uint_eq(2000, line_offset(first, 1002, s->tab_width, s->cols+1));
+    ck_assert_uint_eq(2001, line_offset(first, 1004, s->tab_width, s->cols+1));
+
+    /* up & down keep the column within the wraps of a line */
+    move_to_column(s, 40);
+    ck_assert_int_eq(9, s->col);
+    ck_assert_int_eq(1, CURR_LINE->wrap);
+    ck_assert_uint_eq(40, line_cursor_offset(CURR_LINE));
+
+    uint row = s->row;
+    handle_move_up(s);
+    ck_assert_int_eq(9, s->col);
+    ck_assert_int_eq(row-1, s->row);
+    ck_assert_int_eq(0, CURR_LINE->wrap);
+    ck_assert_uint_eq(9, line_cursor_offset(CURR_LINE));
+
+    handle_move_down(s);
+    handle_move_down(s);
+    ck_assert_int_eq(9, s->col);
+    ck_assert_int_eq(row+1, s->row);
+    ck_assert_int_eq(2, CURR_LINE->wrap);
+    ck_assert_uint_eq(71, line_cursor_offset(CURR_LINE));
+
+    /* moving up onto a wrapped line goes onto its last wrap */
+    move_to_column(s, 3);
+    handle_move_up(s);
+    ck_assert_int_eq(0, s->cur_line_num);
+    ck_assert_int_eq(first->wraps, CURR_LINE->wrap);
+    ck_assert_int_eq(3, s->col);
+    ck_assert_int_eq(CURR_LINE->wraps*(s->cols+1) + 3, CURR_LINE->visual_cursor);
+    ck_assert_uint_eq(2*CURR_LINE->visual_cursor, line_cursor_offset(CURR_LINE));
+
+    screen_destroy(s);
+
+    /* typed lines are marked as well, & keep their marks close together as
+       characters are deleted */
+    s = screen_init(&test_arguments);
+    for (int i = 0 ; i < 2000 ; ++i) {
+        handle_insert_byte(s, '\xc3');
+        handle_insert_byte(s, '\xa9');
+    }
+    move_to_column(s, 1500);
+    for (int i = 0 ; i < 700 ; ++i)
+        handle_backspace(s);
+    handle_end(s);
+    for (int i = 0 ; i < 300 ; ++i)
+        handle_backspace(s);
+
+    ck_assert_int_eq(1000, CURR_LINE->visual_end);
+    ck_assert_uint_lt(2000 / LINE_INDEX_STEP, CURR_LINE->n_marks);
+    for (uint i = 0 ; i < CURR_LINE->n_marks ; ++i) {
+        uint before = (i > 0) ? CURR_LINE->marks[i-1].offset : 0;
+        ck_assert_uint_le(CURR_LINE->marks[i].offset - before, LINE_INDEX_STEP);
+    }
+    for (uint col = 0 ; col < 1000 ; col += 7) {
+        ck_assert_uint_eq(2*col, line_offset(CURR_LINE, col, s->tab_width, s->cols+1));
+        ck_assert_uint_eq(col, line_column(CURR_LINE, 2*col, s->tab_width, s->cols+1));
+    }
+
+    screen_destroy(s);
+} END_TEST
+
+START_TEST (test_page_keys) {
+    Screen s = screen_init(&test_arguments);
+
+    /* a hundred lines of ten characters */
+    char text[100*11];
+    for (int i = 0 ; i < 100 ; ++i)
+        memcpy(text + 11*i, "0123456789\n", 11);
+    handle_paste(s, text, sizeof text - 1);
+
+    ck_assert_int_eq(100, s->n_lines);
+    ck_assert_ptr_eq(g_list_last(s->lines), s->last_line);
+    ck_assert_ptr_eq(s->last_line, s->cur_line);
+
+    /* home & end move within the line */
+    handle_home(s);
+    ck_assert_int_eq(0, s->col);
+    ck_assert_uint_eq(0, line_cursor_offset(CURR_LINE));
+    handle_end(s);
+    ck_assert_int_eq(10, s->col);
+    ck_assert_uint_eq(10, line_cursor_offset(CURR_LINE));
+
+    handle_document_start(s);
+    ck_assert_int_eq(0, s->cur_line_num);
+    ck_assert_int_eq(0, s->top_line_num);
+    ck_assert_int_eq(0, s->row);
+    ck_assert_int_eq(0, s->col);
+
+    /* a page down moves both the rendered lines & the cursor by a page */
+    move_to_column(s, 4);
+    handle_page_down(s);
+    ck_assert_int_eq(s->rows, s->top_line_num);
+    ck_assert_int_eq(s->rows, s->cur_line_num);
+    ck_assert_ptr_eq(g_list_nth(s->lines, s->rows), s->cur_line);
+    ck_assert_ptr_eq(s->cur_line, s->top_line);
+    ck_assert_int_eq(0, s->row);
+    ck_assert_int_eq(4, s->col);
+    ck_assert_uint_eq(4, line_cursor_offset(CURR_LINE));
+
+    handle_move_down(s);
+    handle_page_down(s);
+    ck_assert_int_eq(2*s->rows, s->top_line_num);
+    ck_assert_int_eq(2*s->rows+1, s->cur_line_num);
+    ck_assert_int_eq(1, s->row);
+    ck_assert_int_eq(4, s->col);
+
+    handle_page_up(s);
+    handle_page_up(s);
+    ck_assert_int_eq(0, s->top_line_num);
+    ck_assert_int_eq(1, s->cur_line_num);
+    ck_assert_int_eq(1, s->row);
+
+    /* on the first page, a page up goes to the first line */
+    handle_page_up(s);
+    ck_assert_int_eq(0, s->cur_line_num);
+    ck_assert_ptr_eq(s->lines, s->cur_line);
+    ck_assert_int_eq(0, s->row);
+    ck_assert_int_eq(4, s->col);
+
+    /* the end of the document is at the bottom of the screen */
+    handle_document_end(s);
+    ck_assert_int_eq(99, s->cur_line_num);
+    ck_assert_ptr_eq(s->last_line, s->cur_line);
+    ck_assert_int_eq(100 - s->rows, s->top_line_num);
+    ck_assert_ptr_eq(g_list_nth(s->lines, 100 - s->rows), s->top_line);
+    ck_assert_int_eq(s->rows-1, s->row);
+    ck_assert_int_eq(10, s->col);
+
+    /* on the last page, a page down stays on the last line */
+    handle_page_down(s);
+    ck_assert_int_eq(99, s->cur_line_num);
+    ck_assert_ptr_eq(s->last_line, s->cur_line);
+    handle_page_down(s);
+    ck_assert_int_eq(99, s->cur_line_num);
+    ck_assert_int_eq(99, s->top_line_num);
+    ck_assert_int_eq(0, s->row);
+
+    /* the last line is kept track of as lines are merged & added */
+    handle_home(s);
+    handle_backspace(s);
+    ck_assert_int_eq(99, s->n_lines);
+    ck_assert_ptr_eq(g_list_last(s->lines), s->last_line);
+    handle_end(s);
+    handle_enter(s);
+    ck_assert_ptr_eq(g_list_last(s->lines), s->last_line);
+    ck_assert_ptr_eq(s->last_line, s->cur_line);
 
     screen_destroy(s);
 } END_TEST
@@ -967,11 +1721,11 @@ START_TEST (test_backspace) {
 
     /* state before backspace */
     ck_assert_int_eq(1, s->n_lines);
-    ck_assert_int_eq(5, s->col);
+    ck_assert_int_eq(4, s->col);
     ck_assert_int_eq(0, s->row);
     ck_assert_int_eq('\t', CURR_LBUF->buffer[CURR_LBUF->cursor-1]);
     ck_assert_int_eq(2, CURR_LBUF->cursor);
-    ck_assert_int_eq(6, CURR_LINE->visual_end);
+    ck_assert_int_eq(5, CURR_LINE->visual_end);
 
     handle_backspace(s);
 
@@ -1058,6 +1812,32 @@ START_TEST (test_split_line) {
     ck_assert_int_eq(0, CURR_LBUF->cursor);
     ck_assert_int_eq(2, CURR_LINE->visual_end);
 
+    /* null bytes after the split point move along with the rest */
+    gap_buffer_insert_str(CURR_LBUF, "x\0y", 3);
+    gap_buffer_move_cursor(CURR_LBUF, -2);
+    split_line(s);
+
+    ck_assert_int_eq(3, s->n_lines);
+    ck_assert_int_eq(0, CURR_LBUF->cursor);
+    ck_assert_int_eq('\0', CURR_LBUF->buffer[0]);
+    ck_assert_int_eq('y', CURR_LBUF->buffer[1]);
+    ck_assert_int_eq('a', CURR_LBUF->buffer[2]);
+    ck_assert_int_eq('b', CURR_LBUF->buffer[3]);
+    ck_assert_int_eq('\n', CURR_LBUF->buffer[CURR_LBUF->end]);
+
+    /* and back */
+    merge_line_up(s);
+
+    ck_assert_int_eq(2, s->n_lines);
+    char text[8];
+    int n = 0;
+    for (int i = 0 ; i <= CURR_LBUF->end ; ++i) {
+        if (i < CURR_LBUF->gap_start || i > CURR_LBUF->gap_end)
+            text[n++] = CURR_LBUF->buffer[i];
+    }
+    ck_assert_int_eq(6, n);
+    ck_assert_int_eq(0, memcmp("x\0yab\n", text, 6));
+
     screen_destroy(s);
 } END_TEST
 
@@ -1110,6 +1890,964 @@ START_TEST (test_merge_line_up) {
     screen_destroy(s);
 } END_TEST
 
+/* copies line's text, without the gap, into a newly allocated string */
+static char* line_string(Line l) {
+    char* text = malloc(l->buff->end+2);
+    int n = 0;
+
+    for (int i = 0 ; i <= l->buff->end ; ++i) {
+        if ((i < l->buff->gap_start || i > l->buff->gap_end) && l->buff->buffer[i])
+            text[n++] = l->buff->buffer[i];
+    }
+
+    text[n] = '\0';
+    return text;
+}
+
+START_TEST (test_paste) {
+    Screen s = screen_init(&test_arguments);
+
+    /* paste without line breaks *********************************************/
+
+    handle_insert_char(s, 'x');
+    handle_insert_char(s, 'y');
+    handle_insert_char(s, 'z');
+    handle_move_left(s);
+
+    handle_paste(s, "ab\tc", 4);
+
+    char* text = line_string(CURR_LINE);
+    ck_assert_str_eq("xyab\tcz\n", text);
+    free(text);
+
+    ck_assert_int_eq(1, s->n_lines);
+    ck_assert_int_eq(9, s->col);
+    ck_assert_int_eq(0, s->row);
+    ck_assert_int_eq(9, CURR_LINE->visual_cursor);
+    ck_assert_int_eq(10, CURR_LINE->visual_end);
+    ck_assert_int_eq('c', CURR_LBUF->buffer[CURR_LBUF->cursor-1]);
+
+    /* paste splitting the line **********************************************/
+
+    handle_paste(s, "A\nB\r\nCD", 8);
+
+    ck_assert_int_eq(3, s->n_lines);
+    ck_assert_int_eq(2, s->cur_line_num);
+    ck_assert_int_eq(2, s->col);
+    ck_assert_int_eq(2, s->row);
+    ck_assert_int_eq(2, CURR_LINE->visual_cursor);
+    ck_assert_int_eq(3, CURR_LINE->visual_end);
+    ck_assert_int_eq('z', CURR_LBUF->buffer[CURR_LBUF->cursor]);
+
+    text = line_string(s->lines->data);
+    ck_assert_str_eq("xyab\tcA\n", text);
+    free(text);
+    ck_assert_int_eq(10, ((Line)s->lines->data)->visual_end);
+
+    text = line_string(PREV_LINE);
+    ck_assert_str_eq("B\n", text);
+    free(text);
+
+    text = line_string(CURR_LINE);
+    ck_assert_str_eq("CDz\n", text);
+    free(text);
+
+    /* the line is still usable by other handlers */
+    handle_insert_char(s, '!');
+    handle_enter(s);
+
+    text = line_string(PREV_LINE);
+    ck_assert_str_eq("CD!\n", text);
+    free(text);
+
+    text = line_string(CURR_LINE);
+    ck_assert_str_eq("z\n", text);
+    free(text);
+
+    /* paste past the bottom of the screen ***********************************/
+
+    handle_paste(s, "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n", 21);
+
+    ck_assert_int_eq(14, s->n_lines);
+    ck_assert_int_eq(13, s->cur_line_num);
+    ck_assert_int_eq(9, s->row);
+    ck_assert_int_eq(0, s->col);
+    ck_assert_int_eq(4, s->top_line_num);
+    ck_assert_ptr_eq(s->top_line, g_list_nth(s->lines, 4));
+
+    text = line_string(CURR_LINE);
+    ck_assert_str_eq("z\n", text);
+    free(text);
+
+    screen_destroy(s);
+} END_TEST
+
+/* test opening files */
+START_TEST (test_file_open) {
+    char name[] = "/tmp/logic_test_XXXXXX";
+    int fd = mkstemp(name);
+    ck_assert_int_ne(-1, fd);
+
+    const char* contents = "first\r\n\tsecond\n\nlast";
+    ck_assert_int_eq(strlen(contents), write(fd, contents, strlen(contents)));
+    close(fd);
+
+    Screen s = screen_init(&test_arguments);
+    ck_assert(file_open(s, name));
+
+    /* a line without a line break at the end is kept */
+    ck_assert_int_eq(4, s->n_lines);
+    ck_assert_int_eq(4, g_list_length(s->lines));
+    ck_assert(!s->modified);
+
+    /* the cursor is at the beginning of the file */
+    ck_assert_ptr_eq(s->lines, s->cur_line);
+    ck_assert_ptr_eq(s->lines, s->top_line);
+    ck_assert_int_eq(0, CURR_LINE->visual_cursor);
+    ck_assert_int_eq(0, s->row);
+    ck_assert_int_eq(0, s->col);
+
+    char* text = line_string(g_list_nth_data(s->lines, 0));
+    ck_assert_str_eq("first\n", text);
+    free(text);
+
+    text = line_string(g_list_nth_data(s->lines, 1));
+    ck_assert_str_eq("\tsecond\n", text);
+    free(text);
+    ck_assert_int_eq(10, ((Line)g_list_nth_data(s->lines, 1))->visual_end);
+
+    text = line_string(g_list_nth_data(s->lines, 3));
+    ck_assert_str_eq("last\n", text);
+    free(text);
+
+    file_close(s);
+    screen_destroy(s);
+
+    /* the empty line after the last line break is not */
+    fd = open(name, O_WRONLY | O_TRUNC);
+    ck_assert_int_eq(4, write(fd, "a\nb\n", 4));
+    close(fd);
+
+    s = screen_init(&test_arguments);
+    ck_assert(file_open(s, name));
+    ck_assert_int_eq(2, s->n_lines);
+    ck_assert_int_eq(2, g_list_length(s->lines));
+
+    file_close(s);
+    screen_destroy(s);
+
+    unlink(name);
+} END_TEST
+
+/* writes the text into a new temporary file, the name is written into name */
+static void write_temp_file(char* name, const char* text) {
+    strcpy(name, "/tmp/logic_test_XXXXXX");
+    int fd = mkstemp(name);
+    ck_assert_int_ne(-1, fd);
+    ck_assert_int_eq(strlen(text), write(fd, text, strlen(text)));
+    close(fd);
+}
+
+/* appends the text to the file */
+static void append_to_file(const char* name, const char* text) {
+    int fd = open(name, O_WRONLY | O_APPEND);
+    ck_assert_int_ne(-1, fd);
+    ck_assert_int_eq(strlen(text), write(fd, text, strlen(text)));
+    close(fd);
+}
+
+START_TEST (test_follow) {
+    char name[32];
+    write_temp_file(name, "one\ntwo\n");
+
+    Screen s = screen_init(&test_arguments);
+    ck_assert(file_open(s, name));
+    ck_assert(file_follow(s));
+    ck_assert_int_ne(-1, s->follow_fd);
+    ck_assert(!file_read_appended(s));
+
+    /* text after the line break goes on a new line, the view stays */
+    move_to_column(s, 2);
+    append_to_file(name, "three\nfo");
+    ck_assert(file_read_appended(s));
+    ck_assert_int_eq(4, s->n_lines);
+    ck_assert_ptr_eq(s->lines, s->cur_line);
+    ck_assert_int_eq(0, s->row);
+    ck_assert_int_eq(2, s->col);
+    ck_assert_uint_eq(2, line_cursor_offset(CURR_LINE));
+    ck_assert(!s->modified);
+
+    /* an unfinished line is continued, a character split between appends
+       waits for its other byte */
+    append_to_file(name, "ur \xc3");
+    ck_assert(file_read_appended(s));
+    append_to_file(name, "\xa9\r\n");
+    ck_assert(file_read_appended(s));
+    ck_assert_int_eq(4, s->n_lines);
+
+    char* text = line_string(s->last_line->data);
+    ck_assert_str_eq("four \xc3\xa9\n", text);
+    free(text);
+    ck_assert_int_eq(6, ((Line)s->last_line->data)->visual_end);
+
+    /* at the end of the document the cursor follows the text, scrolling */
+    handle_document_end(s);
+    for (int i = 0 ; i < 20 ; ++i)
+        append_to_file(name, "line\n");
+    ck_assert(file_read_appended(s));
+    ck_assert_int_eq(24, s->n_lines);
+    ck_assert_ptr_eq(s->last_line, s->cur_line);
+    ck_assert_ptr_eq(g_list_last(s->lines), s->last_line);
+    ck_assert_int_eq(23, s->cur_line_num);
+    ck_assert_int_eq(4, s->col);
+    ck_assert_int_eq(s->rows-1, s->row);
+    ck_assert_int_eq(24 - s->rows, s->top_line_num);
+
+    /* the last line ended, so a blank line appended stays */
+    append_to_file(name, "\nlast");
+    ck_assert(file_read_appended(s));
+    ck_assert_int_eq(26, s->n_lines);
+    ck_assert_int_eq(0, ((Line)s->last_line->prev->data)->visual_end);
+    ck_assert_int_eq(4, s->col);
+    ck_assert_int_eq(25, s->cur_line_num);
+
+    /* saving doesn't stop the file being read, from the saved end on */
+    ck_assert(file_save(s));
+    append_to_file(name, "saved\n");
+    ck_assert(file_read_appended(s));
+    ck_assert_int_eq(27, s->n_lines);
+    text = line_string(s->last_line->data);
+    ck_assert_str_eq("saved\n", text);
+    free(text);
+    ck_assert(!s->modified);
+
+    /* text appended while another buffer is shown is read once the
+       followed one is shown again */
+    screen_add_buffer(s, "/tmp/logic_test_missing");
+    screen_switch_buffer(s, s->buffers->next);
+    append_to_file(name, "more\n");
+    file_follow_changed(s);
+    ck_assert(s->follow_pending);
+    ck_assert_int_eq(1, s->n_lines);
+
+    screen_switch_buffer(s, s->buffers);
+    ck_assert(!s->follow_pending);
+    ck_assert_int_eq(28, s->n_lines);
+    text = line_string(s->last_line->data);
+    ck_assert_str_eq("more\n", text);
+    free(text);
+
+    file_close(s);
+    screen_destroy(s);
+
+    unlink(name);
+} END_TEST
+
+/* test listing buffers and switching between them */
+START_TEST (test_buffers) {
+    char first[32], second[32], third[32];
+    write_temp_file(first, "one\ntwo\n");
+    write_temp_file(second, "a\nb\nc\nd\n");
+    write_temp_file(third, "x");
+
+    struct line_stats lines = line_stats;
+
+    Backend b = backend_headless_new(10, 30);
+    Screen s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+    ck_assert(file_open(s, first));
+
+    screen_add_buffer(s, second);
+    screen_add_buffer(s, third);
+    screen_add_buffer(s, "/tmp/logic_test_missing");
+
+    /* listed files are not read */
+    ck_assert_int_eq(4, s->n_buffers);
+    ck_assert_int_eq(lines.lines + 2, line_stats.lines);
+    ck_assert(!((Buffer)g_list_nth_data(s->buffers, 1))->loaded);
+    ck_assert_int_eq(8, ((Buffer)g_list_nth_data(s->buffers, 1))->file_size);
+
+    /* leave the first buffer modified on its second line */
+    handle_move_down(s);
+    handle_insert_char(s, '!');
+
+    /* the second file is read once shown */
+    screen_switch_buffer(s, s->buffers->next);
+    ck_assert(((Buffer)s->cur_buffer->data)->loaded);
+    ck_assert_int_eq(4, s->n_lines);
+    ck_assert_int_eq(0, s->cur_line_num);
+    ck_assert(!s->modified);
+    ck_assert_int_eq(lines.lines + 6, line_stats.lines);
+
+    char* text = line_string(s->lines->data);
+    ck_assert_str_eq("a\n", text);
+    free(text);
+
+    /* the first buffer is as it was left */
+    screen_switch_buffer(s, s->buffers);
+    ck_assert_int_eq(2, s->n_lines);
+    ck_assert_int_eq(1, s->cur_line_num);
+    ck_assert_int_eq(1, s->col);
+    ck_assert(s->modified);
+    ck_assert(screen_buffer_modified(s, s->buffers));
+    ck_assert(!screen_buffer_modified(s, s->buffers->next));
+
+    /* each buffer is saved into its own file */
+    ck_assert(file_save(s));
+    screen_switch_buffer(s, g_list_nth(s->buffers, 2));
+    handle_insert_char(s, 'y');
+    ck_assert(file_save(s));
+
+    char contents[32];
+    int fd = open(first, O_RDONLY);
+    ck_assert_int_eq(9, read(fd, contents, sizeof contents));
+    close(fd);
+    ck_assert(memcmp(contents, "one\n!two\n", 9) == 0);
+
+    fd = open(third, O_RDONLY);
+    ck_assert_int_eq(3, read(fd, contents, sizeof contents));
+    close(fd);
+    ck_assert(memcmp(contents, "yx\n", 3) == 0);
+
+    /* a missing file gives an empty buffer named after it */
+    screen_switch_buffer(s, g_list_last(s->buffers));
+    ck_assert_int_eq(1, s->n_lines);
+    ck_assert_str_eq("/tmp/logic_test_missing",
+                     ((Buffer)s->cur_buffer->data)->file_name);
+
+    /* lines of every buffer are given back, then the pool goes */
+    file_close(s);
+    screen_destroy(s);
+    backend_destroy(b);
+    ck_assert_int_eq(lines.lines, line_stats.lines);
+    ck_assert_int_eq(0, line_stats.pooled);
+
+    unlink(first);
+    unlink(second);
+    unlink(third);
+} END_TEST
+
+/* test panes showing one document with their own cursors */
+START_TEST (test_panes) {
+    char name[32];
+    write_temp_file(name, "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12\n");
+
+    Backend b = backend_headless_new(20, 30);
+    Screen s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+    ck_assert(file_open(s, name));
+    render_frame(s);
+
+    Pane top = s->panes->data;
+    ck_assert_int_eq(1, top->paints);
+    ck_assert_int_eq(18, s->rows);
+
+    /* the screen is split into two panes with a bar between them */
+    ck_assert(screen_split_pane(s));
+    render_frame(s);
+
+    Pane bottom = s->panes->next->data;
+    ck_assert_int_eq(2, g_list_length(s->panes));
+    ck_assert_int_eq(8, s->rows);
+    ck_assert_int_eq(9, bottom->rows);
+    ck_assert_int_eq(2, top->paints);
+    ck_assert_int_eq(1, bottom->paints);
+    ck_assert_int_eq(ATTR_REVERSE, backend_headless_row(b, 9)[0].attr);
+
+    char text[31];
+    backend_headless_row_text(b, 10, text);
+    ck_assert(strncmp("   1 1 ", text, 7) == 0);
+
+    /* each pane keeps its own cursor */
+    screen_switch_pane(s, s->panes->next);
+    ck_assert_int_eq(9, s->rows);
+    for (int i = 0 ; i < 3 ; ++i)
+        handle_move_down(s);
+    handle_move_right(s);
+    render_frame(s);
+    ck_assert_int_eq(2, top->paints);
+    ck_assert_int_eq(2, bottom->paints);
+
+    screen_switch_pane(s, s->panes);
+    ck_assert_int_eq(0, s->cur_line_num);
+    ck_assert_int_eq(3, bottom->cur_line_num);
+    ck_assert_int_eq(1, bottom->cursor_col);
+
+    /* panes which didn't change are not painted again */
+    render_frame(s);
+    render_frame(s);
+    ck_assert_int_eq(4, top->paints);
+    ck_assert_int_eq(2, bottom->paints);
+
+    /* removing the line of another pane's cursor moves it up */
+    for (int i = 0 ; i < 3 ; ++i)
+        handle_move_down(s);
+    handle_backspace(s);
+    render_frame(s);
+
+    ck_assert_int_eq(11, s->n_lines);
+    ck_assert_int_eq(2, bottom->cur_line_num);
+    ck_assert_int_eq(2, bottom->cursor_col);
+    ck_assert_int_eq(3, bottom->paints);
+
+    screen_switch_pane(s, s->panes->next);
+    ck_assert_int_eq(2, s->cur_line_num);
+    ck_assert_int_eq(2, CURR_LINE->visual_cursor);
+    ck_assert_int_eq(2, s->col);
+
+    char* line = line_string(s->cur_line->data);
+    ck_assert_str_eq("34\n", line);
+    free(line);
+
+    /* changes under another pane's rows don't paint it */
+    for (int i = 0 ; i < 8 ; ++i)
+        handle_move_down(s);
+    ck_assert_int_eq(10, s->cur_line_num);
+    handle_insert_char(s, 'x');
+    render_frame(s);
+    ck_assert_int_eq(5, top->paints);
+
+    /* closing a pane gives its rows to the other one */
+    screen_close_pane(s);
+    render_frame(s);
+    ck_assert_int_eq(1, g_list_length(s->panes));
+    ck_assert_int_eq(18, s->rows);
+    ck_assert_int_eq(2, s->cur_line_num);
+    ck_assert_int_eq(1, s->col);
+    ck_assert_int_eq(ATTR_YELLOW, backend_headless_row(b, 9)[0].attr);
+
+    screen_close_pane(s);
+    ck_assert_int_eq(1, g_list_length(s->panes));
+
+    file_close(s);
+    screen_destroy(s);
+    backend_destroy(b);
+
+    /* panes are not split smaller than a few rows */
+    b = backend_headless_new(6, 30);
+    s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+    ck_assert(!screen_split_pane(s));
+    ck_assert_int_eq(1, g_list_length(s->panes));
+
+    screen_destroy(s);
+    backend_destroy(b);
+
+    unlink(name);
+} END_TEST
+
+/* test UTF-8 text, characters of which take a number of bytes & columns */
+START_TEST (test_utf8) {
+    uint32_t c;
+
+    /* characters are decoded, bytes which aren't one are decoded alone */
+    ck_assert_uint_eq(2, utf8_decode("\xc3\xa9", 2, &c));
+    ck_assert_uint_eq(0xe9, c);
+    ck_assert_uint_eq(3, utf8_decode("\xe4\xb8\xad", 3, &c));
+    ck_assert_uint_eq(0x4e2d, c);
+    ck_assert_uint_eq(1, utf8_decode("\xc0\xaf", 2, &c));
+    ck_assert_uint_eq(UTF8_REPLACEMENT, c);
+    ck_assert_uint_eq(1, utf8_decode("\xed\xa0\x80", 3, &c));
+    ck_assert_uint_eq(UTF8_REPLACEMENT, c);
+
+    char bytes[UTF8_MAX_LENGTH];
+    ck_assert_uint_eq(4, utf8_encode(0x1f600, bytes));
+    ck_assert(memcmp("\xf0\x9f\x98\x80", bytes, 4) == 0);
+
+    /* runs of ASCII are checked up to the first other byte */
+    char ascii[100];
+    memset(ascii, 'a', sizeof(ascii));
+    ascii[70] = '\xff';
+    ck_assert_uint_eq(70, utf8_ascii_length(ascii, sizeof(ascii)));
+    ck_assert_uint_eq(2, utf8_incomplete_length("a\xe4\xb8", 3));
+    ck_assert_uint_eq(0, utf8_incomplete_length("a\xc3\xa9", 3));
+
+    ck_assert_uint_eq(1, utf8_width(0xe9));
+    ck_assert_uint_eq(0, utf8_width(0x301));
+    ck_assert_uint_eq(2, utf8_width(0x4e2d));
+
+    /* typed bytes are inserted once they make up a character */
+    Backend b = backend_headless_new(10, 30);
+    Screen s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+
+    handle_insert_char(s, 'a');
+    handle_insert_byte(s, '\xc3');
+    ck_assert_int_eq(1, CURR_LBUF->cursor);
+    ck_assert_int_eq(1, s->col);
+
+    handle_insert_byte(s, '\xa9');
+    ck_assert_int_eq(3, CURR_LBUF->cursor);
+    ck_assert_int_eq(2, s->col);
+    ck_assert(!CURR_LINE->ascii);
+
+    const char* keys = "\xe4\xb8\xad" "e\xcc\x81" "b";
+    for (const char* key = keys ; *key ; ++key) {
+        backend_headless_push_key(b, (unsigned char)*key);
+        ck_assert(insert_mode(s));
+    }
+
+    /* wide characters take two columns and marks none */
+    ck_assert_int_eq(10, CURR_LBUF->cursor);
+    ck_assert_int_eq(6, CURR_LINE->visual_end);
+    ck_assert_int_eq(6, s->col);
+
+    render_frame(s);
+
+    char text[256];
+    backend_headless_row_text(b, 1, text);
+    ck_assert_ptr_nonnull(strstr(text, "a\xc3\xa9\xe4\xb8\xad" "e\xcc\x81" "b"));
+
+    const Cell* row = backend_headless_row(b, 1);
+    uint col = 0;
+    while (row[col].ch != 0x4e2d)
+        ++col;
+    ck_assert_uint_eq(CELL_WIDE, row[col+1].ch);
+    ck_assert_uint_eq('e', row[col+2].ch);
+    ck_assert_uint_eq(0x301, row[col+2].mark);
+
+    /* the cursor moves over whole characters with their marks */
+    handle_move_left(s);
+    ck_assert_int_eq(5, s->col);
+    handle_move_left(s);
+    ck_assert_int_eq(4, s->col);
+    handle_move_left(s);
+    ck_assert_int_eq(2, s->col);
+    ck_assert_uint_eq(3, line_char_at(CURR_LINE, 0, &c));
+    ck_assert_uint_eq(0x4e2d, c);
+    handle_move_left(s);
+    ck_assert_int_eq(1, s->col);
+    ck_assert_int_eq(1, CURR_LBUF->cursor);
+
+    handle_move_right(s);
+    handle_move_right(s);
+    ck_assert_int_eq(4, s->col);
+    handle_move_right(s);
+    ck_assert_int_eq(5, s->col);
+    ck_assert_uint_eq(1, line_char_at(CURR_LINE, 0, &c));
+    ck_assert_uint_eq('b', c);
+
+    /* backspace removes a mark on its own, then whole characters */
+    handle_backspace(s);
+    ck_assert_int_eq(5, s->col);
+    ck_assert_int_eq(6, CURR_LINE->visual_end);
+    handle_backspace(s);
+    handle_backspace(s);
+    ck_assert_int_eq(2, s->col);
+    ck_assert_int_eq(3, CURR_LINE->visual_end);
+
+    char* line = line_string(CURR_LINE);
+    ck_assert_str_eq("a\xc3\xa9" "b\n", line);
+    free(line);
+
+    /* a wide character the row's edge would split goes to the next row */
+    uint width = s->cols+1;
+    handle_end(s);
+    while (CURR_LINE->visual_cursor != width-1)
+        handle_insert_char(s, 'x');
+    for (const char* key = "\xe4\xb8\xad" ; *key ; ++key)
+        handle_insert_byte(s, *key);
+    ck_assert_int_eq(width+2, CURR_LINE->visual_end);
+    ck_assert_int_eq(width+2, CURR_LINE->visual_cursor);
+    ck_assert_int_eq(1, CURR_LINE->wraps);
+
+    render_frame(s);
+    row = backend_headless_row(b, 1);
+    ck_assert_uint_eq('x', row[b->cols-2].ch);
+    ck_assert_uint_eq(' ', row[b->cols-1].ch);
+    row = backend_headless_row(b, 2);
+    col = 0;
+    while (row[col].ch != 0x4e2d)
+        ++col;
+    ck_assert_uint_eq(CELL_WIDE, row[col+1].ch);
+    ck_assert_uint_eq(b->cols - width, col);
+
+    /* the cursor steps over the blank along with the character */
+    handle_move_left(s);
+    ck_assert_int_eq(width-1, CURR_LINE->visual_cursor);
+    handle_move_right(s);
+    ck_assert_int_eq(width+2, CURR_LINE->visual_cursor);
+
+    /* text typed before it moves it off the edge, backspace moves it back */
+    handle_home(s);
+    handle_insert_char(s, 'y');
+    ck_assert_int_eq(width+2, CURR_LINE->visual_end);
+    ck_assert_int_eq(1, CURR_LINE->visual_cursor);
+    handle_backspace(s);
+    handle_insert_char(s, 'y');
+    handle_insert_char(s, 'y');
+    ck_assert_int_eq(width+3, CURR_LINE->visual_end);
+    handle_backspace(s);
+    handle_backspace(s);
+    ck_assert_int_eq(width+2, CURR_LINE->visual_end);
+
+    /* a wider screen has no edge to skip */
+    backend_headless_resize(b, 10, 40);
+    ck_assert_int_eq(KEY_RESIZE, backend_read_key(b));
+    screen_resize(s);
+    ck_assert_int_eq(width+1, CURR_LINE->visual_end);
+    ck_assert_int_eq(0, CURR_LINE->wraps);
+
+    /* edits of a long line measure only around them, & agree with
+       measuring it whole */
+    width = s->cols+1;
+    for (int i = 0 ; i < 10 ; ++i) {
+        /* runs of wide characters, of narrow ones & of both */
+        for (int j = 0 ; j < 200 ; ++j)
+            handle_paste(s, "\xe4\xb8\xad", 3);
+        for (int j = 0 ; j < 300 ; ++j)
+            handle_paste(s, (j % 50) ? "\xc3\xa9" : "\t", (j % 50) ? 2 : 1);
+        for (int j = 0 ; j < 30 ; ++j)
+            handle_paste(s, "\xe4\xb8\xad\xe6\x96\x87 ab\t\xc3\xa9", 12);
+    }
+
+    unsigned seed = 1;
+    for (int edit = 0 ; edit < 400 ; ++edit) {
+        seed = seed * 1103515245 + 12345;
+        move_to_column(s, (seed >> 8) % CURR_LINE->visual_end);
+
+        switch ((seed >> 4) % 5) {
+        case 0:
+            for (const char* key = "\xe4\xb8\xad" ; *key ; ++key)
+                handle_insert_byte(s, *key);
+            break;
+        case 1:
+            handle_insert_char(s, 'a');
+            break;
+        case 2:
+            handle_tab(s);
+            break;
+        default:
+            handle_backspace(s);
+            break;
+        }
+
+        /* a copy measured whole */
+        char* text = line_string(CURR_LINE);
+        Line copy = line_create();
+        gap_buffer_insert_str(copy->buff, text, strlen(text)-1);
+        line_measure(copy, s->tab_width, width);
+        free(text);
+
+        ck_assert_int_eq(copy->visual_end, CURR_LINE->visual_end);
+        ck_assert_int_eq(line_column(copy, line_cursor_offset(CURR_LINE),
+                                     s->tab_width, width),
+                         CURR_LINE->visual_cursor);
+        for (uint col = 0 ; col < copy->visual_end ; col += 97) {
+            uint offset = line_offset(copy, col, s->tab_width, width);
+            ck_assert_uint_eq(offset, line_offset(CURR_LINE, col,
+                                                  s->tab_width, width));
+            ck_assert_uint_eq(line_column(copy, offset, s->tab_width, width),
+                              line_column(CURR_LINE, offset, s->tab_width,
+                                          width));
+        }
+
+        line_destroy(copy);
+    }
+
+    screen_destroy(s);
+    backend_destroy(b);
+
+    /* files keep their bytes, invalid ones included */
+    char name[32];
+    const char* contents = "caf\xc3\xa9 \xe4\xb8\xad\n\xff\n";
+    write_temp_file(name, contents);
+
+    s = screen_init(&test_arguments);
+    ck_assert(file_open(s, name));
+    ck_assert_int_eq(7, ((Line)g_list_nth_data(s->lines, 0))->visual_end);
+    ck_assert_int_eq(1, ((Line)g_list_nth_data(s->lines, 1))->visual_end);
+    ck_assert(!((Line)g_list_nth_data(s->lines, 1))->ascii);
+    ck_assert(file_save(s));
+
+    char saved[64] = { 0 };
+    FILE* file = fopen(name, "r");
+    ck_assert_uint_eq(strlen(contents), fread(saved, 1, sizeof(saved), file));
+    ck_assert_str_eq(contents, saved);
+    fclose(file);
+
+    file_close(s);
+    screen_destroy(s);
+
+    unlink(name);
+} END_TEST
+
+/* test viewing a file straight from its mapping */
+START_TEST (test_viewer) {
+    char name[] = "/tmp/logic_test_XXXXXX";
+    int fd = mkstemp(name);
+    ck_assert_int_ne(-1, fd);
+
+    /* three thousand lines, the last one without a line break */
+    FILE* file = fdopen(fd, "w");
+    for (int i = 0 ; i < 3000 ; ++i)
+        fprintf(file, (i < 2999) ? "line %d\n" : "line %d", i);
+    fclose(file);
+
+    Viewer v = viewer_open(name, &test_arguments);
+    ck_assert_ptr_ne(NULL, v);
+    viewer_wait_index(v);
+
+    /* only every VIEW_INDEX_STEP-th line is indexed */
+    ck_assert(v->indexed);
+    ck_assert_int_eq(3000, viewer_n_lines(v));
+    ck_assert_int_eq(3, v->n_index);
+    ck_assert_int_eq(0, viewer_line_number(v, 0));
+    ck_assert_int_eq(2500, viewer_line_number(v, 10*7 + 90*8 + 900*9 + 1500*10));
+
+    Backend b = backend_headless_new(10, 30);
+    viewer_init_backend(v, b);
+    ck_assert_int_eq(8, v->rows);
+
+    char text[64];
+    viewer_render(v);
+    backend_headless_row_text(b, 1, text);
+    ck_assert_str_eq("   1 line 0                   ", text);
+    backend_headless_row_text(b, 8, text);
+    ck_assert_str_eq("   8 line 7                   ", text);
+
+    /* lines are found from the index */
+    ck_assert(viewer_go_to_line(v, 2047));
+    ck_assert_int_eq(2047, v->top_num);
+    viewer_render(v);
+    backend_headless_row_text(b, 1, text);
+    ck_assert_str_eq("2048 line 2047                ", text);
+    ck_assert(!viewer_go_to_line(v, 3000));
+    ck_assert_int_eq(2047, v->top_num);
+
+    /* scrolling stops with the last line at the bottom */
+    viewer_scroll_down(v, 5000);
+    ck_assert_int_eq(3000 - v->rows, v->top_num);
+    viewer_scroll_up(v, 1);
+    ck_assert_int_eq(2999 - v->rows, v->top_num);
+
+    viewer_go_to_start(v);
+    viewer_go_to_end(v);
+    ck_assert_int_eq(3000 - v->rows, v->top_num);
+    viewer_render(v);
+    backend_headless_row_text(b, 8, text);
+    ck_assert_str_eq("3000 line 2999                ", text);
+
+    /* searching goes to the next line with the text, highlighting it */
+    viewer_handle_key(v, KEY_HOME);
+    ck_assert(viewer_search(v, "line 123"));
+    ck_assert_int_eq(123, v->top_num);
+    ck_assert(viewer_search(v, v->pattern));
+    ck_assert_int_eq(1230, v->top_num);
+
+    viewer_render(v);
+    ck_assert_int_eq(ATTR_REVERSE, backend_headless_row(b, 1)[5].attr);
+    ck_assert_int_eq(ATTR_REVERSE, backend_headless_row(b, 1)[12].attr);
+    ck_assert_int_eq(ATTR_NONE, backend_headless_row(b, 1)[13].attr);
+
+    ck_assert(!viewer_search(v, "nothing"));
+    ck_assert_int_eq(1230, v->top_num);
+
+    /* keys move by pages & quit */
+    ck_assert(viewer_handle_key(v, KEY_NPAGE));
+    ck_assert_int_eq(1230 + v->rows, v->top_num);
+    ck_assert(viewer_handle_key(v, KEY_PPAGE));
+    ck_assert_int_eq(1230, v->top_num);
+    ck_assert(!viewer_handle_key(v, 'q'));
+
+    /* a file truncated while it's viewed reads as zeros past its end until
+       it's mapped again */
+    viewer_go_to_end(v);
+    ck_assert_int_eq(0, truncate(name, 700));
+    ck_assert_int_eq(0, v->data[v->size-1]);
+
+    ck_assert(viewer_check_size(v));
+    ck_assert(!viewer_check_size(v));
+    ck_assert_str_eq("File was truncated", v->message);
+    ck_assert_uint_eq(700, v->size);
+    ck_assert_uint_le(v->top, 700);
+    viewer_wait_index(v);
+    ck_assert_int_eq(89, viewer_n_lines(v));
+
+    viewer_go_to_end(v);
+    viewer_render(v);
+    backend_headless_row_text(b, 8, text);
+    ck_assert_str_eq("  89 line 8                   ", text);
+
+    viewer_destroy(v);
+    unlink(name);
+
+    /* long searches show their progress & stop on a key, which is handled
+       next unless it's escape */
+    strcpy(name, "/tmp/logic_test_XXXXXX");
+    fd = mkstemp(name);
+    ck_assert_int_ne(-1, fd);
+    ck_assert_int_eq(0, ftruncate(fd, 3 * VIEW_SCAN_CHUNK));
+    ck_assert_int_eq(1, pwrite(fd, "\n", 1, 0));
+    ck_assert_int_eq(1, pwrite(fd, "x", 1, 3 * VIEW_SCAN_CHUNK - 1));
+    close(fd);
+
+    v = viewer_open(name, &test_arguments);
+    ck_assert_ptr_ne(NULL, v);
+    viewer_init_backend(v, b);
+
+    backend_headless_push_key(b, 27);
+    ck_assert(!viewer_search(v, "x"));
+    ck_assert_str_eq("Search stopped", v->message);
+    ck_assert_int_eq(ERR, v->key);
+    backend_headless_row_text(b, 9, text);
+    ck_assert_ptr_nonnull(strstr(text, "Searching... 33%"));
+
+    backend_headless_push_key(b, 'q');
+    ck_assert(!viewer_search(v, "x"));
+    ck_assert_int_eq('q', v->key);
+
+    v->message = NULL;
+    ck_assert(viewer_search(v, "x"));
+    ck_assert_ptr_null(v->message);
+
+    viewer_destroy(v);
+    backend_destroy(b);
+    unlink(name);
+} END_TEST
+
+/* test recording keys & replaying them */
+START_TEST (test_record_replay) {
+    char name[] = "/tmp/logic_test_XXXXXX";
+    int fd = mkstemp(name);
+    ck_assert_int_ne(-1, fd);
+    close(fd);
+
+    /* keys read by the editor are recorded */
+    KeyTrace recording = keytrace_new();
+    ck_assert(keytrace_record(recording, name));
+
+    Backend terminal = backend_headless_new(10, 30);
+    Backend b = backend_record_new(terminal, recording);
+    Screen s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+
+    backend_headless_push_key(terminal, 'a');
+    backend_headless_push_key(terminal, '\n');
+    backend_headless_push_key(terminal, 'b');
+
+    while (insert_mode(s));
+
+    /* and are in the file once their frame is shown, before the recording
+       ends */
+    KeyTrace t = keytrace_load(name);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(0, t->length);
+    keytrace_destroy(t);
+
+    render_frame(s);
+
+    t = keytrace_load(name);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(3, t->length);
+    ck_assert_int_eq('b', t->events[2].key);
+    keytrace_destroy(t);
+
+    screen_destroy(s);
+    backend_destroy(b);
+
+    t = keytrace_load(name);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(3, t->length);
+    ck_assert_int_eq('a', t->events[0].key);
+    ck_assert_int_eq('\n', t->events[1].key);
+    ck_assert_int_eq('b', t->events[2].key);
+    ck_assert(t->events[0].time <= t->events[1].time);
+    ck_assert(t->events[1].time <= t->events[2].time);
+
+    /* replaying them gives the same text */
+    terminal = backend_headless_new(10, 30);
+    b = backend_replay_new(terminal, t, true);
+    s = screen_init(&test_arguments);
+    screen_init_backend(s, b);
+
+    while (insert_mode(s));
+
+    ck_assert_int_eq(2, s->n_lines);
+    char* text = line_string(g_list_nth_data(s->lines, 1));
+    ck_assert_str_eq("b\n", text);
+    free(text);
+
+    /* then keys come from the terminal again */
+    backend_headless_push_key(terminal, 'c');
+    ck_assert_int_eq('c', backend_read_key(b));
+
+    screen_destroy(s);
+    backend_destroy(b);
+
+    /* at the recorded pace keys wait until they are due */
+    t = keytrace_new();
+    keytrace_add(t, 'x', 0);
+    keytrace_add(t, 'y', 20000);
+
+    terminal = backend_headless_new(10, 30);
+    b = backend_replay_new(terminal, t, false);
+
+    backend_timeout(b, 0);
+    ck_assert_int_eq('x', backend_read_key(b));
+    ck_assert_int_eq(ERR, backend_read_key(b));
+
+    /* resizes are not held up */
+    backend_headless_resize(terminal, 12, 40);
+    ck_assert_int_eq(KEY_RESIZE, backend_read_key(b));
+    ck_assert_int_eq(40, b->cols);
+
+    backend_timeout(b, -1);
+    ck_assert_int_eq('y', backend_read_key(b));
+
+    backend_destroy(b);
+
+    /* a recording cut short in the middle of a key keeps the keys before */
+    struct stat st;
+    ck_assert_int_eq(0, stat(name, &st));
+    ck_assert_int_eq(0, truncate(name, st.st_size - 5));
+
+    t = keytrace_load(name);
+    ck_assert_ptr_nonnull(t);
+    ck_assert_int_eq(2, t->length);
+    ck_assert_int_eq('\n', t->events[1].key);
+    keytrace_destroy(t);
+
+    unlink(name);
+} END_TEST
+
+START_TEST (test_frame_cap) {
+    /* only whole numbers in range are taken as arguments */
+    uint number = 0;
+    ck_assert(arguments_parse_number("60", 1, FPS_MAX, &number));
+    ck_assert_int_eq(60, number);
+    ck_assert(!arguments_parse_number("0", 1, FPS_MAX, &number));
+    ck_assert(!arguments_parse_number("-5", 1, FPS_MAX, &number));
+    ck_assert(!arguments_parse_number("abc", 1, FPS_MAX, &number));
+    ck_assert(!arguments_parse_number("12abc", 1, FPS_MAX, &number));
+    ck_assert(!arguments_parse_number(" 12", 1, FPS_MAX, &number));
+    ck_assert(!arguments_parse_number("", 1, FPS_MAX, &number));
+    ck_assert(!arguments_parse_number("1001", 1, FPS_MAX, &number));
+    ck_assert(!arguments_parse_number("99999999999999999999", 1, FPS_MAX,
+                                      &number));
+    ck_assert_int_eq(60, number);
+
+    /* frames without a cap are due straight away */
+    struct Arguments args = test_arguments;
+    args.max_fps = 0;
+    Screen s = screen_init(&args);
+
+    struct timespec last_frame;
+    clock_gettime(CLOCK_MONOTONIC, &last_frame);
+    ck_assert_int_eq(0, input_frame_wait(s, &last_frame));
+
+    /* with a cap the next frame waits for the rest of its 50ms */
+    args.max_fps = 20;
+    long wait = input_frame_wait(s, &last_frame);
+    ck_assert(wait > 0 && wait <= 50);
+
+    /* and is due once they passed */
+    last_frame.tv_sec -= 1;
+    ck_assert_int_eq(0, input_frame_wait(s, &last_frame));
+
+    screen_destroy(s);
+} END_TEST
+
 Suite* s_input() {
     Suite* s_input = suite_create("input");
 
@@ -1121,6 +2859,8 @@ Suite* s_input() {
     tcase_add_test(tc_movement, test_move_down);
     tcase_add_test(tc_movement, test_enter);
     tcase_add_test(tc_movement, test_tab);
+    tcase_add_test(tc_movement, test_column_index);
+    tcase_add_test(tc_movement, test_page_keys);
     tcase_add_test(tc_movement, test_backspace);
     suite_add_tcase(s_input, tc_movement);
 
@@ -1129,6 +2869,36 @@ Suite* s_input() {
     tcase_add_test(tc_line_management, test_merge_line_up);
     suite_add_tcase(s_input, tc_line_management);
 
+    TCase* tc_paste = tcase_create("paste");
+    tcase_add_test(tc_paste, test_paste);
+    suite_add_tcase(s_input, tc_paste);
+
+    TCase* tc_files = tcase_create("files");
+    tcase_add_test(tc_files, test_file_open);
+    tcase_add_test(tc_files, test_follow);
+    suite_add_tcase(s_input, tc_files);
+
+    TCase* tc_buffers = tcase_create("buffers");
+    tcase_add_test(tc_buffers, test_buffers);
+    suite_add_tcase(s_input, tc_buffers);
+
+    TCase* tc_panes = tcase_create("panes");
+    tcase_add_test(tc_panes, test_panes);
+    suite_add_tcase(s_input, tc_panes);
+
+    TCase* tc_utf8 = tcase_create("utf8");
+    tcase_add_test(tc_utf8, test_utf8);
+    suite_add_tcase(s_input, tc_utf8);
+
+    TCase* tc_viewer = tcase_create("viewer");
+    tcase_add_test(tc_viewer, test_viewer);
+    suite_add_tcase(s_input, tc_viewer);
+
+    TCase* tc_sessions = tcase_create("sessions");
+    tcase_add_test(tc_sessions, test_record_replay);
+    tcase_add_test(tc_sessions, test_frame_cap);
+    suite_add_tcase(s_input, tc_sessions);
+
     return s_input;
 }
 
@@ -1139,7 +2909,7 @@ int main() {
     SRunner* s_logic_runner = srunner_create(s_screen_s);
     srunner_add_suite(s_logic_runner, s_input_s);
 
-    test_arguments.debug_mode = false;
+    arguments_init(&test_arguments);
     test_arguments.file_name = "-";
 
     srunner_run_all(s_logic_runner, CK_NORMAL);
@@ -0,0 +1,454 @@
+/************************************************************************
+ * text-editor - a simple text editor                                   *
+ *                                                                      *
+ * Copyright (C) 2017 Kajetan Puchalski                                 *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                 *
+ * See the GNU General Public License for more details.                 *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program. If not, see http://www.gnu.org/licenses/.   *
+ *                                                                      *
+ ************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "screen.h"
+#include "input.h"
+#include "render.h"
+#include "files.h"
+#include "histogram.h"
+
+/*****************************************************************************/
+/*                                  Settings                                 */
+/*****************************************************************************/
+
+/* size of the screen benchmarks render on */
+#define PERF_ROWS 50
+#define PERF_COLS 160
+
+/* number of times every benchmark is run, the fastest run counts */
+#define PERF_RUNS 15
+
+/* number of times a benchmark over the threshold is measured again before
+   it counts as slower, & the number of measurements a baseline is the
+   median of */
+#define PERF_ATTEMPTS 3
+
+/* default allowed slowdown against the baseline, in percent; loading &
+   saving vary by about 15% between runs on a busy machine, so a strict
+   run asks for PERF_THRESHOLD=15 in the environment or --threshold 15 */
+#define PERF_THRESHOLD 30
+
+/* lines of the file loaded, saved & scrolled through */
+#define PERF_FILE_LINES 40000
+
+/* keys typed or scrolled by one run */
+#define PERF_KEYS 2000
+
+/* line counts Enter is timed at for the complexity check */
+#define PERF_SMALL_N 1000
+#define PERF_BIG_N 64000
+
+/* a line at PERF_BIG_N may be at most this many times slower than at
+   PERF_SMALL_N, a linear cost would make it 64 times slower */
+#define PERF_MAX_GROWTH 4
+
+/* bytes of the line typed into for comparing wide characters with ASCII,
+   which may be at most PERF_MAX_GROWTH times slower to type, & the keys
+   typed into it by one run */
+#define PERF_LINE_BYTES (1 << 20)
+#define PERF_LINE_KEYS 200
+
+/*****************************************************************************/
+/*                                  Helpers                                  */
+/*****************************************************************************/
+
+static struct Arguments arguments;
+
+/* file the benchmarks load & save */
+static char file_name[] = "/tmp/perf_test_XXXXXX";
+
+/* creates a screen on a headless backend */
+static Screen perf_screen() {
+    Screen s = screen_init(&arguments);
+    screen_init_backend(s, backend_headless_new(PERF_ROWS, PERF_COLS));
+    return s;
+}
+
+static void perf_screen_destroy(Screen s) {
+    Backend b = s->backend;
+
+    file_close(s);
+    screen_destroy(s);
+    backend_destroy(b);
+}
+
+/* fixed amount of integer & memory work, the unit benchmarks are measured
+   in so that baselines hold on faster and slower machines; the memory fits
+   in the cache, a bigger one got twice as slow whenever other processes took
+   over the shared cache while the editor's own work barely did */
+static double calibrate() {
+    static unsigned char memory[1 << 14];
+
+    uint64_t start = cpu_time_us();
+    unsigned x = 1;
+
+    for (int i = 0 ; i < 4000000 ; ++i) {
+        x = x * 1103515245 + 12345;
+        memory[x % sizeof memory] += x >> 24;
+    }
+
+    return cpu_time_us() - start + (memory[x % sizeof memory] & 0);
+}
+
+/*****************************************************************************/
+/*                                 Benchmarks                                */
+/*****************************************************************************/
+
+/* opening the file */
+static double bench_load() {
+    Screen s = perf_screen();
+
+    uint64_t start = cpu_time_us();
+    file_open(s, file_name);
+    double time = cpu_time_us() - start;
+
+    perf_screen_destroy(s);
+
+    return time;
+}
+
+/* saving the whole file */
+static double bench_save() {
+    Screen s = perf_screen();
+    file_open(s, file_name);
+
+    uint64_t start = cpu_time_us();
+    file_save(s);
+    double time = cpu_time_us() - start;
+
+    perf_screen_destroy(s);
+
+    return time;
+}
+
+/* typing into the file, rendering every key */
+static double bench_typing() {
+    Screen s = perf_screen();
+    file_open(s, file_name);
+
+    uint64_t start = cpu_time_us();
+
+    for (int i = 0 ; i < PERF_KEYS ; ++i) {
+        if (i % 80 == 79)
+            handle_enter(s);
+        else
+            handle_insert_char(s, 'a' + i % 26);
+
+        screen_fit_line_numbers(s);
+        render_frame(s);
+    }
+
+    double time = cpu_time_us() - start;
+
+    perf_screen_destroy(s);
+
+    return time;
+}
+
+/* scrolling down through the file, rendering every key */
+static double bench_scrolling() {
+    Screen s = perf_screen();
+    file_open(s, file_name);
+
+    uint64_t start = cpu_time_us();
+
+    for (int i = 0 ; i < PERF_KEYS ; ++i) {
+        handle_move_down(s);
+        render_frame(s);
+    }
+
+    double time = cpu_time_us() - start;
+
+    perf_screen_destroy(s);
+
+    return time;
+}
+
+/* typing a character & Enter at the end of a file with the given number
+   of lines, returns microseconds per line */
+static double enter_at_line(uint n) {
+    Screen s = perf_screen();
+
+    for (uint i = 1 ; i < n ; ++i) {
+        handle_insert_char(s, 'x');
+        handle_enter(s);
+    }
+
+    uint64_t start = cpu_time_us();
+
+    for (int i = 0 ; i < PERF_KEYS ; ++i) {
+        handle_insert_char(s, 'x');
+        handle_enter(s);
+    }
+
+    double time = (double)(cpu_time_us() - start) / PERF_KEYS;
+
+    perf_screen_destroy(s);
+
+    return time;
+}
+
+/* typing & deleting characters in the middle of a line of PERF_LINE_BYTES
+   made of the given one, rendering every key; returns microseconds per
+   key */
+static double type_in_line(const char* c) {
+    Screen s = perf_screen();
+    size_t length = strlen(c);
+
+    char* text = malloc(PERF_LINE_BYTES);
+    size_t n = PERF_LINE_BYTES / length * length;
+    for (size_t i = 0 ; i < n ; i += length)
+        memcpy(text+i, c, length);
+    handle_paste(s, text, n);
+    free(text);
+
+    move_to_column(s, CURR_LINE->visual_end / 2);
+
+    uint64_t start = cpu_time_us();
+
+    for (int i = 0 ; i < PERF_LINE_KEYS ; ++i) {
+        if (i % 4 == 3) {
+            handle_backspace(s);
+        } else {
+            for (size_t j = 0 ; j < length ; ++j)
+                handle_insert_byte(s, c[j]);
+        }
+
+        render_frame(s);
+    }
+
+    double time = (double)(cpu_time_us() - start) / PERF_LINE_KEYS;
+
+    perf_screen_destroy(s);
+
+    return time;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* runs a benchmark a few times, returns its fastest run in microseconds
+   & in units of the fastest calibration loop among the runs */
+static double fastest(double (*bench)(), double* units) {
+    double best = 0, unit = 0;
+
+    for (int run = 0 ; run < PERF_RUNS ; ++run) {
+        double calibration = calibrate();
+        double time = bench();
+
+        if (run == 0 || calibration < unit)
+            unit = calibration;
+
+        if (run == 0 || time < best)
+            best = time;
+    }
+
+    *units = best / unit;
+
+    return best;
+}
+
+/* Enter at the small & the big line count */
+static double enter_small() { return enter_at_line(PERF_SMALL_N); }
+static double enter_big() { return enter_at_line(PERF_BIG_N); }
+
+/* typing into a line of ASCII & into one of wide characters */
+static double type_ascii() { return type_in_line("a"); }
+static double type_wide() { return type_in_line("\xe4\xb8\xad"); }
+
+static const struct {
+    const char* name;
+    double (*run)();
+} benchmarks[] = {
+    { "load", bench_load },
+    { "save", bench_save },
+    { "typing", bench_typing },
+    { "scrolling", bench_scrolling },
+};
+
+#define N_BENCHMARKS (sizeof benchmarks / sizeof benchmarks[0])
+
+/*****************************************************************************/
+/*                                 Baselines                                 */
+/*****************************************************************************/
+
+/* looks up a benchmark's baseline in the file, 0 if it has none */
+static double read_baseline(const char* baselines, const char* name) {
+    FILE* file = fopen(baselines, "r");
+    if (!file)
+        return 0;
+
+    char line[256], key[64];
+    double value, found = 0;
+
+    while (fgets(line, sizeof line, file)) {
+        if (line[0] == '#')
+            continue;
+
+        if (sscanf(line, "%63s %lf", key, &value) == 2 &&
+            strcmp(key, name) == 0)
+            found = value;
+    }
+
+    fclose(file);
+
+    return found;
+}
+
+/* writes measured values as the new baselines */
+static bool write_baselines(const char* baselines, double* values) {
+    FILE* file = fopen(baselines, "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "# baselines of perf_test, in units of the calibration "
+            "loop\n# regenerate with: perf_test --update "
+            "tests/perf_baselines.txt\n");
+
+    for (size_t i = 0 ; i < N_BENCHMARKS ; ++i)
+        fprintf(file, "%s %.4f\n", benchmarks[i].name, values[i]);
+
+    return fclose(file) == 0;
+}
+
+/*****************************************************************************/
+/*                                    Test                                   */
+/*****************************************************************************/
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [--threshold PERCENT] [--update] BASELINES\n",
+            name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    const char* baselines = NULL;
+    double threshold = PERF_THRESHOLD;
+    bool update = false;
+
+    /* the threshold can also come from the environment of ctest */
+    if (getenv("PERF_THRESHOLD"))
+        threshold = atof(getenv("PERF_THRESHOLD"));
+
+    for (int i = 1 ; i < argc ; ++i) {
+        if (strcmp(argv[i], "--threshold") == 0 && i+1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--update") == 0)
+            update = true;
+        else if (argv[i][0] != '-' && !baselines)
+            baselines = argv[i];
+        else
+            usage(argv[0]);
+    }
+
+    if (!baselines)
+        usage(argv[0]);
+
+    arguments_init(&arguments);
+    arguments.file_name = file_name;
+    arguments.backend = "headless";
+
+    /* write the file the benchmarks work on */
+    int fd = mkstemp(file_name);
+    FILE* file = fdopen(fd, "w");
+
+    for (int i = 0 ; i < PERF_FILE_LINES ; ++i)
+        fprintf(file, "%s%d: the quick brown fox jumps over the lazy dog\n",
+                (i % 4) ? "\t" : "", i);
+
+    fclose(file);
+
+    int failed = 0;
+    double values[N_BENCHMARKS];
+
+    /* compare every benchmark with its baseline */
+    printf("%-12s %12s %10s %10s %8s\n", "benchmark", "time (us)", "units",
+           "baseline", "change");
+
+    for (size_t i = 0 ; i < N_BENCHMARKS ; ++i) {
+        double baseline = read_baseline(baselines, benchmarks[i].name);
+        double time, change = 0, measured[PERF_ATTEMPTS];
+        bool regressed;
+
+        /* a slower moment of the machine passes, a regression stays */
+        int n = 0;
+        do {
+            time = fastest(benchmarks[i].run, &measured[n++]);
+            qsort(measured, n, sizeof measured[0], compare_doubles);
+
+            /* baselines are the typical speed, not a lucky or unlucky one */
+            values[i] = update ? measured[(n-1) / 2] : measured[0];
+
+            if (baseline > 0)
+                change = (values[i] / baseline - 1) * 100;
+
+            regressed = !update && baseline > 0 && change > threshold;
+        } while (n < PERF_ATTEMPTS && (update || regressed));
+
+        printf("%-12s %12.0f %10.4f %10.4f %+7.0f%%%s\n", benchmarks[i].name,
+               time, values[i], baseline, change,
+               regressed ? "  REGRESSION" : "");
+
+        if (baseline == 0 && !update)
+            printf("%-12s has no baseline\n", benchmarks[i].name);
+
+        failed += regressed;
+    }
+
+    /* Enter must not get slower with the number of lines above it */
+    double units;
+    double small = fastest(enter_small, &units);
+    double big = fastest(enter_big, &units);
+    bool scales = big > small * PERF_MAX_GROWTH;
+
+    printf("enter: %.2f us at %d lines, %.2f us at %d lines%s\n", small,
+           PERF_SMALL_N, big, PERF_BIG_N, scales ? "  GROWS WITH LINES" : "");
+
+    failed += scales;
+
+    /* nor are wide characters much slower to type than ASCII */
+    double ascii = fastest(type_ascii, &units);
+    double wide = fastest(type_wide, &units);
+    bool slower = wide > ascii * PERF_MAX_GROWTH;
+
+    printf("long line: %.2f us per key of ASCII, %.2f us of wide "
+           "characters%s\n", ascii, wide, slower ? "  SLOWER THAN ASCII" : "");
+
+    failed += slower;
+
+    if (update && !write_baselines(baselines, values)) {
+        fprintf(stderr, "%s: cannot write %s\n", argv[0], baselines);
+        failed++;
+    }
+
+    unlink(file_name);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}